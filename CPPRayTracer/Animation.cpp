@@ -0,0 +1,81 @@
+#include "Animation.hpp"
+#include <cstdio>
+
+AMATH_NAMESPACE
+
+// index of the last key at or before frame and how far frame is towards the key after it
+template<typename Key>
+static int FindSegment(const std::vector<Key>& keys, float frame, float& t)
+{
+    t = 0.0f;
+    if (frame <= keys.front().frame) return 0;
+    if (frame >= keys.back().frame) return int(keys.size()) - 1;
+    int segment = 0;
+    while (keys[segment + 1].frame <= frame) segment++;
+    t = (frame - keys[segment].frame) / (keys[segment + 1].frame - keys[segment].frame);
+    return segment;
+}
+
+Camera Animation::CameraAt(float frame) const
+{
+    float t;
+    const int segment = FindSegment(camera, frame, t);
+    const Camera& a = camera[segment].camera;
+    if (t == 0.0f) return a;
+    const Camera& b = camera[segment + 1].camera;
+    return Camera(Vector3::Lerp(a.position, b.position, t), Vector3::Lerp(a.target, b.target, t),
+                  Vector3::Normalize(Vector3::Lerp(a.up, b.up, t)), a.verticalFov + (b.verticalFov - a.verticalFov) * t);
+}
+
+TransformKey Animation::Sample(const std::vector<TransformKey>& keys, float frame)
+{
+    float t;
+    const int segment = FindSegment(keys, frame, t);
+    if (t == 0.0f) return keys[segment];
+    const TransformKey& a = keys[segment];
+    const TransformKey& b = keys[segment + 1];
+    TransformKey key;
+    key.frame = frame;
+    key.position = Vector3::Lerp(a.position, b.position, t);
+    key.rotation = Quaternion().Slerp(a.rotation, b.rotation, t);
+    return key;
+}
+
+// true for a pattern with exactly one %d, %5d or %05d style conversion and no other
+static bool IsFramePattern(const std::string& pattern)
+{
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        if (pattern[i] != '%') continue;
+        size_t j = i + 1;
+        while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') ++j;
+        if (j == pattern.size() || pattern[j] != 'd') return false;
+        conversions++;
+        i = j;
+    }
+    return conversions == 1;
+}
+
+std::string Animation::FramePath(const std::string& fallback, int frame) const
+{
+    std::string pattern = output;
+    if (!IsFramePattern(pattern))
+    {
+        // "export.jpg" becomes "export_0001.jpg"
+        const size_t slash = fallback.find_last_of("/\\");
+        const size_t dot = fallback.find_last_of('.');
+        const size_t split = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : fallback.size();
+        auto escape = [](std::string text)
+        {
+            for (size_t i = text.find('%'); i != std::string::npos; i = text.find('%', i + 2)) text.insert(i, 1, '%');
+            return text;
+        };
+        pattern = escape(fallback.substr(0, split)) + "_%04d" + escape(fallback.substr(split));
+    }
+    char path[1024];
+    snprintf(path, sizeof(path), pattern.c_str(), frame);
+    return path;
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,48 @@
+#pragma once
+#include "Structures.hpp"
+#include "Math/Quaternion.hpp"
+#include <string>
+#include <vector>
+
+AMATH_NAMESPACE
+
+// keyframes are placed at frame numbers and need not be evenly spaced. between two keys positions are
+// lerped and rotations slerped, before the first and after the last key the value holds still
+
+struct CameraKey
+{
+	float frame = 0.0f;
+	Camera camera;
+};
+
+struct TransformKey
+{
+	float frame = 0.0f;
+	Vector3 position = Vector3::Zero();
+	Quaternion rotation = Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+};
+
+// moves one primitive, index is its position in the scene description. spheres only use the position
+struct TransformTrack
+{
+	int index = 0;
+	std::vector<TransformKey> keys;
+};
+
+struct Animation
+{
+	int frames = 0; // 0 for a still scene
+	// printf pattern with one integer conversion for the frame number, "frames/shot_%04d.png".
+	// empty uses the output path with the number before the extension
+	std::string output;
+	std::vector<CameraKey> camera; // empty keeps the scene camera
+	std::vector<TransformTrack> spheres;
+	std::vector<TransformTrack> cubes;
+
+	Camera CameraAt(float frame) const;
+	static TransformKey Sample(const std::vector<TransformKey>& keys, float frame);
+	// the path of frame from output, or from fallback when output is empty or not a usable pattern
+	std::string FramePath(const std::string& fallback, int frame) const;
+};
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,202 @@
+#include "Arena.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+uint8_t* Arena::Grow(size_t size, size_t alignment)
+{
+    UpdatePeak();
+    if (current) current->used = size_t(cursor - current->Begin());
+
+    // spare blocks behind current are left over from before a Rewind, a new one goes in between when they are too small
+    Block* next = current ? current->next : first;
+    if (next == nullptr || next->size < size + alignment)
+    {
+        Block* block = NewBlock(std::max(blockSize, size + alignment));
+        block->next = next;
+        if (current) current->next = block; else first = block;
+        next = block;
+    }
+    spilled |= current != nullptr;
+    Enter(next, next->Begin());
+    return AlignUp(cursor, alignment);
+}
+
+Arena::Block* Arena::NewBlock(size_t size)
+{
+    Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+    block->next = nullptr;
+    block->size = size;
+    block->used = 0;
+    capacity += size;
+    return block;
+}
+
+void Arena::FreeBlocks()
+{
+    for (Block* block = first; block != nullptr;)
+    {
+        Block* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+    first = current = nullptr;
+    capacity = 0;
+}
+
+void Arena::Enter(Block* block, uint8_t* at)
+{
+    current = block;
+    cursor = at;
+    limit = block ? block->End() : nullptr;
+}
+
+size_t Arena::UsedBytes() const
+{
+    if (current == nullptr) return 0;
+    size_t used = size_t(cursor - current->Begin());
+    for (const Block* block = first; block != current; block = block->next) used += block->used;
+    return used;
+}
+
+void Arena::UpdatePeak()
+{
+    peakBytes = std::max(peakBytes, UsedBytes());
+}
+
+void Arena::Rewind(const Marker& marker)
+{
+    UpdatePeak();
+    Block* block = static_cast<Block*>(marker.block);
+    if (block) Enter(block, marker.cursor);
+    else Enter(first, first ? first->Begin() : nullptr);
+}
+
+void Arena::Reset()
+{
+    UpdatePeak();
+    // one block as large as all of them together, the next frame of the same size then fits without growing
+    if (spilled)
+    {
+        const size_t total = capacity;
+        FreeBlocks();
+        first = NewBlock(total);
+        spilled = false;
+    }
+    Enter(first, first ? first->Begin() : nullptr);
+}
+
+void Arena::Release()
+{
+    FreeBlocks();
+    Enter(nullptr, nullptr);
+    spilled = false;
+    peakBytes = 0;
+}
+
+Arena& Memory::ThreadArena()
+{
+    thread_local Arena arena;
+    return arena;
+}
+
+// every operator new of the program goes through here to be counted. each thread counts into a slot of its own so
+// allocating threads never share a cache line, the totals are only summed when asked for. slots are never released,
+// a thread that exits keeps its counts in them. threads beyond the slot count share the last one
+struct alignas(64) AllocationCounter
+{
+    std::atomic<uint64_t> count { 0 };
+    std::atomic<uint64_t> bytes { 0 };
+};
+
+constexpr int AllocationCounterCount = 256;
+static AllocationCounter AllocationCounters[AllocationCounterCount];
+static std::atomic<int> AllocationCountersUsed { 0 };
+
+uint64_t Memory::HeapAllocations()
+{
+    uint64_t total = 0;
+    for (const AllocationCounter& counter : AllocationCounters) total += counter.count.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t Memory::HeapBytes()
+{
+    uint64_t total = 0;
+    for (const AllocationCounter& counter : AllocationCounters) total += counter.bytes.load(std::memory_order_relaxed);
+    return total;
+}
+
+static void CountAllocation(size_t size)
+{
+    // plain pointer so the thread_local needs no constructor, which could allocate
+    thread_local AllocationCounter* counter = nullptr;
+    if (counter == nullptr)
+    {
+        const int slot = AllocationCountersUsed.fetch_add(1, std::memory_order_relaxed);
+        counter = &AllocationCounters[std::min(slot, AllocationCounterCount - 1)];
+    }
+
+    if (counter == &AllocationCounters[AllocationCounterCount - 1])
+    {
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+        counter->bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    else
+    {
+        // only this thread writes its slot, a load and store is enough and takes no lock
+        counter->count.store(counter->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        counter->bytes.store(counter->bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+    }
+}
+
+static void* CountedAllocate(size_t size, size_t alignment)
+{
+    CountAllocation(size);
+    size = std::max<size_t>(size, 1);
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) return malloc(size);
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* memory = nullptr;
+    return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+}
+
+static void CountedFree(void* memory, [[maybe_unused]] size_t alignment)
+{
+#ifdef _WIN32
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return _aligned_free(memory);
+#endif
+    free(memory);
+}
+
+static void* CountedAllocateOrThrow(size_t size, size_t alignment)
+{
+    void* memory = CountedAllocate(size, alignment);
+    if (memory == nullptr) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size) { return CountedAllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return CountedAllocateOrThrow(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return CountedAllocateOrThrow(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return CountedAllocateOrThrow(size, size_t(alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return CountedAllocate(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return CountedAllocate(size, size_t(alignment)); }
+
+void operator delete(void* memory) noexcept { CountedFree(memory, 0); }
+void operator delete[](void* memory) noexcept { CountedFree(memory, 0); }
+void operator delete(void* memory, size_t) noexcept { CountedFree(memory, 0); }
+void operator delete[](void* memory, size_t) noexcept { CountedFree(memory, 0); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { CountedFree(memory, 0); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { CountedFree(memory, 0); }
+void operator delete(void* memory, std::align_val_t alignment) noexcept { CountedFree(memory, size_t(alignment)); }
+void operator delete[](void* memory, std::align_val_t alignment) noexcept { CountedFree(memory, size_t(alignment)); }
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept { CountedFree(memory, size_t(alignment)); }
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept { CountedFree(memory, size_t(alignment)); }
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { CountedFree(memory, size_t(alignment)); }
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { CountedFree(memory, size_t(alignment)); }
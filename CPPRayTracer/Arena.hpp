@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// bump allocator for memory that lives for one frame or one tile. Allocate moves a pointer forward and
+// Reset hands everything back at once, nothing is freed. blocks are kept between resets and merged into one
+// block after a frame that needed more than one, so from the second frame on the heap is not touched at all
+class Arena
+{
+public:
+	static constexpr size_t DefaultBlockSize = size_t(1) << 20;
+
+	// where the arena was, Rewind frees everything allocated after it
+	struct Marker
+	{
+		void* block;
+		uint8_t* cursor;
+	};
+
+	explicit Arena(size_t _blockSize = DefaultBlockSize) : blockSize(_blockSize) {}
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena() { Release(); }
+
+	void* Allocate(size_t size, size_t alignment = 16)
+	{
+		uint8_t* p = AlignUp(cursor, alignment);
+		if (p == nullptr || p + size > limit) p = Grow(size, alignment);
+		cursor = p + size;
+		return p;
+	}
+
+	// uninitialized storage for count elements, arena memory is never destructed
+	template<typename T>
+	T* Allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without calling destructors");
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+	}
+
+	template<typename T>
+	T* AllocateFilled(size_t count, const T& value)
+	{
+		T* elements = Allocate<T>(count);
+		std::uninitialized_fill_n(elements, count, value);
+		return elements;
+	}
+
+	Marker Mark() const { return { current, cursor }; }
+	void Rewind(const Marker& marker);
+	// everything allocated since the last reset is gone, the memory stays with the arena
+	void Reset();
+	// gives the blocks back to the heap
+	void Release();
+
+	size_t Capacity() const { return capacity; }
+	// bytes handed out since the last reset and their high water mark over all resets
+	size_t UsedBytes() const;
+	size_t PeakBytes() const { return std::max(peakBytes, UsedBytes()); }
+
+private:
+	struct alignas(16) Block
+	{
+		Block* next;
+		size_t size;
+		size_t used; // set when the arena moves on to the next block
+
+		uint8_t* Begin() { return reinterpret_cast<uint8_t*>(this) + sizeof(Block); }
+		uint8_t* End() { return Begin() + size; }
+	};
+
+	size_t blockSize;
+	Block* first = nullptr;
+	Block* current = nullptr;
+	uint8_t* cursor = nullptr;
+	uint8_t* limit = nullptr;
+	size_t capacity = 0;
+	size_t peakBytes = 0;
+	bool spilled = false; // a second block was needed since the last reset
+
+	static uint8_t* AlignUp(uint8_t* p, size_t alignment) { return reinterpret_cast<uint8_t*>((uintptr_t(p) + alignment - 1) & ~uintptr_t(alignment - 1)); }
+
+	uint8_t* Grow(size_t size, size_t alignment);
+	Block* NewBlock(size_t size);
+	void FreeBlocks();
+	void Enter(Block* block, uint8_t* at);
+	void UpdatePeak();
+};
+
+namespace Memory
+{
+	// one arena per thread, whoever starts a frame or tile resets it
+	Arena& ThreadArena();
+
+	// calls to operator new of every thread since startup, the renderer should add none once it is warm
+	uint64_t HeapAllocations();
+	uint64_t HeapBytes();
+}
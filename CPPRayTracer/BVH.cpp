@@ -0,0 +1,136 @@
+#include "BVH.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+AMATH_NAMESPACE
+
+static void SetBounds(BVHNode& node, const AABB& bounds)
+{
+    node.minX = bounds.min.x; node.minY = bounds.min.y; node.minZ = bounds.min.z;
+    node.maxX = bounds.max.x; node.maxY = bounds.max.y; node.maxZ = bounds.max.z;
+}
+
+void BVH::Build(const std::vector<AABB>& bounds, std::vector<int>& order)
+{
+    Trace::Scope scope("bvh build");
+    const auto start = std::chrono::high_resolution_clock::now();
+    storage.clear();
+    owner.reset();
+    motionNodes.clear();
+    motionSteps = 0;
+
+    const int count = int(bounds.size());
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0);
+
+    if (count > 0)
+    {
+        std::vector<Vector3> centroids(count);
+        for (int i = 0; i < count; ++i) centroids[i] = bounds[i].Center();
+
+        storage.reserve(size_t(count) * 2 - 1);
+        storage.emplace_back();
+        BuildRecursive(bounds, centroids, order, 0, 0, count, 0);
+    }
+
+    nodes = storage.data();
+    nodeCount = int(storage.size());
+    buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void BVH::BuildRecursive(const std::vector<AABB>& bounds, const std::vector<Vector3>& centroids, std::vector<int>& order,
+                         int nodeIndex, int begin, int end, int depth)
+{
+    AABB nodeBounds, centroidBounds;
+    for (int i = begin; i < end; ++i)
+    {
+        nodeBounds.Grow(bounds[order[i]]);
+        centroidBounds.Grow(centroids[order[i]]);
+    }
+    SetBounds(storage[nodeIndex], nodeBounds);
+
+    const int count = end - begin;
+    auto makeLeaf = [&]
+    {
+        storage[nodeIndex].first = begin;
+        storage[nodeIndex].count = count;
+    };
+    // the traversal stack holds one entry per level
+    if (count <= 1 || depth >= MaxDepth - 1) return makeLeaf();
+
+    const int axis = centroidBounds.LongestAxis();
+    const float axisMin = centroidBounds.min.arr[axis];
+    const float extent = centroidBounds.max.arr[axis] - axisMin;
+
+    int mid = begin;
+    if (extent > 0.0f)
+    {
+        struct Bucket { int count = 0; AABB bounds; };
+        Bucket buckets[BucketCount];
+        const float scale = BucketCount / extent;
+        auto bucketOf = [&](int primitive) { return Min(int((centroids[primitive].arr[axis] - axisMin) * scale), BucketCount - 1); };
+
+        for (int i = begin; i < end; ++i)
+        {
+            Bucket& bucket = buckets[bucketOf(order[i])];
+            bucket.count++;
+            bucket.bounds.Grow(bounds[order[i]]);
+        }
+
+        // sweep from the right, then from the left to get the cost of every split plane
+        float rightArea[BucketCount - 1];
+        int rightCount[BucketCount - 1];
+        AABB right;
+        int countRight = 0;
+        for (int i = BucketCount - 1; i > 0; --i)
+        {
+            right.Grow(buckets[i].bounds);
+            countRight += buckets[i].count;
+            rightArea[i - 1] = right.SurfaceArea();
+            rightCount[i - 1] = countRight;
+        }
+
+        AABB left;
+        int countLeft = 0, bestSplit = -1;
+        float bestCost = FLT_MAX;
+        for (int i = 0; i < BucketCount - 1; ++i)
+        {
+            left.Grow(buckets[i].bounds);
+            countLeft += buckets[i].count;
+            if (countLeft == 0 || rightCount[i] == 0) continue;
+            const float cost = countLeft * left.SurfaceArea() + rightCount[i] * rightArea[i];
+            if (cost < bestCost) { bestCost = cost; bestSplit = i; }
+        }
+
+        // a traversal step costs about one primitive test
+        const float leafCost = float(count);
+        const float splitCost = 1.0f + bestCost / Max(nodeBounds.SurfaceArea(), 1e-20f);
+        if (count <= MaxLeafSize && (bestSplit < 0 || leafCost <= splitCost)) return makeLeaf();
+
+        if (bestSplit >= 0)
+        {
+            mid = int(std::partition(order.begin() + begin, order.begin() + end, [&](int primitive) { return bucketOf(primitive) <= bestSplit; }) - order.begin());
+        }
+    }
+    else if (count <= MaxLeafSize) return makeLeaf();
+
+    // coincident centroids, split in the middle so leaves stay small
+    if (mid == begin || mid == end)
+    {
+        mid = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](int a, int b) { return centroids[a].arr[axis] < centroids[b].arr[axis]; });
+    }
+
+    const int leftChild = int(storage.size());
+    storage.emplace_back();
+    storage.emplace_back();
+    storage[nodeIndex].first = leftChild;
+    storage[nodeIndex].count = 0;
+    BuildRecursive(bounds, centroids, order, leftChild, begin, mid, depth + 1);
+    BuildRecursive(bounds, centroids, order, leftChild + 1, mid, end, depth + 1);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,270 @@
+#pragma once
+#include "Structures.hpp"
+#include "RayStats.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+AMATH_NAMESPACE
+
+// 32 bytes, two nodes share a cache line. the children of an inner node are stored next to each other
+struct BVHNode
+{
+	float minX, minY, minZ;
+	int first;	// first child for inner nodes, first primitive for leaves
+	float maxX, maxY, maxZ;
+	int count;	// primitives in the leaf, 0 for inner nodes
+
+	bool IsLeaf() const { return count > 0; }
+};
+
+// bounding volume hierarchy over primitive bounds, built top down with binned SAH.
+// Build returns the order primitives have to be stored in, leaves then refer to contiguous ranges of it.
+// nodes either live in the BVH or point into memory owned by someone else, a mapped scene file
+class BVH
+{
+public:
+	static constexpr int MaxLeafSize = 4;
+	static constexpr int BucketCount = 12;
+	static constexpr int MaxDepth = 64;
+
+	const BVHNode* nodes = nullptr;
+	int nodeCount = 0;
+	float buildMilliseconds = 0.0f;
+
+	BVH() = default;
+	// a copy of an owning BVH owns its own nodes, a copy of a view shares the memory it points into
+	BVH(const BVH& other) { *this = other; }
+	BVH(BVH&&) = default;
+	BVH& operator=(const BVH& other)
+	{
+		storage = other.storage; owner = other.owner;
+		nodes = storage.empty() ? other.nodes : storage.data(); nodeCount = other.nodeCount;
+		motionNodes = other.motionNodes; motionSteps = other.motionSteps;
+		buildMilliseconds = other.buildMilliseconds;
+		return *this;
+	}
+	BVH& operator=(BVH&&) = default;
+
+	void Build(const std::vector<AABB>& bounds, std::vector<int>& order);
+	// owner keeps the memory nodes point into alive, a mapped cache file, or is null when someone else does
+	void View(const BVHNode* _nodes, int count, std::shared_ptr<const void> _owner = nullptr)
+	{
+		storage.clear(); storage.shrink_to_fit();
+		motionNodes.clear(); motionSteps = 0;
+		nodes = _nodes; nodeCount = count;
+		owner = std::move(_owner);
+	}
+	void Clear() { View(nullptr, 0); }
+	// recomputes the node bounds for primitives that moved, keeping the tree. bounds(first, count) is the
+	// union of the primitives of a leaf. much faster than a build but the tree degrades as things move apart
+	template<typename Bounds>
+	void Refit(Bounds&& bounds);
+	// motion blur, refits the tree at steps + 1 evenly spaced times of the shutter with bounds(key, first, count).
+	// rays lerp the node bounds of the two keys around their time, so a node bounds its primitives at that
+	// moment instead of everywhere they pass through while the shutter is open. 0 steps drops the motion
+	template<typename Bounds>
+	void RefitMotion(int steps, Bounds&& bounds);
+	int MotionSteps() const { return motionSteps; }
+	bool Empty() const { return nodeCount == 0; }
+
+	// calls leaf(first, count, t_max) for every leaf the ray reaches, near child first.
+	// leaf returns true on a hit and lowers t_max, farther subtrees are then skipped
+	template<typename Leaf>
+	bool Traverse(const Ray& ray, float& t_max, Leaf&& leaf) const;
+
+private:
+	std::vector<BVHNode> storage;
+	std::shared_ptr<const void> owner;
+	// node i at key k is motionNodes[k * nodeCount + i], the topology is the one of nodes
+	std::vector<BVHNode> motionNodes;
+	int motionSteps = 0;
+
+	template<bool Motion, typename Leaf>
+	bool TraverseNodes(const Ray& ray, float& t_max, Leaf&& leaf) const;
+
+	void BuildRecursive(const std::vector<AABB>& bounds, const std::vector<Vector3>& centroids, std::vector<int>& order,
+	                    int nodeIndex, int begin, int end, int depth);
+};
+
+// motion keys are evenly spaced over the shutter, the key a ray time falls after and how far it is towards the next one
+FINLINE int MotionKey(float time, int steps, float& fraction)
+{
+	const float scaled = Clamp(time, 0.0f, 1.0f) * steps;
+	const int key = Min(int(scaled), steps - 1);
+	fraction = scaled - key;
+	return key;
+}
+
+constexpr float BVHFarScale = 1.0f + 2.0f * 3.0f * FLT_EPSILON * 0.5f / (1.0f - 3.0f * FLT_EPSILON * 0.5f);
+
+// slab test against node bounds, the integer fields in lane 3 are replaced by the ray interval
+FINLINE bool VECTORCALL IntersectBounds(__m128 min, __m128 max, __m128 origin, __m128 invDirection, float t_max, float& tEntry)
+{
+	const __m128 t0 = _mm_mul_ps(_mm_sub_ps(min, origin), invDirection);
+	const __m128 t1 = _mm_mul_ps(_mm_sub_ps(max, origin), invDirection);
+	__m128 tNear = _mm_blend_ps(_mm_min_ps(t0, t1), _mm_set1_ps(RayTMin), 8);
+	__m128 tFar  = _mm_blend_ps(_mm_max_ps(t0, t1), _mm_set1_ps(t_max), 8);
+
+	tNear = _mm_max_ps(tNear, _mm_permute_ps(tNear, _MM_SHUFFLE(2, 3, 0, 1)));
+	tNear = _mm_max_ps(tNear, _mm_permute_ps(tNear, _MM_SHUFFLE(1, 0, 3, 2)));
+	tFar  = _mm_min_ps(tFar,  _mm_permute_ps(tFar,  _MM_SHUFFLE(2, 3, 0, 1)));
+	tFar  = _mm_min_ps(tFar,  _mm_permute_ps(tFar,  _MM_SHUFFLE(1, 0, 3, 2)));
+
+	// tFar is widened by the rounding error of the slab math so grazing hits on the bounds are not lost (Ize 2013)
+	tEntry = _mm_cvtss_f32(tNear);
+	return tEntry <= _mm_cvtss_f32(tFar) * BVHFarScale;
+}
+
+FINLINE bool VECTORCALL IntersectNode(const BVHNode& node, __m128 origin, __m128 invDirection, float t_max, float& tEntry)
+{
+	return IntersectBounds(_mm_loadu_ps(&node.minX), _mm_loadu_ps(&node.maxX), origin, invDirection, t_max, tEntry);
+}
+
+template<typename Bounds>
+void BVH::Refit(Bounds&& bounds)
+{
+	if (nodeCount == 0) return;
+	// a view is copied out first, the memory it points into may be read only
+	if (storage.empty())
+	{
+		storage.assign(nodes, nodes + nodeCount);
+		nodes = storage.data();
+		owner.reset();
+	}
+
+	// children are always stored after their parent, going backwards reaches them first
+	for (int i = nodeCount - 1; i >= 0; --i)
+	{
+		BVHNode& node = storage[i];
+		AABB box;
+		if (node.IsLeaf()) box = bounds(node.first, node.count);
+		else
+		{
+			const BVHNode& left = storage[node.first];
+			const BVHNode& right = storage[node.first + 1];
+			box = AABB(Vector3(Min(left.minX, right.minX), Min(left.minY, right.minY), Min(left.minZ, right.minZ)),
+			           Vector3(Max(left.maxX, right.maxX), Max(left.maxY, right.maxY), Max(left.maxZ, right.maxZ)));
+		}
+		node.minX = box.min.x; node.minY = box.min.y; node.minZ = box.min.z;
+		node.maxX = box.max.x; node.maxY = box.max.y; node.maxZ = box.max.z;
+	}
+}
+
+template<typename Bounds>
+void BVH::RefitMotion(int steps, Bounds&& bounds)
+{
+	motionSteps = nodeCount > 0 ? steps : 0;
+	motionNodes.resize(size_t(nodeCount) * (motionSteps > 0 ? motionSteps + 1 : 0));
+	// the last refit is key 0, which stays in nodes for rays that come without motion
+	for (int key = motionSteps; key >= 0; --key)
+	{
+		Refit([&](int first, int count) { return bounds(key, first, count); });
+		if (motionSteps > 0) std::copy(storage.begin(), storage.end(), motionNodes.begin() + size_t(key) * nodeCount);
+	}
+}
+
+template<typename Leaf>
+bool BVH::Traverse(const Ray& ray, float& t_max, Leaf&& leaf) const
+{
+	if (nodeCount == 0) return false;
+	return motionSteps > 0 ? TraverseNodes<true>(ray, t_max, leaf) : TraverseNodes<false>(ray, t_max, leaf);
+}
+
+template<bool Motion, typename Leaf>
+bool BVH::TraverseNodes(const Ray& ray, float& t_max, Leaf&& leaf) const
+{
+	const __m128 origin = _mm_setr_ps(ray.origin.x, ray.origin.y, ray.origin.z, 0.0f);
+	const __m128 invDirection = _mm_div_ps(_mm_set1_ps(1.0f), _mm_setr_ps(ray.direction.x, ray.direction.y, ray.direction.z, 1.0f));
+
+	struct Entry { int node; float t; };
+	Entry stack[MaxDepth];
+	int stackSize = 0;
+	bool hit = false;
+	// counted locally and added once, nothing is left of them when statistics are compiled out
+	uint64_t visited = 1, skipped = 0;
+	auto addStatistics = [&]
+	{
+		if constexpr (RayStats::Enabled)
+		{
+			RayStats::Counters& counters = RayStats::ThreadCounters();
+			counters[RayCounter::NodeVisits] += visited;
+			counters[RayCounter::EarlyOuts] += skipped;
+		}
+	};
+
+	// the bounds of a moving node at the ray time, lerped between the keys before and after it
+	const BVHNode* keyNodes = nullptr;
+	__m128 fraction = _mm_setzero_ps();
+	if constexpr (Motion)
+	{
+		float keyFraction;
+		keyNodes = motionNodes.data() + size_t(MotionKey(ray.time, motionSteps, keyFraction)) * nodeCount;
+		fraction = _mm_set1_ps(keyFraction);
+	}
+	auto intersect = [&](int index, float t_max, float& t)
+	{
+		if constexpr (Motion)
+		{
+			const BVHNode& a = keyNodes[index];
+			const BVHNode& b = keyNodes[index + nodeCount];
+			const __m128 min = _mm_loadu_ps(&a.minX), max = _mm_loadu_ps(&a.maxX);
+			return IntersectBounds(_mm_add_ps(min, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&b.minX), min), fraction)),
+			                       _mm_add_ps(max, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&b.maxX), max), fraction)), origin, invDirection, t_max, t);
+		}
+		else return IntersectNode(nodes[index], origin, invDirection, t_max, t);
+	};
+
+	float tEntry;
+	if (!intersect(0, t_max, tEntry))
+	{
+		addStatistics();
+		return false;
+	}
+	int index = 0;
+
+	while (true)
+	{
+		const BVHNode& node = nodes[index];
+		if (node.IsLeaf())
+		{
+			hit |= leaf(node.first, node.count, t_max);
+		}
+		else
+		{
+			int nearChild = node.first, farChild = node.first + 1;
+			float tNear, tFar;
+			const bool hitNear = intersect(nearChild, t_max, tNear);
+			const bool hitFar  = intersect(farChild,  t_max, tFar);
+			visited += 2;
+			if (hitNear && hitFar)
+			{
+				if (tFar < tNear) { std::swap(nearChild, farChild); std::swap(tNear, tFar); }
+				stack[stackSize++] = { farChild, tFar };
+				index = nearChild;
+				continue;
+			}
+			if (hitNear || hitFar)
+			{
+				index = hitNear ? nearChild : farChild;
+				continue;
+			}
+		}
+
+		// subtrees pushed before a closer hit was found may be out of reach by now
+		while (true)
+		{
+			if (stackSize == 0)
+			{
+				addStatistics();
+				return hit;
+			}
+			--stackSize;
+			if (stack[stackSize].t <= t_max) break;
+			skipped++;
+		}
+		index = stack[stackSize].node;
+	}
+}
+
+AMATH_END_NAMESPACE
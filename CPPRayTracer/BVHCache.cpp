@@ -0,0 +1,110 @@
+#include "BVHCache.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "Trace.hpp"
+#include <chrono>
+#include <filesystem>
+
+AMATH_NAMESPACE
+
+constexpr uint32_t BVHCacheMagic = 0x48564241; // "ABVH"
+constexpr uint32_t BVHCacheVersion = 1;
+constexpr size_t BVHCacheAlignment = 64;
+
+struct BVHCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	int primitiveCount;
+	int nodeCount;
+	uint64_t nodeOffset; // the order array follows the header, nodes start on the next cache line after it
+};
+
+std::string BVHCache::Directory = "bvhcache";
+
+uint64_t BVHCache::Key(const std::vector<AABB>& bounds)
+{
+    // AABB is six packed floats, the whole array can be hashed as it is
+    static_assert(sizeof(AABB) == 6 * sizeof(float), "AABB must not have padding");
+    const int parameters[] = { int(BVHCacheVersion), BVH::MaxLeafSize, BVH::BucketCount, BVH::MaxDepth };
+    const uint64_t key = Helper::Hash64(parameters, sizeof(parameters));
+    return Helper::Hash64(bounds.data(), bounds.size() * sizeof(AABB), key);
+}
+
+static std::string CachePath(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long)key);
+    return (std::filesystem::path(BVHCache::Directory) / name).string();
+}
+
+static size_t NodeOffset(int primitiveCount)
+{
+    return (sizeof(BVHCacheHeader) + size_t(primitiveCount) * sizeof(int) + BVHCacheAlignment - 1) & ~(BVHCacheAlignment - 1);
+}
+
+static bool LoadCached(BVH& bvh, const std::string& path, uint64_t key, int primitiveCount, std::vector<int>& order)
+{
+    auto file = std::make_shared<MappedFile>();
+    if (!file->OpenRead(path.c_str()) || file->Size() < sizeof(BVHCacheHeader)) return false;
+
+    // the key already covers the bounds, the header only guards against a different format or a hash collision in size
+    const BVHCacheHeader& header = *file->As<BVHCacheHeader>();
+    if (header.magic != BVHCacheMagic || header.version != BVHCacheVersion || header.key != key || header.primitiveCount != primitiveCount ||
+        header.nodeOffset != NodeOffset(primitiveCount) || header.nodeOffset + size_t(header.nodeCount) * sizeof(BVHNode) > file->Size()) return false;
+
+    const int* cachedOrder = file->As<int>(sizeof(BVHCacheHeader));
+    order.assign(cachedOrder, cachedOrder + primitiveCount);
+    bvh.View(file->As<BVHNode>(header.nodeOffset), header.nodeCount, file);
+    return true;
+}
+
+static bool Store(const BVH& bvh, const std::string& path, uint64_t key, const std::vector<int>& order)
+{
+    std::error_code error;
+    std::filesystem::create_directories(BVHCache::Directory, error);
+
+    BVHCacheHeader header = {};
+    header.magic = BVHCacheMagic;
+    header.version = BVHCacheVersion;
+    header.key = key;
+    header.primitiveCount = int(order.size());
+    header.nodeCount = bvh.nodeCount;
+    header.nodeOffset = NodeOffset(header.primitiveCount);
+
+    // temp file and rename, a second renderer reading the cache at the same time sees a whole file or none
+    const std::string temporaryPath = path + ".tmp";
+    {
+        MappedFile file;
+        if (!file.Create(temporaryPath.c_str(), header.nodeOffset + size_t(bvh.nodeCount) * sizeof(BVHNode))) return false;
+        memcpy(file.Data(), &header, sizeof(header));
+        memcpy(file.Data() + sizeof(header), order.data(), order.size() * sizeof(int));
+        memcpy(file.Data() + header.nodeOffset, bvh.nodes, size_t(bvh.nodeCount) * sizeof(BVHNode));
+        if (!file.Flush()) return false;
+    }
+    return MappedFile::ReplaceAtomically(temporaryPath, path);
+}
+
+void BVHCache::Build(BVH& bvh, const std::vector<AABB>& bounds, std::vector<int>& order)
+{
+    Trace::Scope scope("bvh cache");
+    if (Directory.empty() || bounds.empty()) return bvh.Build(bounds, order);
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t key = Key(bounds);
+    const std::string path = CachePath(key);
+    if (LoadCached(bvh, path, key, int(bounds.size()), order))
+    {
+        bvh.buildMilliseconds = 0.0f;
+        printf("bvh cache: loaded %s, %d nodes in %.2f ms\n", path.c_str(), bvh.nodeCount,
+               std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        return;
+    }
+
+    bvh.Build(bounds, order);
+    const bool stored = Store(bvh, path, key, order);
+    printf("bvh cache: built %d nodes in %.2f ms, %s %s\n", bvh.nodeCount, bvh.buildMilliseconds, stored ? "stored as" : "failed to store", path.c_str());
+}
+
+AMATH_END_NAMESPACE
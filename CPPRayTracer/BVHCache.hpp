@@ -0,0 +1,20 @@
+#pragma once
+#include "BVH.hpp"
+#include <string>
+
+AMATH_NAMESPACE
+
+// built BVHs stored on disk as "<directory>/<key>.bvh", the key is a 64 bit hash of the primitive bounds
+// and the build parameters. a matching file is mapped and used in place, otherwise the tree is built and stored.
+// scenes that only change camera or sample settings then skip the build on every later run
+namespace BVHCache
+{
+	extern std::string Directory; // empty turns the cache off
+
+	uint64_t Key(const std::vector<AABB>& bounds);
+
+	// same result as bvh.Build(bounds, order)
+	void Build(BVH& bvh, const std::vector<AABB>& bounds, std::vector<int>& order);
+}
+
+AMATH_END_NAMESPACE
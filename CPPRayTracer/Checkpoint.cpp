@@ -0,0 +1,126 @@
+#include "Checkpoint.hpp"
+#include "MappedFile.hpp"
+#include <chrono>
+#include <cstring>
+
+AMATH_NAMESPACE
+
+constexpr uint32_t CheckpointMagic = 0x4B435452; // "RTCK"
+constexpr uint32_t CheckpointVersion = 2;
+constexpr size_t CheckpointAlignment = 64;
+
+struct CheckpointHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	int width, height;
+	int nextSample;
+	uint32_t samplerBytes;
+	uint64_t sceneHash;
+	// element sizes and the framebuffer tiling, a checkpoint from a build with a different layout is rejected instead of misread
+	uint32_t colorBytes, vectorBytes;
+	uint32_t tileSize;
+	uint32_t elementCount; // per buffer, tile padding included
+};
+
+// byte offsets of the sections, each starts on a cache line
+struct CheckpointLayout
+{
+	size_t accumulation, sampleCounts, albedo, normal, depth, sampler, total;
+
+	CheckpointLayout(size_t elementCount, size_t samplerBytes)
+	{
+		size_t offset = 0;
+		auto section = [&](size_t bytes)
+		{
+			const size_t start = (offset + CheckpointAlignment - 1) & ~(CheckpointAlignment - 1);
+			offset = start + bytes;
+			return start;
+		};
+		section(sizeof(CheckpointHeader));
+		accumulation = section(elementCount * sizeof(Color));
+		sampleCounts = section(elementCount * sizeof(uint32_t));
+		albedo		 = section(elementCount * sizeof(Color));
+		normal		 = section(elementCount * sizeof(Vector3));
+		depth		 = section(elementCount * sizeof(float));
+		sampler		 = section(samplerBytes);
+		total = offset;
+	}
+};
+
+bool Checkpoint::Save(const std::string& path, const RenderProgress& progress)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    const size_t elementCount = progress.accumulation.Count();
+    const CheckpointLayout layout(elementCount, progress.sampler.size());
+
+    const std::string temporaryPath = path + ".tmp";
+    {
+        MappedFile file;
+        if (!file.Create(temporaryPath.c_str(), layout.total)) return false;
+
+        CheckpointHeader header = {};
+        header.magic = CheckpointMagic;
+        header.version = CheckpointVersion;
+        header.width = progress.width;
+        header.height = progress.height;
+        header.nextSample = progress.nextSample;
+        header.samplerBytes = uint32_t(progress.sampler.size());
+        header.sceneHash = progress.sceneHash;
+        header.colorBytes = sizeof(Color);
+        header.vectorBytes = sizeof(Vector3);
+        header.tileSize = progress.accumulation.Layout() == FramebufferLayout::Tiled ? Framebuffer<Color>::TileSize : 0;
+        header.elementCount = uint32_t(elementCount);
+
+        uint8_t* data = file.Data();
+        memcpy(data, &header, sizeof(header));
+        // the buffers are stored in their own layout, a resumed frame continues with the same tiling
+        memcpy(data + layout.accumulation, progress.accumulation.Data(), progress.accumulation.Bytes());
+        memcpy(data + layout.sampleCounts, progress.sampleCounts.Data(), progress.sampleCounts.Bytes());
+        memcpy(data + layout.albedo, progress.features.albedo.Data(), progress.features.albedo.Bytes());
+        memcpy(data + layout.normal, progress.features.normal.Data(), progress.features.normal.Bytes());
+        memcpy(data + layout.depth, progress.features.depth.Data(), progress.features.depth.Bytes());
+        memcpy(data + layout.sampler, progress.sampler.data(), progress.sampler.size());
+        // the rename must not overtake the data, otherwise a crash could leave a torn checkpoint behind
+        if (!file.Flush()) return false;
+    }
+
+    if (!MappedFile::ReplaceAtomically(temporaryPath, path)) return false;
+    printf("checkpoint: saved %s at pass %d, %.2f MB in %.2f ms\n", path.c_str(), progress.nextSample, layout.total / (1024.0f * 1024.0f),
+           std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    return true;
+}
+
+bool Checkpoint::Load(const std::string& path, RenderProgress& progress)
+{
+    MappedFile file;
+    if (!file.OpenRead(path.c_str()) || file.Size() < sizeof(CheckpointHeader)) return false;
+
+    const CheckpointHeader& header = *file.As<CheckpointHeader>();
+    if (header.magic != CheckpointMagic || header.version != CheckpointVersion ||
+        header.colorBytes != sizeof(Color) || header.vectorBytes != sizeof(Vector3)) return false;
+
+    if (header.width != progress.width || header.height != progress.height || header.sceneHash != progress.sceneHash)
+    {
+        printf("checkpoint: %s belongs to a different scene or resolution, starting over\n", path.c_str());
+        return false;
+    }
+
+    // progress was sized for this frame already, the stored buffers have to match its layout
+    const uint32_t tileSize = progress.accumulation.Layout() == FramebufferLayout::Tiled ? Framebuffer<Color>::TileSize : 0;
+    if (header.tileSize != tileSize || header.elementCount != progress.accumulation.Count()) return false;
+    const CheckpointLayout layout(header.elementCount, header.samplerBytes);
+    if (file.Size() < layout.total) return false;
+
+    memcpy(progress.accumulation.Data(), file.As<Color>(layout.accumulation), progress.accumulation.Bytes());
+    memcpy(progress.sampleCounts.Data(), file.As<uint32_t>(layout.sampleCounts), progress.sampleCounts.Bytes());
+    memcpy(progress.features.albedo.Data(), file.As<Color>(layout.albedo), progress.features.albedo.Bytes());
+    memcpy(progress.features.normal.Data(), file.As<Vector3>(layout.normal), progress.features.normal.Bytes());
+    memcpy(progress.features.depth.Data(), file.As<float>(layout.depth), progress.features.depth.Bytes());
+    progress.sampler.assign(file.As<char>(layout.sampler), header.samplerBytes);
+    progress.nextSample = header.nextSample;
+    printf("checkpoint: resuming %s at pass %d\n", path.c_str(), progress.nextSample);
+    return true;
+}
+
+AMATH_END_NAMESPACE
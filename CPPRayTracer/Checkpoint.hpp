@@ -0,0 +1,52 @@
+#pragma once
+#include "Hash.hpp"
+#include "Denoiser.hpp"
+#include <string>
+
+AMATH_NAMESPACE
+
+// Helper::Hash64 chained over the fields one by one so padding and vtable pointers never reach the hash
+struct ContentHash
+{
+	uint64_t value = 0;
+
+	void Add(const void* bytes, size_t size) { value = Helper::Hash64(bytes, size, value); }
+	void Add(float x) { Add(&x, sizeof(x)); }
+	void Add(int x)	  { Add(&x, sizeof(x)); }
+	void Add(const Vector3& v) { Add(v.x); Add(v.y); Add(v.z); }
+	void Add(const Color& c)   { Add(c.r); Add(c.g); Add(c.b); Add(c.a); }
+};
+
+// everything needed to continue a frame from the middle: the sample sums, per pixel sample counts,
+// the denoiser features and the sampler. samples are rendered in passes over the image or its region,
+// a priority region adds a second set of passes. nextSample is the first pass that is not in the sums yet.
+// the buffers are tiled the way the frame is rendered
+struct RenderProgress
+{
+	int width = 0, height = 0;
+	int nextSample = 0;
+	uint64_t sceneHash = 0;
+	Framebuffer<Color> accumulation;
+	Framebuffer<uint32_t> sampleCounts;
+	FeatureBuffers features;
+	std::string sampler; // serialized random engine
+
+	void Resize(int _width, int _height)
+	{
+		width = _width; height = _height;
+		nextSample = 0;
+		accumulation.Resize(width, height, FramebufferLayout::Tiled, Color(0.0f));
+		sampleCounts.Resize(width, height, FramebufferLayout::Tiled, 0);
+		features.Resize(width, height, FramebufferLayout::Tiled);
+	}
+};
+
+namespace Checkpoint
+{
+	// copies the progress into a mapping of "<path>.tmp", flushes it and renames it over path
+	bool Save(const std::string& path, const RenderProgress& progress);
+	// fails without touching progress unless the file matches its size and scene hash
+	bool Load(const std::string& path, RenderProgress& progress);
+}
+
+AMATH_END_NAMESPACE
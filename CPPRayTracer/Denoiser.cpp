@@ -0,0 +1,226 @@
+#include "Denoiser.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include <chrono>
+
+AMATH_NAMESPACE
+
+// B3 spline, the 5x5 kernel is its outer product
+static constexpr float Kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+// keeps demodulation finite on black surfaces
+static constexpr float MinAlbedo = 0.01f;
+static constexpr float MinDepth = 0.001f;
+
+// e^x for x <= 0, the relative error is around 1e-5 which is far below what the weights need
+static FINLINE __m256 VECTORCALL ExpNegative(__m256 x)
+{
+    x = _mm256_max_ps(x, _mm256_set1_ps(-80.0f));
+    const __m256 t = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504f));
+    const __m256 whole = _mm256_floor_ps(t);
+    const __m256 f = _mm256_sub_ps(t, whole);
+
+    // 2^f on [0, 1), then 2^whole goes straight into the exponent bits
+    __m256 p = _mm256_set1_ps(1.3333558e-3f);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(9.6181291e-3f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(5.5504109e-2f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(2.4022651e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(6.9314718e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+    const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+}
+
+void Denoiser::Prepare(const Color* color, const FeatureBuffers& features, int originX, int originY)
+{
+    const size_t pixelCount = size_t(width) * height;
+    illumination[0].Resize(pixelCount);
+    illumination[1].Resize(pixelCount);
+    albedo.Resize(pixelCount);
+    normalX.resize(pixelCount); normalY.resize(pixelCount); normalZ.resize(pixelCount);
+    depth.resize(pixelCount);
+
+    // planar copies so 8 neighbouring pixels of a channel are one load, this is where tiled features become scanlines
+    JobSystem::Pool.ParallelFor(height, [&](int y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const size_t p = size_t(y) * width + x;
+            const Color& a = features.albedo.At(originX + x, originY + y);
+            albedo.r[p] = a.r; albedo.g[p] = a.g; albedo.b[p] = a.b;
+            illumination[0].r[p] = color[p].r / Max(a.r, MinAlbedo);
+            illumination[0].g[p] = color[p].g / Max(a.g, MinAlbedo);
+            illumination[0].b[p] = color[p].b / Max(a.b, MinAlbedo);
+
+            const Vector3& n = features.normal.At(originX + x, originY + y);
+            normalX[p] = n.x; normalY[p] = n.y; normalZ[p] = n.z;
+            depth[p] = features.depth.At(originX + x, originY + y);
+        }
+    }, 8);
+}
+
+// reference path for pixels whose taps leave the image, taps are clamped to the border
+void Denoiser::FilterPixel(int x, int y, int step, float invColorSigmaSq, const Planes& source, Planes& destination) const
+{
+    const size_t p = size_t(y) * width + x;
+    const float invNormalSigma = 1.0f / settings.normalSigma;
+    const float invAlbedoSigmaSq = 1.0f / (settings.albedoSigma * settings.albedoSigma);
+    const float invDepthSigma = 1.0f / (settings.depthSigma * step * Max(depth[p], MinDepth));
+
+    float weightSum = 0.0f, sumR = 0.0f, sumG = 0.0f, sumB = 0.0f;
+    for (int dy = -2; dy <= 2; ++dy)
+    {
+        const size_t row = size_t(Clamp(y + dy * step, 0, height - 1)) * width;
+        for (int dx = -2; dx <= 2; ++dx)
+        {
+            const size_t q = row + Clamp(x + dx * step, 0, width - 1);
+
+            const float colorR = source.r[q] - source.r[p], colorG = source.g[q] - source.g[p], colorB = source.b[q] - source.b[p];
+            const float albedoR = albedo.r[q] - albedo.r[p], albedoG = albedo.g[q] - albedo.g[p], albedoB = albedo.b[q] - albedo.b[p];
+            const float normalDistance = Max(1.0f - (normalX[p] * normalX[q] + normalY[p] * normalY[q] + normalZ[p] * normalZ[q]), 0.0f);
+
+            const float exponent = (colorR * colorR + colorG * colorG + colorB * colorB) * invColorSigmaSq
+                                 + normalDistance * invNormalSigma
+                                 + fabsf(depth[q] - depth[p]) * invDepthSigma
+                                 + (albedoR * albedoR + albedoG * albedoG + albedoB * albedoB) * invAlbedoSigmaSq;
+
+            const float weight = Kernel[dy + 2] * Kernel[dx + 2] * expf(-Min(exponent, 80.0f));
+            weightSum += weight;
+            sumR += weight * source.r[q];
+            sumG += weight * source.g[q];
+            sumB += weight * source.b[q];
+        }
+    }
+
+    // the center tap always has a weight, weightSum is never zero
+    destination.r[p] = sumR / weightSum;
+    destination.g[p] = sumG / weightSum;
+    destination.b[p] = sumB / weightSum;
+}
+
+void Denoiser::FilterRow(int y, int step, float invColorSigmaSq, const Planes& source, Planes& destination) const
+{
+    const int reach = 2 * step;
+    const size_t row = size_t(y) * width;
+
+    const __m256 invColor = _mm256_set1_ps(invColorSigmaSq);
+    const __m256 invNormal = _mm256_set1_ps(1.0f / settings.normalSigma);
+    const __m256 invAlbedo = _mm256_set1_ps(1.0f / (settings.albedoSigma * settings.albedoSigma));
+    const __m256 depthScale = _mm256_set1_ps(settings.depthSigma * step);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    int x = 0;
+    for (; x < Min(reach, width); ++x) FilterPixel(x, y, step, invColorSigmaSq, source, destination);
+
+    // every tap of these 8 pixels is inside the row
+    for (; x + 8 + reach <= width; x += 8)
+    {
+        const size_t p = row + x;
+        const __m256 centerR = _mm256_loadu_ps(&source.r[p]), centerG = _mm256_loadu_ps(&source.g[p]), centerB = _mm256_loadu_ps(&source.b[p]);
+        const __m256 albedoR = _mm256_loadu_ps(&albedo.r[p]), albedoG = _mm256_loadu_ps(&albedo.g[p]), albedoB = _mm256_loadu_ps(&albedo.b[p]);
+        const __m256 centerNormalX = _mm256_loadu_ps(&normalX[p]), centerNormalY = _mm256_loadu_ps(&normalY[p]), centerNormalZ = _mm256_loadu_ps(&normalZ[p]);
+        const __m256 centerDepth = _mm256_loadu_ps(&depth[p]);
+        const __m256 invDepth = _mm256_div_ps(one, _mm256_mul_ps(depthScale, _mm256_max_ps(centerDepth, _mm256_set1_ps(MinDepth))));
+
+        __m256 weightSum = zero, sumR = zero, sumG = zero, sumB = zero;
+        for (int dy = -2; dy <= 2; ++dy)
+        {
+            const size_t tapRow = size_t(Clamp(y + dy * step, 0, height - 1)) * width + x;
+            for (int dx = -2; dx <= 2; ++dx)
+            {
+                const size_t q = tapRow + dx * step;
+                const __m256 tapR = _mm256_loadu_ps(&source.r[q]), tapG = _mm256_loadu_ps(&source.g[q]), tapB = _mm256_loadu_ps(&source.b[q]);
+
+                __m256 difference = _mm256_sub_ps(tapR, centerR);
+                __m256 colorDistance = _mm256_mul_ps(difference, difference);
+                difference = _mm256_sub_ps(tapG, centerG);
+                colorDistance = _mm256_fmadd_ps(difference, difference, colorDistance);
+                difference = _mm256_sub_ps(tapB, centerB);
+                colorDistance = _mm256_fmadd_ps(difference, difference, colorDistance);
+
+                difference = _mm256_sub_ps(_mm256_loadu_ps(&albedo.r[q]), albedoR);
+                __m256 albedoDistance = _mm256_mul_ps(difference, difference);
+                difference = _mm256_sub_ps(_mm256_loadu_ps(&albedo.g[q]), albedoG);
+                albedoDistance = _mm256_fmadd_ps(difference, difference, albedoDistance);
+                difference = _mm256_sub_ps(_mm256_loadu_ps(&albedo.b[q]), albedoB);
+                albedoDistance = _mm256_fmadd_ps(difference, difference, albedoDistance);
+
+                __m256 normalDot = _mm256_mul_ps(centerNormalX, _mm256_loadu_ps(&normalX[q]));
+                normalDot = _mm256_fmadd_ps(centerNormalY, _mm256_loadu_ps(&normalY[q]), normalDot);
+                normalDot = _mm256_fmadd_ps(centerNormalZ, _mm256_loadu_ps(&normalZ[q]), normalDot);
+                const __m256 normalDistance = _mm256_max_ps(_mm256_sub_ps(one, normalDot), zero);
+
+                // abs by clearing the sign bit
+                const __m256 depthDistance = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(_mm256_loadu_ps(&depth[q]), centerDepth));
+
+                __m256 exponent = _mm256_mul_ps(colorDistance, invColor);
+                exponent = _mm256_fmadd_ps(normalDistance, invNormal, exponent);
+                exponent = _mm256_fmadd_ps(depthDistance, invDepth, exponent);
+                exponent = _mm256_fmadd_ps(albedoDistance, invAlbedo, exponent);
+
+                const __m256 weight = _mm256_mul_ps(_mm256_set1_ps(Kernel[dy + 2] * Kernel[dx + 2]), ExpNegative(_mm256_sub_ps(zero, exponent)));
+                weightSum = _mm256_add_ps(weightSum, weight);
+                sumR = _mm256_fmadd_ps(weight, tapR, sumR);
+                sumG = _mm256_fmadd_ps(weight, tapG, sumG);
+                sumB = _mm256_fmadd_ps(weight, tapB, sumB);
+            }
+        }
+
+        const __m256 invWeightSum = _mm256_div_ps(one, weightSum);
+        _mm256_storeu_ps(&destination.r[p], _mm256_mul_ps(sumR, invWeightSum));
+        _mm256_storeu_ps(&destination.g[p], _mm256_mul_ps(sumG, invWeightSum));
+        _mm256_storeu_ps(&destination.b[p], _mm256_mul_ps(sumB, invWeightSum));
+    }
+
+    for (; x < width; ++x) FilterPixel(x, y, step, invColorSigmaSq, source, destination);
+}
+
+void Denoiser::Denoise(int _width, int _height, const Color* color, const FeatureBuffers& features, Color* output, int originX, int originY)
+{
+    Trace::Scope scope("denoise");
+    using Clock = std::chrono::high_resolution_clock;
+    const auto start = Clock::now();
+    auto elapsedMs = [&] { return std::chrono::duration<float, std::milli>(Clock::now() - start).count(); };
+
+    width = _width;
+    height = _height;
+    Prepare(color, features, originX, originY);
+
+    int source = 0;
+    float iterationMs = 0.0f;
+    lastIterations = 0;
+
+    for (int i = 0; i < settings.iterations; ++i)
+    {
+        // the next iteration is assumed to cost as much as the last one
+        const float iterationStart = elapsedMs();
+        if (i > 0 && iterationStart + iterationMs > settings.timeBudgetMs) break;
+
+        const int step = 1 << i;
+        const float colorSigma = settings.colorSigma / float(step);
+        const float invColorSigmaSq = 1.0f / (colorSigma * colorSigma);
+        const Planes& from = illumination[source];
+        Planes& to = illumination[source ^ 1];
+
+        JobSystem::Pool.ParallelFor(height, [&](int y) { FilterRow(y, step, invColorSigmaSq, from, to); }, 4);
+
+        source ^= 1;
+        lastIterations++;
+        iterationMs = elapsedMs() - iterationStart;
+    }
+
+    const Planes& result = illumination[source];
+    JobSystem::Pool.ParallelFor(height, [&](int y)
+    {
+        for (size_t p = size_t(y) * width, end = p + width; p < end; ++p)
+        {
+            output[p] = Color(result.r[p] * Max(albedo.r[p], MinAlbedo),
+                              result.g[p] * Max(albedo.g[p], MinAlbedo),
+                              result.b[p] * Max(albedo.b[p], MinAlbedo));
+        }
+    }, 8);
+
+    lastMilliseconds = elapsedMs();
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,68 @@
+#pragma once
+#include "Math/Color.hpp"
+#include "Math/Vector3.hpp"
+#include "Framebuffer.hpp"
+#include <vector>
+
+AMATH_NAMESPACE
+
+// first hit features written next to the color, they guide the denoiser's edge stopping
+// rays that miss everything have albedo one, a zero normal and zero depth
+// the buffers share the layout of the color they are rendered with, the denoiser reads them in scanline order
+struct FeatureBuffers
+{
+	Framebuffer<Color> albedo;
+	Framebuffer<Vector3> normal;
+	Framebuffer<float> depth;
+
+	void Resize(int width, int height, FramebufferLayout layout)
+	{
+		albedo.Resize(width, height, layout, Color(0.0f));
+		normal.Resize(width, height, layout, Vector3::Zero());
+		depth.Resize(width, height, layout, 0.0f);
+	}
+};
+
+struct DenoiserSettings
+{
+	int iterations = 5;			// the filter footprint doubles every iteration, 5 covers 125x125 pixels
+	float colorSigma = 4.0f;	// halved every iteration so later, wider passes only smooth what is left
+	float normalSigma = 0.2f;	// of 1 - dot(n, n')
+	float depthSigma = 0.02f;	// relative depth difference per pixel of filter step
+	float albedoSigma = 0.1f;
+	float timeBudgetMs = 50.0f;	// iterations stop early once the next one would not fit
+};
+
+// edge avoiding a-trous wavelet filter (Dammertz et al. 2010)
+// the color is divided by the albedo before filtering so textures stay sharp and multiplied back at the end.
+// a 5x5 B3 spline kernel is applied with holes of 2^i pixels, rows are split across the job system
+// and 8 pixels of a row are filtered together with AVX
+class Denoiser
+{
+public:
+	DenoiserSettings settings;
+	float lastMilliseconds = 0.0f;
+	int lastIterations = 0;
+
+	// color and output may be the same buffer. an image that is a region of the frame the features were
+	// gathered for reads them from originX, originY on
+	void Denoise(int width, int height, const Color* color, const FeatureBuffers& features, Color* output, int originX = 0, int originY = 0);
+
+private:
+	struct Planes
+	{
+		std::vector<float> r, g, b;
+		void Resize(size_t count) { r.resize(count); g.resize(count); b.resize(count); }
+	};
+
+	int width = 0, height = 0;
+	Planes illumination[2]; // ping pong between iterations
+	Planes albedo;
+	std::vector<float> normalX, normalY, normalZ, depth;
+
+	void Prepare(const Color* color, const FeatureBuffers& features, int originX, int originY);
+	void FilterRow(int y, int step, float invColorSigmaSq, const Planes& source, Planes& destination) const;
+	void FilterPixel(int x, int y, int step, float invColorSigmaSq, const Planes& source, Planes& destination) const;
+};
+
+AMATH_END_NAMESPACE
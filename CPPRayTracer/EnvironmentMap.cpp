@@ -0,0 +1,166 @@
+#include "EnvironmentMap.hpp"
+#include "External/stb_image.h"
+#include "Hash.hpp"
+
+AMATH_NAMESPACE
+
+void BuildAliasTable(const float* weights, int count, AliasEntry* table)
+{
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) sum += weights[i];
+
+    if (sum <= 0.0)
+    {
+        for (int i = 0; i < count; ++i) table[i] = { 1.0f, i };
+        return;
+    }
+
+    // scaled so the average is one, entries below one borrow from entries above
+    std::vector<float> scaled(count);
+    std::vector<int> small, large;
+    small.reserve(count); large.reserve(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        scaled[i] = float(weights[i] * count / sum);
+        (scaled[i] < 1.0f ? small : large).push_back(i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        const int less = small.back(); small.pop_back();
+        const int more = large.back();
+
+        table[less] = { scaled[less], more };
+        scaled[more] = (scaled[more] + scaled[less]) - 1.0f;
+
+        if (scaled[more] < 1.0f)
+        {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // whatever is left is one up to rounding
+    for (int index : large) table[index] = { 1.0f, index };
+    for (int index : small) table[index] = { 1.0f, index };
+}
+
+bool EnvironmentMap::Load(const char* path)
+{
+    Clear();
+
+    int channels;
+    float* pixels = stbi_loadf(path, &width, &height, &channels, 3);
+    if (!pixels)
+    {
+        printf("environment map: failed to load %s (%s)\n", path, stbi_failure_reason());
+        width = height = 0;
+        return false;
+    }
+
+    texels.resize(size_t(width) * height);
+    for (size_t i = 0; i < texels.size(); ++i)
+    {
+        texels[i] = RGBE::FromColor(pixels[i * 3 + 0], pixels[i * 3 + 1], pixels[i * 3 + 2]);
+    }
+    stbi_image_free(pixels);
+    texelHash = Helper::Hash64(texels.data(), texels.size() * sizeof(RGBE));
+
+    BuildDistributions();
+    return true;
+}
+
+void EnvironmentMap::Clear()
+{
+    width = height = 0;
+    texelHash = 0;
+    totalWeight = 0.0f;
+    texels.clear();
+    conditionalAlias.clear();
+    marginalAlias.clear();
+}
+
+// luminance weighted by the solid angle each row covers
+float EnvironmentMap::TexelWeight(int x, int y) const
+{
+    const float sinTheta = sinf(PI * (y + 0.5f) / height);
+    return texels[size_t(y) * width + x].ToColor().Luminance() * sinTheta;
+}
+
+void EnvironmentMap::BuildDistributions()
+{
+    conditionalAlias.resize(size_t(height) * width);
+    marginalAlias.resize(height);
+
+    std::vector<float> rowWeights(width);
+    std::vector<float> rowSums(height);
+    double total = 0.0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        double rowSum = 0.0;
+        for (int x = 0; x < width; ++x)
+        {
+            rowWeights[x] = TexelWeight(x, y);
+            rowSum += rowWeights[x];
+        }
+
+        BuildAliasTable(rowWeights.data(), width, &conditionalAlias[size_t(y) * width]);
+        rowSums[y] = float(rowSum);
+        total += rowSum;
+    }
+
+    BuildAliasTable(rowSums.data(), height, marginalAlias.data());
+    totalWeight = float(total);
+}
+
+Color EnvironmentMap::Lookup(const Vector3& direction) const
+{
+    const float theta = acosf(Clamp(direction.y, -1.0f, 1.0f));
+    float phi = atan2f(direction.z, direction.x);
+    if (phi < 0.0f) phi += TwoPI;
+
+    const int x = Min(int(phi * (1.0f / TwoPI) * width), width - 1);
+    const int y = Min(int(theta * OneDivPI * height), height - 1);
+    return texels[size_t(y) * width + x].ToColor();
+}
+
+float EnvironmentMap::Pdf(const Vector3& direction) const
+{
+    const float theta = acosf(Clamp(direction.y, -1.0f, 1.0f));
+    const float sinTheta = sinf(theta);
+    if (sinTheta <= 0.0f) return 0.0f;
+
+    float phi = atan2f(direction.z, direction.x);
+    if (phi < 0.0f) phi += TwoPI;
+
+    const int x = Min(int(phi * (1.0f / TwoPI) * width), width - 1);
+    const int y = Min(int(theta * OneDivPI * height), height - 1);
+
+    // piecewise constant pdf over the unit square, then jacobian of the equirectangular mapping
+    const float pdfUV = totalWeight > 0.0f ? TexelWeight(x, y) / totalWeight * width * height : 1.0f;
+    return pdfUV / (2.0f * PI * PI * sinTheta);
+}
+
+Color EnvironmentMap::SampleTexel(int x, int y, float offsetU, float offsetV, Vector3& direction, float& pdf) const
+{
+    const float theta = PI * (y + offsetV) / height;
+    const float phi = TwoPI * (x + offsetU) / width;
+    const float sinTheta = sinf(theta);
+
+    direction = Vector3(sinTheta * cosf(phi), cosf(theta), sinTheta * sinf(phi));
+
+    const float pdfUV = totalWeight > 0.0f ? TexelWeight(x, y) / totalWeight * width * height : 1.0f;
+    pdf = sinTheta > 0.0f ? pdfUV / (2.0f * PI * PI * sinTheta) : 0.0f;
+    return texels[size_t(y) * width + x].ToColor();
+}
+
+Color EnvironmentMap::Sample(float u1, float u2, Vector3& direction, float& pdf) const
+{
+    float offsetV, offsetU;
+    const int y = SampleAliasTable(marginalAlias.data(), height, u1, offsetV);
+    const int x = SampleAliasTable(&conditionalAlias[size_t(y) * width], width, u2, offsetU);
+    return SampleTexel(x, y, offsetU, offsetV, direction, pdf);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,96 @@
+#pragma once
+#include "Math/Color.hpp"
+#include "Math/Vector3.hpp"
+#include <vector>
+
+AMATH_NAMESPACE
+
+// shared exponent hdr texel (Greg Ward's RGBE), 4 bytes instead of 12
+struct RGBE
+{
+	uint8 r, g, b, e;
+
+	RGBE() : r(0), g(0), b(0), e(0) {}
+
+	static RGBE FromColor(float red, float green, float blue)
+	{
+		RGBE result;
+		const float maxComponent = Max(red, Max(green, blue));
+		if (maxComponent < 1e-32f) return result;
+
+		int exponent;
+		const float scale = frexpf(maxComponent, &exponent) * 256.0f / maxComponent;
+		result.r = uint8(red * scale);
+		result.g = uint8(green * scale);
+		result.b = uint8(blue * scale);
+		result.e = uint8(exponent + 128);
+		return result;
+	}
+
+	FINLINE Color ToColor() const
+	{
+		if (e == 0) return Color(0.0f, 0.0f, 0.0f);
+		const float scale = ldexpf(1.0f, int(e) - (128 + 8));
+		return Color(r * scale, g * scale, b * scale);
+	}
+};
+
+// O(1) discrete sampling with Vose's alias method
+struct AliasEntry
+{
+	float probability; // chance of keeping this index instead of taking the alias
+	int alias;
+};
+
+void BuildAliasTable(const float* weights, int count, AliasEntry* table);
+
+// returns the sampled index and remaps u to [0, 1) so it can be used again
+FINLINE int SampleAliasTable(const AliasEntry* table, int count, float u, float& remapped)
+{
+	const float scaled = u * count;
+	const int index = Min(int(scaled), count - 1);
+	const float fraction = Min(scaled - index, 0x1.fffffep-1f);
+	const AliasEntry& entry = table[index];
+
+	if (fraction < entry.probability)
+	{
+		remapped = fraction / entry.probability;
+		return index;
+	}
+	remapped = Min((fraction - entry.probability) / (1.0f - entry.probability), 0x1.fffffep-1f);
+	return entry.alias;
+}
+
+// equirectangular hdr environment, importance sampled with a piecewise constant 2D distribution
+// weighted by luminance * sin(theta), sampled through marginal and conditional alias tables
+class EnvironmentMap
+{
+public:
+	int width = 0;
+	int height = 0;
+	uint64_t texelHash = 0; // Helper::Hash64 of the texels, taken once in Load for checkpoint scene hashes
+
+	bool Load(const char* path);
+	void Clear();
+	bool Loaded() const { return !texels.empty(); }
+
+	Color Lookup(const Vector3& direction) const;
+	// pdf of Sample generating direction, with respect to solid angle
+	float Pdf(const Vector3& direction) const;
+
+	// O(1) sampling through the alias tables, direction is normalized
+	Color Sample(float u1, float u2, Vector3& direction, float& pdf) const;
+
+private:
+	std::vector<RGBE> texels;
+
+	std::vector<AliasEntry> conditionalAlias; // height rows of width
+	std::vector<AliasEntry> marginalAlias;
+	float totalWeight = 0.0f;
+
+	float TexelWeight(int x, int y) const;
+	Color SampleTexel(int x, int y, float offsetU, float offsetV, Vector3& direction, float& pdf) const;
+	void BuildDistributions();
+};
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,269 @@
+#include "FloatImage.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+AMATH_NAMESPACE
+
+namespace FloatImage
+{
+    static void FinishStatistics(ImageEncoder::Statistics* statistics, int width, int height, size_t outputBytes, int strips,
+                                 std::chrono::high_resolution_clock::time_point start)
+    {
+        if (!statistics) return;
+        statistics->inputBytes = size_t(width) * height * 3 * sizeof(float);
+        statistics->outputBytes = outputBytes;
+        statistics->strips = strips;
+        statistics->milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    bool WritePfm(const char* path, int width, int height, const Color* pixels, ImageEncoder::Statistics* statistics)
+    {
+        if (!pixels || width <= 0 || height <= 0) return false;
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+
+        // negative scale means little endian
+        size_t written = size_t(fprintf(file, "PF\n%d %d\n-1.0\n", width, height));
+        std::vector<float> row(size_t(width) * 3);
+        bool ok = true;
+        for (int y = height - 1; y >= 0 && ok; --y)
+        {
+            const Color* source = pixels + size_t(y) * width;
+            for (int x = 0; x < width; ++x)
+            {
+                row[x * 3 + 0] = source[x].r;
+                row[x * 3 + 1] = source[x].g;
+                row[x * 3 + 2] = source[x].b;
+            }
+            ok = fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+            written += row.size() * sizeof(float);
+        }
+
+        ok = fclose(file) == 0 && ok;
+        if (ok) FinishStatistics(statistics, width, height, written, 1, start);
+        return ok;
+    }
+
+    bool ReadPfm(const char* path, int& width, int& height, std::vector<Color>& pixels)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file) return false;
+
+        char magic[3] = {};
+        float scale = 0.0f;
+        // the single whitespace character after the scale ends the header
+        bool ok = fscanf(file, "%2s %d %d %f", magic, &width, &height, &scale) == 4 && fgetc(file) != EOF &&
+                  strcmp(magic, "PF") == 0 && scale < 0.0f && width > 0 && height > 0;
+        if (ok)
+        {
+            pixels.resize(size_t(width) * height);
+            std::vector<float> row(size_t(width) * 3);
+            for (int y = height - 1; y >= 0 && ok; --y)
+            {
+                ok = fread(row.data(), sizeof(float), row.size(), file) == row.size();
+                Color* target = pixels.data() + size_t(y) * width;
+                for (int x = 0; x < width && ok; ++x) target[x] = Color(row[x * 3 + 0], row[x * 3 + 1], row[x * 3 + 2]);
+            }
+        }
+        fclose(file);
+        return ok;
+    }
+
+    //------------------------------------------------------------------------------------------------
+    // exr
+
+    constexpr int ExrChannelCount = 3;
+    constexpr int ExrHalf = 1;
+    constexpr uint8_t ExrNoCompression = 0;
+    constexpr uint8_t ExrZipCompression = 3;
+    constexpr int ExrTiledFlag = 0x200;
+
+    template<typename T>
+    static void Append(std::vector<uint8_t>& out, T value)
+    {
+        uint8_t bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T)); // exr is little endian like every platform we build for
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static void AppendString(std::vector<uint8_t>& out, const char* text)
+    {
+        out.insert(out.end(), text, text + strlen(text) + 1);
+    }
+
+    static void AppendAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+    {
+        AppendString(out, name);
+        AppendString(out, type);
+        Append<int32_t>(out, int32_t(value.size()));
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    static void AppendExrHeader(std::vector<uint8_t>& out, int width, int height, int tileSize, bool compress)
+    {
+        Append<uint32_t>(out, 20000630); // magic
+        Append<int32_t>(out, 2 | ExrTiledFlag);
+
+        // channels are stored alphabetically
+        std::vector<uint8_t> value;
+        for (const char* channel : { "B", "G", "R" })
+        {
+            AppendString(value, channel);
+            Append<int32_t>(value, ExrHalf);
+            Append<uint32_t>(value, 0); // pLinear and reserved
+            Append<int32_t>(value, 1);  // x and y sampling
+            Append<int32_t>(value, 1);
+        }
+        value.push_back(0);
+        AppendAttribute(out, "channels", "chlist", value);
+
+        AppendAttribute(out, "compression", "compression", { compress ? ExrZipCompression : ExrNoCompression });
+
+        value.clear();
+        Append<int32_t>(value, 0); Append<int32_t>(value, 0);
+        Append<int32_t>(value, width - 1); Append<int32_t>(value, height - 1);
+        AppendAttribute(out, "dataWindow", "box2i", value);
+        AppendAttribute(out, "displayWindow", "box2i", value);
+
+        AppendAttribute(out, "lineOrder", "lineOrder", { 0 }); // increasing y
+
+        value.clear(); Append<float>(value, 1.0f);
+        AppendAttribute(out, "pixelAspectRatio", "float", value);
+        AppendAttribute(out, "screenWindowWidth", "float", value);
+
+        value.clear(); Append<float>(value, 0.0f); Append<float>(value, 0.0f);
+        AppendAttribute(out, "screenWindowCenter", "v2f", value);
+
+        value.clear();
+        Append<uint32_t>(value, uint32_t(tileSize)); Append<uint32_t>(value, uint32_t(tileSize));
+        value.push_back(0); // one level, round down
+        AppendAttribute(out, "tiles", "tiledesc", value);
+
+        out.push_back(0); // end of header
+    }
+
+    // tile data is scanline after scanline, each holding the B, G and R halves of the line
+    static void ConvertTile(int width, const Color* pixels, int x0, int y0, int tileWidth, int tileHeight, uint16_t* out)
+    {
+        for (int y = 0; y < tileHeight; ++y)
+        {
+            const Color* source = pixels + size_t(y0 + y) * width + x0;
+            uint16_t* b = out + size_t(y) * tileWidth * ExrChannelCount;
+            uint16_t* g = b + tileWidth;
+            uint16_t* r = g + tileWidth;
+            for (int x = 0; x < tileWidth; ++x)
+            {
+                uint16_t half[8];
+                _mm_storeu_si128((__m128i*)half, _mm_cvtps_ph(source[x].vec, _MM_FROUND_TO_NEAREST_INT));
+                r[x] = half[0]; g[x] = half[1]; b[x] = half[2];
+            }
+        }
+    }
+
+    // the zip predictor from the openexr library: bytes split into even and odd halves, then delta coded
+    static void ZipPredict(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+    {
+        out.resize(size);
+        uint8_t* even = out.data();
+        uint8_t* odd = out.data() + (size + 1) / 2;
+        for (size_t i = 0; i < size; ++i) (i & 1 ? *odd++ : *even++) = data[i];
+
+        int previous = out[0];
+        for (size_t i = 1; i < size; ++i)
+        {
+            const int current = out[i];
+            out[i] = uint8_t(current - previous + (128 + 256));
+            previous = current;
+        }
+    }
+
+    bool WriteExr(const char* path, int width, int height, const Color* pixels, const ExrSettings& settings, ImageEncoder::Statistics* statistics)
+    {
+        if (!pixels || width <= 0 || height <= 0 || settings.tileSize <= 0) return false;
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        const int tileSize = settings.tileSize;
+        const int tilesX = (width + tileSize - 1) / tileSize;
+        const int tilesY = (height + tileSize - 1) / tileSize;
+
+        std::vector<uint8_t> header;
+        AppendExrHeader(header, width, height, tileSize, settings.compress);
+        const size_t tableOffset = header.size();
+        std::vector<uint64_t> offsets(size_t(tilesX) * tilesY, 0);
+
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+
+        // the offset table is written as zeros first and patched once every tile position is known
+        bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+        ok = ok && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size();
+        uint64_t position = tableOffset + offsets.size() * sizeof(uint64_t);
+
+        // only one row of tiles is ever held in memory
+        struct Tile
+        {
+            std::vector<uint16_t> halves;
+            std::vector<uint8_t> predicted;
+            std::vector<uint8_t> chunk;
+        };
+        std::vector<Tile> tiles(tilesX);
+
+        for (int ty = 0; ty < tilesY && ok; ++ty)
+        {
+            JobSystem::Pool.ParallelFor(tilesX, [&](int tx)
+            {
+                Tile& tile = tiles[tx];
+                const int x0 = tx * tileSize, y0 = ty * tileSize;
+                const int tileWidth = Min(tileSize, width - x0), tileHeight = Min(tileSize, height - y0);
+
+                tile.halves.resize(size_t(tileWidth) * tileHeight * ExrChannelCount);
+                ConvertTile(width, pixels, x0, y0, tileWidth, tileHeight, tile.halves.data());
+                const uint8_t* raw = reinterpret_cast<const uint8_t*>(tile.halves.data());
+                const size_t rawSize = tile.halves.size() * sizeof(uint16_t);
+
+                tile.chunk.clear();
+                Append<int32_t>(tile.chunk, tx);
+                Append<int32_t>(tile.chunk, ty);
+                Append<int32_t>(tile.chunk, 0); // level x and y
+                Append<int32_t>(tile.chunk, 0);
+
+                std::vector<uint8_t> compressed;
+                if (settings.compress)
+                {
+                    ZipPredict(raw, rawSize, tile.predicted);
+                    ImageEncoder::ZlibCompress(tile.predicted.data(), tile.predicted.size(), compressed);
+                }
+                // readers treat a tile that is exactly the raw size as uncompressed
+                if (settings.compress && compressed.size() < rawSize)
+                {
+                    Append<int32_t>(tile.chunk, int32_t(compressed.size()));
+                    tile.chunk.insert(tile.chunk.end(), compressed.begin(), compressed.end());
+                }
+                else
+                {
+                    Append<int32_t>(tile.chunk, int32_t(rawSize));
+                    tile.chunk.insert(tile.chunk.end(), raw, raw + rawSize);
+                }
+            });
+
+            for (int tx = 0; tx < tilesX && ok; ++tx)
+            {
+                offsets[size_t(ty) * tilesX + tx] = position;
+                ok = fwrite(tiles[tx].chunk.data(), 1, tiles[tx].chunk.size(), file) == tiles[tx].chunk.size();
+                position += tiles[tx].chunk.size();
+            }
+        }
+
+        ok = ok && fseek(file, long(tableOffset), SEEK_SET) == 0;
+        ok = ok && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size();
+        ok = fclose(file) == 0 && ok;
+        if (ok) FinishStatistics(statistics, width, height, size_t(position), tilesX * tilesY, start);
+        return ok;
+    }
+}
+
+AMATH_END_NAMESPACE
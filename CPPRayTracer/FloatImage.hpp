@@ -0,0 +1,26 @@
+#pragma once
+#include "ImageEncoder.hpp"
+
+AMATH_NAMESPACE
+
+// lossless writers for the float accumulation buffer, both stream straight from the caller's pixels
+// so even huge images never need a second full resolution copy. alpha is not written
+namespace FloatImage
+{
+	// little endian rgb 32 bit float, rows are written bottom up one at a time as the format wants
+	bool WritePfm(const char* path, int width, int height, const Color* pixels, ImageEncoder::Statistics* statistics = nullptr);
+	// reads what WritePfm writes back top down, rgb little endian only
+	bool ReadPfm(const char* path, int& width, int& height, std::vector<Color>& pixels);
+
+	// tiled openexr with half float B, G, R channels, one level. tiles are converted and compressed
+	// one row of tiles at a time on the job system, then the offset table is patched in at the end
+	struct ExrSettings
+	{
+		int tileSize = 64;
+		bool compress = true; // ZIP_COMPRESSION, tiles that do not shrink are stored raw like the format allows
+	};
+	bool WriteExr(const char* path, int width, int height, const Color* pixels, const ExrSettings& settings = ExrSettings(),
+	              ImageEncoder::Statistics* statistics = nullptr);
+}
+
+AMATH_END_NAMESPACE
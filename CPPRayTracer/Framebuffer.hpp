@@ -0,0 +1,113 @@
+#pragma once
+#include "Math/Math.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+AMATH_NAMESPACE
+
+enum class FramebufferLayout : uint32_t
+{
+	Scanline,	// rows top down, exactly width * height elements
+	Tiled		// TileSize x TileSize tiles one after another, rows top down inside a tile and tiles in row order
+};
+
+// one value per pixel in either layout. a tile is one contiguous, cache line aligned block, so threads working on
+// different tiles never write to the same line. the edge tiles of a tiled buffer are padded to full tiles,
+// the padding is never handed out. debug builds check every access against width and height
+template<typename T>
+class Framebuffer
+{
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value, "framebuffers hold plain pixel values");
+
+public:
+	static constexpr int TileSize = 8;
+	static constexpr size_t Alignment = 64;
+
+	Framebuffer() = default;
+	Framebuffer(Framebuffer&&) = default;
+	Framebuffer& operator=(Framebuffer&&) = default;
+
+	// keeps the allocation when the element count does not change
+	void Resize(int _width, int _height, FramebufferLayout _layout, const T& value = T())
+	{
+		width = _width; height = _height; layout = _layout;
+		tilesX = (width + TileSize - 1) / TileSize;
+		tilesY = (height + TileSize - 1) / TileSize;
+		const size_t newCount = layout == FramebufferLayout::Tiled ? size_t(tilesX) * tilesY * TileSize * TileSize : size_t(width) * height;
+		if (newCount != count)
+		{
+			storage.reset(newCount ? static_cast<T*>(::operator new(newCount * sizeof(T), std::align_val_t(Alignment))) : nullptr);
+			count = newCount;
+		}
+		Fill(value);
+	}
+
+	void Fill(const T& value) { std::uninitialized_fill_n(storage.get(), count, value); }
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	FramebufferLayout Layout() const { return layout; }
+	int TilesX() const { return tilesX; }
+	int TilesY() const { return tilesY; }
+
+	size_t Index(int x, int y) const
+	{
+		assert(x >= 0 && x < width && y >= 0 && y < height);
+		if (layout == FramebufferLayout::Scanline) return size_t(y) * width + x;
+		const size_t tile = size_t(unsigned(y) / TileSize) * tilesX + unsigned(x) / TileSize;
+		return tile * (TileSize * TileSize) + (unsigned(y) % TileSize) * TileSize + unsigned(x) % TileSize;
+	}
+
+	T& At(int x, int y) { return storage.get()[Index(x, y)]; }
+	const T& At(int x, int y) const { return storage.get()[Index(x, y)]; }
+
+	// raw storage in the buffer's layout, padding included, for checkpoints
+	T* Data() { return storage.get(); }
+	const T* Data() const { return storage.get(); }
+	size_t Count() const { return count; }
+	size_t Bytes() const { return count * sizeof(T); }
+
+	// the conversion to scanline order for output, destination holds width * height values.
+	// convert(value, index) gets the storage index as well, it addresses other buffers of the same size and layout
+	template<typename U, typename Convert>
+	void ToScanlines(U* destination, Convert&& convert) const
+	{
+		ToScanlines(destination, 0, 0, width, height, convert);
+	}
+
+	// the same for the regionWidth x regionHeight pixels at x0, y0, destination holds just those
+	template<typename U, typename Convert>
+	void ToScanlines(U* destination, int x0, int y0, int regionWidth, int regionHeight, Convert&& convert) const
+	{
+		for (int y = 0; y < regionHeight; ++y)
+		{
+			U* out = destination + size_t(y) * regionWidth;
+			for (int x = 0; x < regionWidth;)
+			{
+				// runs up to the next tile edge are contiguous in both layouts
+				const size_t start = Index(x0 + x, y0 + y);
+				const int run = Min(TileSize - (x0 + x) % TileSize, regionWidth - x);
+				for (int i = 0; i < run; ++i) out[x + i] = convert(storage.get()[start + i], start + i);
+				x += run;
+			}
+		}
+	}
+
+private:
+	struct AlignedDelete
+	{
+		void operator()(T* elements) const { ::operator delete(elements, std::align_val_t(Alignment)); }
+	};
+
+	std::unique_ptr<T, AlignedDelete> storage;
+	size_t count = 0;
+	int width = 0, height = 0;
+	int tilesX = 0, tilesY = 0;
+	FramebufferLayout layout = FramebufferLayout::Scanline;
+};
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace Helper
+{
+    // 64 bit sibling of StringToHash for content keys of large buffers (geometry, caches)
+    // MurmurHash64A by Austin Appleby, 8 bytes per step. pass the previous hash as seed to chain buffers together
+    inline uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0)
+    {
+        const uint64_t m = 0xc6a4a7935bd1e995ull;
+        const int r = 47;
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t hash = seed ^ (size * m);
+
+        for (const unsigned char* end = bytes + (size & ~size_t(7)); bytes != end; bytes += 8)
+        {
+            uint64_t k;
+            memcpy(&k, bytes, 8);
+            k *= m; k ^= k >> r; k *= m;
+            hash ^= k;
+            hash *= m;
+        }
+
+        switch (size & 7)
+        {
+            case 7: hash ^= uint64_t(bytes[6]) << 48; [[fallthrough]];
+            case 6: hash ^= uint64_t(bytes[5]) << 40; [[fallthrough]];
+            case 5: hash ^= uint64_t(bytes[4]) << 32; [[fallthrough]];
+            case 4: hash ^= uint64_t(bytes[3]) << 24; [[fallthrough]];
+            case 3: hash ^= uint64_t(bytes[2]) << 16; [[fallthrough]];
+            case 2: hash ^= uint64_t(bytes[1]) << 8;  [[fallthrough]];
+            case 1: hash ^= uint64_t(bytes[0]);
+                    hash *= m;
+        }
+
+        hash ^= hash >> r;
+        hash *= m;
+        hash ^= hash >> r;
+        return hash;
+    }
+}
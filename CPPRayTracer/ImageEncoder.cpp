@@ -0,0 +1,773 @@
+#include "ImageEncoder.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+AMATH_NAMESPACE
+
+namespace ImageEncoder
+{
+    // strips per thread, a few more than one so uneven strips balance out
+    constexpr int StripsPerThread = 4;
+
+    static int PlannedStripCount(int units, int minUnitsPerStrip)
+    {
+        // the pool's size, so --threads limits the strips too
+        const int threads = JobSystem::Pool.ThreadCount();
+        return Clamp(units / Max(minUnitsPerStrip, 1), 1, threads * StripsPerThread);
+    }
+
+    static void AppendBigEndian32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(uint8_t(value >> 24)); out.push_back(uint8_t(value >> 16));
+        out.push_back(uint8_t(value >> 8));  out.push_back(uint8_t(value));
+    }
+
+    //------------------------------------------------------------------------------------------------
+    // jpg, baseline huffman like stb_image_write (Jon Olick's jo_jpeg) with one restart interval per strip
+
+    static const uint8_t ZigZag[64] = { 0,1,5,6,14,15,27,28,2,4,7,13,16,26,29,42,3,8,12,17,25,30,41,43,9,11,18,
+        24,31,40,44,53,10,19,23,32,39,45,52,54,20,22,33,38,46,51,55,60,21,34,37,47,50,56,59,61,35,36,48,49,57,58,62,63 };
+
+    // standard tables from annex K of the jpeg specification, code counts per length 1 - 16 then the values
+    static const uint8_t DcLuminanceCounts[16] = { 0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0 };
+    static const uint8_t DcChrominanceCounts[16] = { 0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0 };
+    static const uint8_t DcValues[12] = { 0,1,2,3,4,5,6,7,8,9,10,11 };
+    static const uint8_t AcLuminanceCounts[16] = { 0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d };
+    static const uint8_t AcLuminanceValues[162] = {
+        0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,
+        0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+        0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+        0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+        0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,
+        0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+        0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa };
+    static const uint8_t AcChrominanceCounts[16] = { 0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77 };
+    static const uint8_t AcChrominanceValues[162] = {
+        0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
+        0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+        0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,
+        0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+        0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,
+        0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+        0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa };
+
+    static const int LuminanceQuantization[64] = { 16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,18,22,
+        37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99 };
+    static const int ChrominanceQuantization[64] = { 17,18,24,47,99,99,99,99,18,21,26,66,99,99,99,99,24,26,56,99,99,99,99,99,47,66,99,99,99,99,99,99,
+        99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99 };
+    // scale factors of the AAN dct
+    static const float AanScale[8] = { 1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
+                                       1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
+
+    struct HuffmanCode
+    {
+        uint16_t code;
+        uint16_t length;
+    };
+
+    // canonical codes in the order of the values
+    static void BuildHuffmanTable(const uint8_t counts[16], const uint8_t* values, HuffmanCode table[256])
+    {
+        memset(table, 0, sizeof(HuffmanCode) * 256);
+        int code = 0, index = 0;
+        for (int length = 1; length <= 16; ++length)
+        {
+            for (int i = 0; i < counts[length - 1]; ++i) table[values[index++]] = { uint16_t(code++), uint16_t(length) };
+            code <<= 1;
+        }
+    }
+
+    struct JpgTables
+    {
+        uint8_t luminanceQuantization[64], chrominanceQuantization[64]; // zigzag order, as stored in DQT
+        float luminanceScale[64], chrominanceScale[64];
+        HuffmanCode dcLuminance[256], acLuminance[256], dcChrominance[256], acChrominance[256];
+        bool subsample;
+
+        explicit JpgTables(int quality)
+        {
+            quality = Clamp(quality, 1, 100);
+            subsample = quality <= 90;
+            quality = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+            for (int i = 0; i < 64; ++i)
+            {
+                luminanceQuantization[ZigZag[i]]   = uint8_t(Clamp((LuminanceQuantization[i] * quality + 50) / 100, 1, 255));
+                chrominanceQuantization[ZigZag[i]] = uint8_t(Clamp((ChrominanceQuantization[i] * quality + 50) / 100, 1, 255));
+            }
+            for (int row = 0, k = 0; row < 8; ++row)
+            {
+                for (int column = 0; column < 8; ++column, ++k)
+                {
+                    luminanceScale[k]   = 1.0f / (luminanceQuantization[ZigZag[k]] * AanScale[row] * AanScale[column]);
+                    chrominanceScale[k] = 1.0f / (chrominanceQuantization[ZigZag[k]] * AanScale[row] * AanScale[column]);
+                }
+            }
+
+            BuildHuffmanTable(DcLuminanceCounts, DcValues, dcLuminance);
+            BuildHuffmanTable(AcLuminanceCounts, AcLuminanceValues, acLuminance);
+            BuildHuffmanTable(DcChrominanceCounts, DcValues, dcChrominance);
+            BuildHuffmanTable(AcChrominanceCounts, AcChrominanceValues, acChrominance);
+        }
+    };
+
+    // msb first, every 0xFF byte is followed by a stuffed zero
+    struct JpgBitWriter
+    {
+        std::vector<uint8_t>& out;
+        uint32_t buffer = 0;
+        int count = 0;
+
+        explicit JpgBitWriter(std::vector<uint8_t>& _out) : out(_out) {}
+
+        FINLINE void Write(uint32_t bits, int length)
+        {
+            count += length;
+            buffer |= bits << (24 - count);
+            while (count >= 8)
+            {
+                const uint8_t byte = uint8_t(buffer >> 16);
+                out.push_back(byte);
+                if (byte == 0xFF) out.push_back(0);
+                buffer <<= 8;
+                count -= 8;
+            }
+        }
+        FINLINE void Write(const HuffmanCode& code) { Write(code.code, code.length); }
+
+        // pads the last byte with ones, required before a restart marker and EOI
+        void Flush()
+        {
+            Write(0x7F, 7);
+            buffer = 0;
+            count = 0;
+        }
+    };
+
+    static FINLINE void Dct(float* d0p, float* d1p, float* d2p, float* d3p, float* d4p, float* d5p, float* d6p, float* d7p)
+    {
+        const float d0 = *d0p, d1 = *d1p, d2 = *d2p, d3 = *d3p, d4 = *d4p, d5 = *d5p, d6 = *d6p, d7 = *d7p;
+        const float tmp0 = d0 + d7, tmp7 = d0 - d7;
+        const float tmp1 = d1 + d6, tmp6 = d1 - d6;
+        const float tmp2 = d2 + d5, tmp5 = d2 - d5;
+        const float tmp3 = d3 + d4, tmp4 = d3 - d4;
+
+        // even part
+        float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+        float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+        *d0p = tmp10 + tmp11;
+        *d4p = tmp10 - tmp11;
+        const float z1 = (tmp12 + tmp13) * 0.707106781f;
+        *d2p = tmp13 + z1;
+        *d6p = tmp13 - z1;
+
+        // odd part
+        tmp10 = tmp4 + tmp5;
+        tmp11 = tmp5 + tmp6;
+        tmp12 = tmp6 + tmp7;
+        const float z5 = (tmp10 - tmp12) * 0.382683433f;
+        const float z2 = tmp10 * 0.541196100f + z5;
+        const float z4 = tmp12 * 1.306562965f + z5;
+        const float z3 = tmp11 * 0.707106781f;
+        const float z11 = tmp7 + z3, z13 = tmp7 - z3;
+        *d5p = z13 + z2;
+        *d3p = z13 - z2;
+        *d1p = z11 + z4;
+        *d7p = z11 - z4;
+    }
+
+    // magnitude category and the bits that follow it
+    static FINLINE HuffmanCode ValueBits(int value)
+    {
+        int magnitude = value < 0 ? -value : value;
+        value = value < 0 ? value - 1 : value;
+        uint16_t length = 1;
+        while (magnitude >>= 1) ++length;
+        return { uint16_t(value & ((1 << length) - 1)), length };
+    }
+
+    // transforms, quantizes and writes one 8x8 block, returns its dc for the next block's prediction
+    static int EncodeBlock(JpgBitWriter& writer, float* block, int stride, const float* scale, int dc, const HuffmanCode* dcTable, const HuffmanCode* acTable)
+    {
+        for (int offset = 0; offset < stride * 8; offset += stride)
+        {
+            float* d = block + offset;
+            Dct(d, d + 1, d + 2, d + 3, d + 4, d + 5, d + 6, d + 7);
+        }
+        for (int offset = 0; offset < 8; ++offset)
+        {
+            float* d = block + offset;
+            Dct(d, d + stride, d + stride * 2, d + stride * 3, d + stride * 4, d + stride * 5, d + stride * 6, d + stride * 7);
+        }
+
+        int coefficients[64];
+        for (int y = 0, j = 0; y < 8; ++y)
+        {
+            for (int x = 0; x < 8; ++x, ++j)
+            {
+                const float v = block[y * stride + x] * scale[j];
+                coefficients[ZigZag[j]] = int(v < 0 ? v - 0.5f : v + 0.5f);
+            }
+        }
+
+        const int difference = coefficients[0] - dc;
+        if (difference == 0) writer.Write(dcTable[0]);
+        else
+        {
+            const HuffmanCode bits = ValueBits(difference);
+            writer.Write(dcTable[bits.length]);
+            writer.Write(bits);
+        }
+
+        int last = 63;
+        while (last > 0 && coefficients[last] == 0) --last;
+
+        for (int i = 1; i <= last; ++i)
+        {
+            const int start = i;
+            while (coefficients[i] == 0) ++i;
+            int zeroes = i - start;
+            for (; zeroes >= 16; zeroes -= 16) writer.Write(acTable[0xF0]);
+
+            const HuffmanCode bits = ValueBits(coefficients[i]);
+            writer.Write(acTable[(zeroes << 4) + bits.length]);
+            writer.Write(bits);
+        }
+        if (last != 63) writer.Write(acTable[0x00]); // end of block
+        return coefficients[0];
+    }
+
+    // encodes mcu rows [mcuRowBegin, mcuRowEnd) as one restart interval, predictors start at zero
+    static void EncodeJpgStrip(const JpgTables& tables, int width, int height, const Color32* pixels, int mcuRowBegin, int mcuRowEnd, std::vector<uint8_t>& out)
+    {
+        const int mcuSize = tables.subsample ? 16 : 8;
+        JpgBitWriter writer(out);
+        int dcY = 0, dcU = 0, dcV = 0;
+
+        for (int y = mcuRowBegin * mcuSize; y < mcuRowEnd * mcuSize; y += mcuSize)
+        {
+            for (int x = 0; x < width; x += mcuSize)
+            {
+                float Y[256], U[256], V[256];
+                for (int row = y, position = 0; row < y + mcuSize; ++row)
+                {
+                    // the edge pixels are repeated past the end of the image
+                    const Color32* line = pixels + size_t(Min(row, height - 1)) * width;
+                    for (int column = x; column < x + mcuSize; ++column, ++position)
+                    {
+                        const Color32 pixel = line[Min(column, width - 1)];
+                        const float r = pixel.r, g = pixel.g, b = pixel.b;
+                        Y[position] = +0.29900f * r + 0.58700f * g + 0.11400f * b - 128;
+                        U[position] = -0.16874f * r - 0.33126f * g + 0.50000f * b;
+                        V[position] = +0.50000f * r - 0.41869f * g - 0.08131f * b;
+                    }
+                }
+
+                if (!tables.subsample)
+                {
+                    dcY = EncodeBlock(writer, Y, 8, tables.luminanceScale, dcY, tables.dcLuminance, tables.acLuminance);
+                    dcU = EncodeBlock(writer, U, 8, tables.chrominanceScale, dcU, tables.dcChrominance, tables.acChrominance);
+                    dcV = EncodeBlock(writer, V, 8, tables.chrominanceScale, dcV, tables.dcChrominance, tables.acChrominance);
+                    continue;
+                }
+
+                dcY = EncodeBlock(writer, Y + 0,   16, tables.luminanceScale, dcY, tables.dcLuminance, tables.acLuminance);
+                dcY = EncodeBlock(writer, Y + 8,   16, tables.luminanceScale, dcY, tables.dcLuminance, tables.acLuminance);
+                dcY = EncodeBlock(writer, Y + 128, 16, tables.luminanceScale, dcY, tables.dcLuminance, tables.acLuminance);
+                dcY = EncodeBlock(writer, Y + 136, 16, tables.luminanceScale, dcY, tables.dcLuminance, tables.acLuminance);
+
+                float subU[64], subV[64];
+                for (int yy = 0, position = 0; yy < 8; ++yy)
+                {
+                    for (int xx = 0; xx < 8; ++xx, ++position)
+                    {
+                        const int j = yy * 32 + xx * 2;
+                        subU[position] = (U[j] + U[j + 1] + U[j + 16] + U[j + 17]) * 0.25f;
+                        subV[position] = (V[j] + V[j + 1] + V[j + 16] + V[j + 17]) * 0.25f;
+                    }
+                }
+                dcU = EncodeBlock(writer, subU, 8, tables.chrominanceScale, dcU, tables.dcChrominance, tables.acChrominance);
+                dcV = EncodeBlock(writer, subV, 8, tables.chrominanceScale, dcV, tables.dcChrominance, tables.acChrominance);
+            }
+        }
+        writer.Flush();
+    }
+
+    static void AppendJpgHeader(std::vector<uint8_t>& out, const JpgTables& tables, int width, int height, int restartInterval)
+    {
+        static const uint8_t head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x84,0 };
+        const uint8_t head1[] = { 0xFF,0xC0,0,0x11,8,uint8_t(height >> 8),uint8_t(height),uint8_t(width >> 8),uint8_t(width),
+                                  3,1,uint8_t(tables.subsample ? 0x22 : 0x11),0,2,0x11,1,3,0x11,1,0xFF,0xC4,0x01,0xA2,0 };
+        const uint8_t restart[] = { 0xFF,0xDD,0,4,uint8_t(restartInterval >> 8),uint8_t(restartInterval) };
+        static const uint8_t head2[] = { 0xFF,0xDA,0,0xC,3,1,0,2,0x11,3,0x11,0,0x3F,0 };
+
+        auto append = [&](const uint8_t* data, size_t size) { out.insert(out.end(), data, data + size); };
+        append(head0, sizeof(head0));
+        append(tables.luminanceQuantization, 64);
+        out.push_back(1);
+        append(tables.chrominanceQuantization, 64);
+        append(head1, sizeof(head1));
+        append(DcLuminanceCounts, 16);
+        append(DcValues, sizeof(DcValues));
+        out.push_back(0x10);
+        append(AcLuminanceCounts, 16);
+        append(AcLuminanceValues, sizeof(AcLuminanceValues));
+        out.push_back(1);
+        append(DcChrominanceCounts, 16);
+        append(DcValues, sizeof(DcValues));
+        out.push_back(0x11);
+        append(AcChrominanceCounts, 16);
+        append(AcChrominanceValues, sizeof(AcChrominanceValues));
+        append(restart, sizeof(restart));
+        append(head2, sizeof(head2));
+    }
+
+    bool EncodeJpg(int width, int height, const Color32* pixels, int quality, std::vector<uint8_t>& output, Statistics* statistics)
+    {
+        if (!pixels || width <= 0 || height <= 0 || width > 65535 || height > 65535) return false;
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        const JpgTables tables(quality);
+        const int mcuSize = tables.subsample ? 16 : 8;
+        const int mcusPerRow = (width + mcuSize - 1) / mcuSize;
+        const int mcuRows = (height + mcuSize - 1) / mcuSize;
+
+        // the restart interval counts mcus and has to fit 16 bits
+        const int maxRowsPerStrip = Max(65535 / mcusPerRow, 1);
+        int stripCount = PlannedStripCount(mcuRows, 1);
+        int rowsPerStrip = Min((mcuRows + stripCount - 1) / stripCount, maxRowsPerStrip);
+        stripCount = (mcuRows + rowsPerStrip - 1) / rowsPerStrip;
+
+        std::vector<std::vector<uint8_t>> strips(stripCount);
+        JobSystem::Pool.ParallelFor(stripCount, [&](int strip)
+        {
+            strips[strip].reserve(size_t(width) * mcuSize * rowsPerStrip / 4);
+            EncodeJpgStrip(tables, width, height, pixels, strip * rowsPerStrip, Min((strip + 1) * rowsPerStrip, mcuRows), strips[strip]);
+        });
+
+        output.clear();
+        AppendJpgHeader(output, tables, width, height, stripCount > 1 ? rowsPerStrip * mcusPerRow : 0);
+        for (int strip = 0; strip < stripCount; ++strip)
+        {
+            output.insert(output.end(), strips[strip].begin(), strips[strip].end());
+            // RST0 - RST7 between intervals
+            if (strip + 1 < stripCount) { output.push_back(0xFF); output.push_back(uint8_t(0xD0 + (strip & 7))); }
+        }
+        output.push_back(0xFF);
+        output.push_back(0xD9);
+
+        if (statistics)
+        {
+            statistics->inputBytes = size_t(width) * height * 3;
+            statistics->outputBytes = output.size();
+            statistics->strips = stripCount;
+            statistics->milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------------------------
+    // png, rgba8 with per row filters, each strip is a fixed huffman deflate block followed by a sync flush
+
+    struct CrcTable
+    {
+        uint32_t entries[256];
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    };
+
+    static uint32_t Crc32(const uint8_t* data, size_t size)
+    {
+        static const CrcTable table;
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; ++i) crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    constexpr uint32_t AdlerBase = 65521;
+
+    static uint32_t Adler32(const uint8_t* data, size_t size)
+    {
+        uint32_t a = 1, b = 0;
+        while (size > 0)
+        {
+            // the largest run that cannot overflow before the modulo
+            const size_t run = Min(size, size_t(5552));
+            for (size_t i = 0; i < run; ++i) { a += data[i]; b += a; }
+            a %= AdlerBase; b %= AdlerBase;
+            data += run; size -= run;
+        }
+        return (b << 16) | a;
+    }
+
+    // adler32 of the concatenation from the checksums of both parts, same as zlib's adler32_combine
+    static uint32_t Adler32Combine(uint32_t first, uint32_t second, size_t secondSize)
+    {
+        const uint32_t remainder = uint32_t(secondSize % AdlerBase);
+        uint32_t sum1 = first & 0xFFFF;
+        uint32_t sum2 = uint32_t((uint64_t(remainder) * sum1) % AdlerBase);
+        sum1 += (second & 0xFFFF) + AdlerBase - 1;
+        sum2 += ((first >> 16) & 0xFFFF) + ((second >> 16) & 0xFFFF) + AdlerBase - remainder;
+        if (sum1 >= AdlerBase) sum1 -= AdlerBase;
+        if (sum1 >= AdlerBase) sum1 -= AdlerBase;
+        if (sum2 >= AdlerBase * 2) sum2 -= AdlerBase * 2;
+        if (sum2 >= AdlerBase) sum2 -= AdlerBase;
+        return (sum2 << 16) | sum1;
+    }
+
+    static void AppendChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+    {
+        AppendBigEndian32(out, uint32_t(size));
+        const size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        AppendBigEndian32(out, Crc32(out.data() + typeOffset, size + 4));
+    }
+
+    static FINLINE uint8_t Paeth(int a, int b, int c)
+    {
+        const int p = a + b - c;
+        const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        if (pa <= pb && pa <= pc) return uint8_t(a);
+        return uint8_t(pb <= pc ? b : c);
+    }
+
+    // each row gets the filter with the smallest sum of absolute signed bytes, the usual libpng heuristic
+    static void FilterRows(int width, const Color32* pixels, int rowBegin, int rowEnd, std::vector<uint8_t>& filtered)
+    {
+        const int rowBytes = width * 4;
+        filtered.resize(size_t(rowEnd - rowBegin) * (rowBytes + 1));
+        std::vector<uint8_t> candidates(size_t(rowBytes) * 5);
+
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+            const uint8_t* current = (const uint8_t*)(pixels + size_t(y) * width);
+            const uint8_t* previous = y > 0 ? (const uint8_t*)(pixels + size_t(y - 1) * width) : nullptr;
+
+            int best = 0;
+            int bestScore = INT32_MAX;
+            for (int filter = 0; filter < 5; ++filter)
+            {
+                uint8_t* line = &candidates[size_t(filter) * rowBytes];
+                int score = 0;
+                for (int i = 0; i < rowBytes; ++i)
+                {
+                    const int a = i >= 4 ? current[i - 4] : 0;
+                    const int b = previous ? previous[i] : 0;
+                    const int c = i >= 4 && previous ? previous[i - 4] : 0;
+                    uint8_t value = current[i];
+                    switch (filter)
+                    {
+                        case 1: value = uint8_t(value - a); break;
+                        case 2: value = uint8_t(value - b); break;
+                        case 3: value = uint8_t(value - ((a + b) >> 1)); break;
+                        case 4: value = uint8_t(value - Paeth(a, b, c)); break;
+                    }
+                    line[i] = value;
+                    score += abs(int(int8_t(value)));
+                }
+                if (score < bestScore) { bestScore = score; best = filter; }
+            }
+
+            uint8_t* destination = &filtered[size_t(y - rowBegin) * (rowBytes + 1)];
+            destination[0] = uint8_t(best);
+            memcpy(destination + 1, &candidates[size_t(best) * rowBytes], rowBytes);
+        }
+    }
+
+    // lsb first as deflate wants it
+    struct DeflateBitWriter
+    {
+        std::vector<uint8_t>& out;
+        uint64_t buffer = 0;
+        int count = 0;
+
+        explicit DeflateBitWriter(std::vector<uint8_t>& _out) : out(_out) {}
+
+        FINLINE void Write(uint32_t bits, int length)
+        {
+            buffer |= uint64_t(bits) << count;
+            count += length;
+            while (count >= 8)
+            {
+                out.push_back(uint8_t(buffer));
+                buffer >>= 8;
+                count -= 8;
+            }
+        }
+
+        void AlignToByte()
+        {
+            if (count > 0) out.push_back(uint8_t(buffer));
+            buffer = 0;
+            count = 0;
+        }
+    };
+
+    constexpr int MinMatchLength = 3;
+    constexpr int MaxMatchLength = 258;
+
+    static const uint16_t LengthBase[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+    static const uint8_t  LengthExtra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+    static const uint16_t DistanceBase[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+    static const uint8_t  DistanceExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+    // the fixed literal/length and distance codes of rfc 1951 section 3.2.6, bit reversed for the lsb first writer,
+    // plus lookups from match length and distance to their codes
+    struct FixedHuffman
+    {
+        uint16_t literalCode[288];
+        uint8_t literalLength[288];
+        uint16_t distanceCode[30];
+        uint8_t lengthToCode[MaxMatchLength + 1];
+        uint8_t distanceToCode[512]; // distances up to 256 directly, larger ones by (distance - 1) >> 7
+
+        static uint16_t Reverse(uint32_t code, int length)
+        {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+            return uint16_t(reversed);
+        }
+
+        FixedHuffman()
+        {
+            for (int symbol = 0; symbol < 288; ++symbol)
+            {
+                uint32_t code; int length;
+                if (symbol < 144)      { code = 0x30 + symbol;        length = 8; }
+                else if (symbol < 256) { code = 0x190 + symbol - 144; length = 9; }
+                else if (symbol < 280) { code = symbol - 256;         length = 7; }
+                else                   { code = 0xC0 + symbol - 280;  length = 8; }
+                literalCode[symbol] = Reverse(code, length);
+                literalLength[symbol] = uint8_t(length);
+            }
+            for (int code = 0; code < 30; ++code) distanceCode[code] = Reverse(code, 5);
+
+            for (int length = 3, code = 0; length <= MaxMatchLength; ++length)
+            {
+                while (code < 28 && length >= LengthBase[code + 1]) ++code;
+                lengthToCode[length] = uint8_t(code);
+            }
+            for (int distance = 1, code = 0; distance <= 32768; ++distance)
+            {
+                while (code < 29 && distance >= DistanceBase[code + 1]) ++code;
+                if (distance <= 256) distanceToCode[distance - 1] = uint8_t(code);
+                else distanceToCode[256 + ((distance - 1) >> 7)] = uint8_t(code);
+            }
+        }
+    };
+
+    static const FixedHuffman Fixed;
+
+    static FINLINE void WriteFixedSymbol(DeflateBitWriter& writer, int symbol)
+    {
+        writer.Write(Fixed.literalCode[symbol], Fixed.literalLength[symbol]);
+    }
+
+    static FINLINE void WriteMatch(DeflateBitWriter& writer, int length, int distance)
+    {
+        const int lengthCode = Fixed.lengthToCode[length];
+        WriteFixedSymbol(writer, 257 + lengthCode);
+        if (LengthExtra[lengthCode]) writer.Write(length - LengthBase[lengthCode], LengthExtra[lengthCode]);
+
+        const int distanceCode = distance <= 256 ? Fixed.distanceToCode[distance - 1] : Fixed.distanceToCode[256 + ((distance - 1) >> 7)];
+        writer.Write(Fixed.distanceCode[distanceCode], 5);
+        if (DistanceExtra[distanceCode]) writer.Write(distance - DistanceBase[distanceCode], DistanceExtra[distanceCode]);
+    }
+
+    constexpr int HashBits = 15;
+    constexpr int MaxChain = 32;
+    constexpr int WindowSize = 32768;
+
+    static FINLINE uint32_t CountTrailingZeros64(uint64_t x)
+    {
+    #ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return uint32_t(index);
+    #else
+        return uint32_t(__builtin_ctzll(x));
+    #endif
+    }
+
+    // compares 8 bytes at a time, the first differing byte is the lowest set bit of the xor
+    static FINLINE int MatchLength(const uint8_t* a, const uint8_t* b, int maxLength)
+    {
+        int length = 0;
+        while (length + 8 <= maxLength)
+        {
+            uint64_t x, y;
+            memcpy(&x, a + length, 8);
+            memcpy(&y, b + length, 8);
+            if (x != y) return length + int(CountTrailingZeros64(x ^ y) >> 3);
+            length += 8;
+        }
+        while (length < maxLength && a[length] == b[length]) ++length;
+        return length;
+    }
+
+    // lz77 with hash chains and one step lazy matching, matches never reach into another strip
+    static void DeflateStrip(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+    {
+        DeflateBitWriter writer(out);
+        writer.Write(0, 1); // not the final block
+        writer.Write(1, 2); // fixed huffman
+
+        std::vector<int> head(size_t(1) << HashBits, -1);
+        std::vector<int> previous(size);
+
+        auto hash = [&](size_t p) { return (uint32_t(data[p] | data[p + 1] << 8 | data[p + 2] << 16) * 2654435761u) >> (32 - HashBits); };
+        auto insert = [&](size_t p)
+        {
+            if (p + MinMatchLength > size) return;
+            const uint32_t h = hash(p);
+            previous[p] = head[h];
+            head[h] = int(p);
+        };
+        auto findMatch = [&](size_t p, int& distance)
+        {
+            if (p + MinMatchLength > size) return 0;
+            const int maxLength = int(Min(size - p, size_t(MaxMatchLength)));
+            int bestLength = 0;
+            int candidate = head[hash(p)];
+            for (int chain = 0; candidate >= 0 && chain < MaxChain; ++chain)
+            {
+                if (p - candidate > WindowSize) break;
+                const int length = MatchLength(data + candidate, data + p, maxLength);
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    distance = int(p - candidate);
+                    if (length == maxLength) break;
+                }
+                candidate = previous[candidate];
+            }
+            return bestLength >= MinMatchLength ? bestLength : 0;
+        };
+
+        size_t p = 0;
+        int length = -1, distance = 0; // match at p if it was already searched as the lazy candidate
+        while (p < size)
+        {
+            if (length < 0) length = findMatch(p, distance);
+            insert(p);
+
+            int nextDistance = 0;
+            const int nextLength = length > 0 && p + 1 < size ? findMatch(p + 1, nextDistance) : 0;
+            if (length == 0 || nextLength > length)
+            {
+                WriteFixedSymbol(writer, data[p]);
+                ++p;
+                // the lazy search already found the match at the new position
+                length = length == 0 ? -1 : nextLength;
+                distance = nextDistance;
+                continue;
+            }
+
+            WriteMatch(writer, length, distance);
+            for (size_t k = p + 1; k < p + length; ++k) insert(k);
+            p += length;
+            length = -1;
+        }
+        WriteFixedSymbol(writer, 256); // end of block
+
+        // sync flush, an empty stored block leaves the stream byte aligned for the next strip
+        writer.Write(0, 3);
+        writer.AlignToByte();
+        const uint8_t emptyStored[4] = { 0x00, 0x00, 0xFF, 0xFF };
+        out.insert(out.end(), emptyStored, emptyStored + 4);
+    }
+
+    bool EncodePng(int width, int height, const Color32* pixels, std::vector<uint8_t>& output, Statistics* statistics)
+    {
+        if (!pixels || width <= 0 || height <= 0) return false;
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        const int stripCount = PlannedStripCount(height, 16);
+        const int rowsPerStrip = (height + stripCount - 1) / stripCount;
+
+        struct Strip
+        {
+            std::vector<uint8_t> chunk; // complete IDAT chunk, the last one is finished after all strips
+            std::vector<uint8_t> deflated;
+            uint32_t adler;
+            size_t filteredSize;
+        };
+        std::vector<Strip> strips(stripCount);
+
+        JobSystem::Pool.ParallelFor(stripCount, [&](int index)
+        {
+            Strip& strip = strips[index];
+            const int rowBegin = index * rowsPerStrip, rowEnd = Min(rowBegin + rowsPerStrip, height);
+
+            std::vector<uint8_t> filtered;
+            FilterRows(width, pixels, rowBegin, rowEnd, filtered);
+            strip.adler = Adler32(filtered.data(), filtered.size());
+            strip.filteredSize = filtered.size();
+
+            // zlib header, 32k window and the fast compression level
+            if (index == 0) { strip.deflated.push_back(0x78); strip.deflated.push_back(0x5E); }
+            DeflateStrip(filtered.data(), filtered.size(), strip.deflated);
+            if (index + 1 < stripCount) AppendChunk(strip.chunk, "IDAT", strip.deflated.data(), strip.deflated.size());
+        });
+
+        // the stream ends with an empty final block and the adler32 of every strip
+        uint32_t adler = strips[0].adler;
+        for (int i = 1; i < stripCount; ++i) adler = Adler32Combine(adler, strips[i].adler, strips[i].filteredSize);
+        Strip& last = strips.back();
+        last.deflated.push_back(0x03);
+        last.deflated.push_back(0x00);
+        AppendBigEndian32(last.deflated, adler);
+        AppendChunk(last.chunk, "IDAT", last.deflated.data(), last.deflated.size());
+
+        static const uint8_t signature[8] = { 0x89,'P','N','G',0x0D,0x0A,0x1A,0x0A };
+        std::vector<uint8_t> header;
+        AppendBigEndian32(header, uint32_t(width));
+        AppendBigEndian32(header, uint32_t(height));
+        const uint8_t format[5] = { 8, 6, 0, 0, 0 }; // 8 bit rgba, deflate, adaptive filtering, not interlaced
+        header.insert(header.end(), format, format + 5);
+
+        output.clear();
+        output.insert(output.end(), signature, signature + 8);
+        AppendChunk(output, "IHDR", header.data(), header.size());
+        for (const Strip& strip : strips) output.insert(output.end(), strip.chunk.begin(), strip.chunk.end());
+        AppendChunk(output, "IEND", nullptr, 0);
+
+        if (statistics)
+        {
+            statistics->inputBytes = size_t(width) * height * 4;
+            statistics->outputBytes = output.size();
+            statistics->strips = stripCount;
+            statistics->milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        return true;
+    }
+
+    void ZlibCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+    {
+        output.clear();
+        output.push_back(0x78); output.push_back(0x5E);
+        DeflateStrip(data, size, output);
+        output.push_back(0x03); output.push_back(0x00);
+        AppendBigEndian32(output, Adler32(data, size));
+    }
+
+    bool WriteFile(const char* path, const std::vector<uint8_t>& data)
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+        const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+        return fclose(file) == 0 && written;
+    }
+}
+
+AMATH_END_NAMESPACE
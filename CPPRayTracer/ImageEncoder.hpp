@@ -0,0 +1,34 @@
+#pragma once
+#include "Math/Color.hpp"
+#include <cstdint>
+#include <vector>
+
+AMATH_NAMESPACE
+
+// jpg and png encoders that split the image into horizontal strips and compress the strips on the job system.
+// the output is a standard file: jpg strips are separated by restart markers (DRI/RSTn) and png strips are
+// independent deflate blocks ended with a sync flush, one IDAT chunk each, so they can simply be concatenated
+namespace ImageEncoder
+{
+	struct Statistics
+	{
+		size_t inputBytes = 0;
+		size_t outputBytes = 0;
+		int strips = 0;
+		float milliseconds = 0.0f;
+
+		float MegabytesPerSecond() const { return milliseconds > 0.0f ? float(inputBytes) / (1024.0f * 1024.0f) / (milliseconds * 0.001f) : 0.0f; }
+	};
+
+	// pixels are rows top down, alpha is ignored by the jpg encoder. quality is 1 - 100,
+	// above 90 chroma is stored at full resolution, otherwise 4:2:0 like stb_image_write
+	bool EncodeJpg(int width, int height, const Color32* pixels, int quality, std::vector<uint8_t>& output, Statistics* statistics = nullptr);
+	bool EncodePng(int width, int height, const Color32* pixels, std::vector<uint8_t>& output, Statistics* statistics = nullptr);
+
+	// single threaded zlib stream of the whole buffer, used for the compressed tiles of other formats
+	void ZlibCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+
+	bool WriteFile(const char* path, const std::vector<uint8_t>& data);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,148 @@
+#include "ImageWriter.hpp"
+#include "FloatImage.hpp"
+#include "ImageEncoder.hpp"
+#include "Trace.hpp"
+#include "External/stb_image_write.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+AMATH_NAMESPACE
+
+void ImageWriter::Start(int bufferCount)
+{
+    Stop();
+
+    buffers.clear();
+    freeBuffers.clear();
+    for (int i = 0; i < Max(bufferCount, 1); ++i)
+    {
+        buffers.push_back(std::make_unique<OutputImage>());
+        freeBuffers.push_back(buffers.back().get());
+    }
+    queue.reserve(buffers.size());
+
+    stopping = false;
+    thread = std::thread([this] { WriterLoop(); });
+}
+
+void ImageWriter::Stop()
+{
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    thread.join();
+}
+
+OutputImage* ImageWriter::AcquireBuffer()
+{
+    if (!Running()) Start();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    queueChanged.wait(lock, [&] { return !freeBuffers.empty(); });
+    OutputImage* image = freeBuffers.back();
+    freeBuffers.pop_back();
+    return image;
+}
+
+void ImageWriter::Submit(OutputImage* image)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(image);
+    }
+    queueChanged.notify_all();
+}
+
+void ImageWriter::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    queueChanged.wait(lock, [&] { return queue.empty() && writing == 0; });
+}
+
+void ImageWriter::WriterLoop()
+{
+    Trace::SetThreadName("image writer");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        queueChanged.wait(lock, [&] { return stopping || !queue.empty(); });
+        // drain the queue before stopping so no submitted frame is lost
+        if (queue.empty()) return;
+
+        OutputImage* image = queue.front();
+        queue.erase(queue.begin());
+        writing++;
+        lock.unlock();
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        {
+            Trace::Scope scope("image write");
+            Write(*image);
+        }
+        lastWriteMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        framesWritten++;
+
+        lock.lock();
+        writing--;
+        freeBuffers.push_back(image);
+        queueChanged.notify_all();
+    }
+}
+
+static std::string Extension(const std::string& path)
+{
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(tolower(c)); });
+    return extension;
+}
+
+bool ImageWriter::IsFloatFormat(const std::string& path)
+{
+    const std::string extension = Extension(path);
+    return extension == "pfm" || extension == "exr";
+}
+
+bool ImageWriter::Write(const OutputImage& image)
+{
+    const std::string extension = Extension(image.path);
+    const char* path = image.path.c_str();
+    const void* pixels = image.pixels.data();
+    int result = 0;
+
+    if (extension == "bmp") result = stbi_write_bmp(path, image.width, image.height, 4, pixels);
+    else if (extension == "tga") result = stbi_write_tga(path, image.width, image.height, 4, pixels);
+    else
+    {
+        ImageEncoder::Statistics statistics;
+        if (IsFloatFormat(image.path))
+        {
+            // streamed straight from the accumulation buffer
+            result = image.radiance.size() == size_t(image.width) * image.height &&
+                     (extension == "pfm" ? FloatImage::WritePfm(path, image.width, image.height, image.radiance.data(), &statistics)
+                                         : FloatImage::WriteExr(path, image.width, image.height, image.radiance.data(), FloatImage::ExrSettings(), &statistics));
+        }
+        else
+        {
+            // jpg and png are encoded strip by strip on the job system
+            std::vector<uint8_t> encoded;
+            const bool encodedOk = extension == "png" ? ImageEncoder::EncodePng(image.width, image.height, image.pixels.data(), encoded, &statistics)
+                                                      : ImageEncoder::EncodeJpg(image.width, image.height, image.pixels.data(), image.quality, encoded, &statistics);
+            result = encodedOk && ImageEncoder::WriteFile(path, encoded);
+        }
+
+        if (result)
+        {
+            printf("image writer: %s %dx%d, %.2f MB in %.2f ms, %.1f MB/s, %d strips\n", path, image.width, image.height,
+                   statistics.outputBytes / (1024.0f * 1024.0f), statistics.milliseconds, statistics.MegabytesPerSecond(), statistics.strips);
+        }
+    }
+
+    if (!result) printf("image writer: failed to write %s\n", path);
+    return result != 0;
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,69 @@
+#pragma once
+#include "Math/Color.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+AMATH_NAMESPACE
+
+// finished frame waiting to be encoded, owned by the ImageWriter and recycled between frames
+struct OutputImage
+{
+	int width = 0, height = 0;
+	std::vector<Color32> pixels; // rows top down
+	// float formats only, the renderer resolves its averaged samples straight into this instead of converting.
+	// kept between frames like pixels so a warm renderer does not allocate
+	std::vector<Color> radiance;
+	std::string path;
+	int quality = 90; // jpg only, 1 - 100
+
+	void Resize(int _width, int _height)
+	{
+		width = _width; height = _height;
+		pixels.resize(size_t(width) * height);
+	}
+};
+
+// encodes and writes frames on a background thread so the next frame can render meanwhile
+// frames go through a fixed set of buffers, with the default two one frame renders while the other is written.
+// AcquireBuffer blocks once every buffer is queued, which bounds the queue and the memory used
+class ImageWriter
+{
+public:
+	std::atomic<int> framesWritten { 0 };
+	std::atomic<float> lastWriteMilliseconds { 0.0f };
+
+	~ImageWriter() { Stop(); }
+
+	void Start(int bufferCount = 2);
+	// writes everything still queued, then joins the thread
+	void Stop();
+	bool Running() const { return thread.joinable(); }
+
+	OutputImage* AcquireBuffer();
+	void Submit(OutputImage* image);
+	// blocks until every submitted frame is on disk
+	void Flush();
+
+	// format from the extension: jpg/jpeg, png, bmp, tga or the float formats pfm and exr
+	static bool Write(const OutputImage& image);
+	static bool IsFloatFormat(const std::string& path);
+
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable queueChanged;
+	std::vector<std::unique_ptr<OutputImage>> buffers;
+	std::vector<OutputImage*> freeBuffers;
+	std::vector<OutputImage*> queue; // oldest first, never longer than buffers
+	int writing = 0;
+	bool stopping = false;
+
+	void WriterLoop();
+};
+
+AMATH_END_NAMESPACE
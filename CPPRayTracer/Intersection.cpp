@@ -0,0 +1,415 @@
+#include "Intersection.hpp"
+#include "BVHCache.hpp"
+#include "Trace.hpp"
+
+AMATH_NAMESPACE
+
+static inline size_t PaddedCount(size_t count) { return (count + 3) & ~size_t(3); }
+
+static inline __m128i LaneIndices(int first) { return _mm_add_epi32(_mm_set1_epi32(first), _mm_setr_epi32(0, 1, 2, 3)); }
+
+// lanes past the end of the pack are never valid
+static inline __m128 LaneMask(int first, int count)
+{
+    return _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(count), LaneIndices(first)));
+}
+
+// per lane closest distance and primitive index, reduced to a single hit at the end
+struct ClosestLanes
+{
+    __m128 t;
+    __m128i index;
+
+    explicit ClosestLanes(float t_max) : t(_mm_set1_ps(t_max)), index(_mm_set1_epi32(-1)) {}
+
+    FINLINE void Update(__m128 candidate, __m128 valid, int first)
+    {
+        const __m128 closer = _mm_and_ps(valid, _mm_cmplt_ps(candidate, t));
+        t = _mm_blendv_ps(t, candidate, closer);
+        index = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(index), _mm_castsi128_ps(LaneIndices(first)), closer));
+    }
+
+    // index of the closest primitive or -1
+    int Resolve(float& closest) const
+    {
+        alignas(16) float distances[4];
+        alignas(16) int indices[4];
+        _mm_store_ps(distances, t);
+        _mm_store_si128((__m128i*)indices, index);
+
+        int best = -1;
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            if (indices[lane] < 0 || (best >= 0 && distances[lane] >= closest)) continue;
+            best = indices[lane];
+            closest = distances[lane];
+        }
+        return best;
+    }
+};
+
+void SpherePack::Build(const std::vector<Sphere>& source)
+{
+    SphereArrays arrays;
+    for (const Sphere& sphere : source) arrays.Add(sphere.center, sphere.radius, sphere.texture);
+    Build(arrays);
+}
+
+void SpherePack::Build(const SphereArrays& source, const Vector3d& origin)
+{
+    count = int(source.Count());
+    std::vector<Vector3> centers(count);
+    std::vector<AABB> bounds(count);
+    for (int i = 0; i < count; ++i)
+    {
+        // subtracted in double, only the offset from the origin is rounded
+        centers[i] = Vector3(float(source.centerX[i] - origin.x), float(source.centerY[i] - origin.y), float(source.centerZ[i] - origin.z));
+        bounds[i] = AABB(centers[i] - Vector3(source.radius[i]), centers[i] + Vector3(source.radius[i]));
+    }
+    std::vector<int> order;
+    BVHCache::Build(bvh, bounds, order);
+
+    const size_t padded = PaddedLanes(count);
+    for (PackArray<float>* array : { &centerX, &centerY, &centerZ, &radius }) array->Assign(padded, 0.0f);
+    texture.Assign(padded, -1);
+
+    lanes.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const int sphere = order[i];
+        lanes[sphere] = i;
+        centerX.storage[i] = centers[sphere].x;
+        centerY.storage[i] = centers[sphere].y;
+        centerZ.storage[i] = centers[sphere].z;
+        radius.storage[i]  = source.radius[sphere];
+        texture.storage[i] = source.texture[sphere];
+    }
+    SetMotion(0);
+}
+
+void SpherePack::View(int sphereCount, const float* _centerX, const float* _centerY, const float* _centerZ, const float* _radius,
+                      const int* _texture, const BVHNode* nodes, int nodeCount)
+{
+    count = sphereCount;
+    centerX.View(_centerX); centerY.View(_centerY); centerZ.View(_centerZ);
+    radius.View(_radius);
+    texture.View(_texture);
+    bvh.View(nodes, nodeCount);
+    lanes.clear(); lanes.shrink_to_fit();
+    SetMotion(0);
+}
+
+void SpherePack::SetMotion(int steps)
+{
+    motionSteps = steps;
+    const size_t padded = PaddedLanes(count);
+    for (std::vector<float>* array : { &motionX, &motionY, &motionZ }) array->clear();
+    if (steps == 0) return;
+    for (int key = 0; key <= steps; ++key)
+    {
+        motionX.insert(motionX.end(), centerX.data, centerX.data + padded);
+        motionY.insert(motionY.end(), centerY.data, centerY.data + padded);
+        motionZ.insert(motionZ.end(), centerZ.data, centerZ.data + padded);
+    }
+}
+
+void SpherePack::Refit()
+{
+    Trace::Scope scope("bvh refit");
+    if (motionSteps == 0)
+    {
+        bvh.RefitMotion(0, [&](int, int first, int leafCount)
+        {
+            AABB bounds;
+            for (int i = first; i < first + leafCount; ++i) bounds.Grow(Bounds(i));
+            return bounds;
+        });
+        return;
+    }
+    const size_t padded = PaddedLanes(count);
+    bvh.RefitMotion(motionSteps, [&](int key, int first, int leafCount)
+    {
+        AABB bounds;
+        for (int i = first; i < first + leafCount; ++i)
+        {
+            const size_t slot = key * padded + i;
+            const Vector3 center(motionX[slot], motionY[slot], motionZ[slot]);
+            bounds.Grow(AABB(center - Vector3(radius[i]), center + Vector3(radius[i])));
+        }
+        return bounds;
+    });
+}
+
+Vector3 SpherePack::Center(int lane, float time) const
+{
+    if (motionSteps == 0) return Vector3(centerX[lane], centerY[lane], centerZ[lane]);
+    float fraction;
+    const size_t slot = MotionKey(time, motionSteps, fraction) * PaddedLanes(count) + lane;
+    const size_t next = slot + PaddedLanes(count);
+    return Vector3::Lerp(Vector3(motionX[slot], motionY[slot], motionZ[slot]), Vector3(motionX[next], motionY[next], motionZ[next]), fraction);
+}
+
+void CubePack::Build(const std::vector<Cube>& source)
+{
+    cubes = source;
+    motionSteps = 0;
+    for (std::vector<float>& array : motionTransform) array.clear();
+    const size_t padded = PaddedCount(source.size());
+    for (std::vector<float>& array : transform) array.assign(padded, 0.0f);
+    for (std::vector<float>* array : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) array->assign(padded, 0.0f);
+
+    for (size_t i = 0; i < source.size(); ++i)
+    {
+        const Cube& cube = source[i];
+        for (int row = 0; row < 4; ++row)
+            for (int column = 0; column < 3; ++column)
+                transform[row * 3 + column][i] = cube.worldToLocal.m[row][column];
+
+        minX[i] = cube.min.x; minY[i] = cube.min.y; minZ[i] = cube.min.z;
+        maxX[i] = cube.max.x; maxY[i] = cube.max.y; maxZ[i] = cube.max.z;
+    }
+}
+
+void CubePack::BuildMotion(const std::vector<std::vector<Cube>>& keys)
+{
+    Build(keys[0]);
+    motionSteps = int(keys.size()) - 1;
+    const size_t padded = PaddedCount(cubes.size());
+    for (std::vector<float>& array : motionTransform) array.assign(motionSteps > 0 ? padded * keys.size() : 0, 0.0f);
+    if (motionSteps == 0) return;
+
+    for (size_t key = 0; key < keys.size(); ++key)
+    {
+        for (size_t i = 0; i < cubes.size(); ++i)
+        {
+            for (int row = 0; row < 4; ++row)
+                for (int column = 0; column < 3; ++column)
+                    motionTransform[row * 3 + column][key * padded + i] = keys[key][i].worldToLocal.m[row][column];
+        }
+    }
+}
+
+Matrix4 CubePack::WorldToLocal(int index, float time) const
+{
+    Matrix4 worldToLocal = cubes[index].worldToLocal;
+    if (motionSteps == 0) return worldToLocal;
+    float fraction;
+    const size_t slot = MotionKey(time, motionSteps, fraction) * PaddedCount(cubes.size()) + index;
+    const size_t next = slot + PaddedCount(cubes.size());
+    for (int row = 0; row < 4; ++row)
+        for (int column = 0; column < 3; ++column)
+        {
+            const std::vector<float>& element = motionTransform[row * 3 + column];
+            worldToLocal.m[row][column] = element[slot] + (element[next] - element[slot]) * fraction;
+        }
+    return worldToLocal;
+}
+
+void PlanePack::Build(const std::vector<Plane>& source)
+{
+    planes = source;
+    const size_t padded = PaddedCount(source.size());
+    for (std::vector<float>* array : { &normalX, &normalY, &normalZ, &distance }) array->assign(padded, 0.0f);
+
+    for (size_t i = 0; i < source.size(); ++i)
+    {
+        normalX[i]  = source[i].normal.x;
+        normalY[i]  = source[i].normal.y;
+        normalZ[i]  = source[i].normal.z;
+        distance[i] = source[i].distance;
+    }
+}
+
+// closest sphere of the lanes [first, first + count) closer than t_max, or -1.
+// with motion the centers are lerped between the keys of key and key + 1
+template<bool Motion>
+static int HitSpheres(const Ray& ray, const SpherePack& pack, int first, int count, float& t_max, int key = 0, __m128 fraction = _mm_setzero_ps())
+{
+    const int end = first + count;
+    const __m128 originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+    const __m128 directionX = _mm_set1_ps(ray.direction.x), directionY = _mm_set1_ps(ray.direction.y), directionZ = _mm_set1_ps(ray.direction.z);
+    const __m128 a = _mm_set1_ps(ray.direction.LengthSquared());
+    const __m128 tMin = _mm_set1_ps(RayTMin);
+    ClosestLanes closest(t_max);
+
+    for (int i = first; i < end; i += 4)
+    {
+        __m128 ocX, ocY, ocZ;
+        if constexpr (Motion)
+        {
+            const size_t padded = SpherePack::PaddedLanes(pack.count);
+            auto lerp = [&](const std::vector<float>& array)
+            {
+                const __m128 a = _mm_loadu_ps(&array[key * padded + i]);
+                return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&array[(key + 1) * padded + i]), a), fraction));
+            };
+            ocX = _mm_sub_ps(originX, lerp(pack.motionX));
+            ocY = _mm_sub_ps(originY, lerp(pack.motionY));
+            ocZ = _mm_sub_ps(originZ, lerp(pack.motionZ));
+        }
+        else
+        {
+            ocX = _mm_sub_ps(originX, _mm_loadu_ps(&pack.centerX[i]));
+            ocY = _mm_sub_ps(originY, _mm_loadu_ps(&pack.centerY[i]));
+            ocZ = _mm_sub_ps(originZ, _mm_loadu_ps(&pack.centerZ[i]));
+        }
+        const __m128 radius = _mm_loadu_ps(&pack.radius[i]);
+
+        const __m128 halfB = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, directionX), _mm_mul_ps(ocY, directionY)), _mm_mul_ps(ocZ, directionZ));
+        const __m128 ocLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, ocX), _mm_mul_ps(ocY, ocY)), _mm_mul_ps(ocZ, ocZ));
+        const __m128 c = _mm_sub_ps(ocLengthSq, _mm_mul_ps(radius, radius));
+        const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(halfB, halfB), _mm_mul_ps(a, c));
+        const __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+
+        const __m128 nearRoot = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), halfB), sqrtd), a);
+        const __m128 farRoot  = _mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), halfB), sqrtd), a);
+        const __m128 t = _mm_blendv_ps(farRoot, nearRoot, _mm_cmpge_ps(nearRoot, tMin));
+
+        __m128 valid = _mm_and_ps(LaneMask(i, end), _mm_cmpge_ps(discriminant, _mm_setzero_ps()));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(t, tMin));
+        closest.Update(t, valid, i);
+    }
+
+    return closest.Resolve(t_max);
+}
+
+bool HitMany(const Ray& ray, const SpherePack& pack, float& t_max, HitRecord& record)
+{
+    int closest = -1;
+    uint64_t tested = 0;
+    if (pack.motionSteps > 0)
+    {
+        float fraction;
+        const int key = MotionKey(ray.time, pack.motionSteps, fraction);
+        pack.bvh.Traverse(ray, t_max, [&](int first, int count, float& t)
+        {
+            tested += count;
+            const int index = HitSpheres<true>(ray, pack, first, count, t, key, _mm_set1_ps(fraction));
+            if (index >= 0) closest = index;
+            return index >= 0;
+        });
+    }
+    else
+    {
+        pack.bvh.Traverse(ray, t_max, [&](int first, int count, float& t)
+        {
+            tested += count;
+            const int index = HitSpheres<false>(ray, pack, first, count, t);
+            if (index >= 0) closest = index;
+            return index >= 0;
+        });
+    }
+    RayStats::Add(RayCounter::PrimitiveTests, tested);
+    if (closest < 0) return false;
+
+    Sphere::FillRecord(ray, t_max, pack.Center(closest, ray.time), pack.radius[closest], pack.texture[closest], record);
+    return true;
+}
+
+bool HitMany(const Ray& ray, const CubePack& pack, float& t_max, HitRecord& record)
+{
+    const int count = pack.Count();
+    const __m128 originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+    const __m128 directionX = _mm_set1_ps(ray.direction.x), directionY = _mm_set1_ps(ray.direction.y), directionZ = _mm_set1_ps(ray.direction.z);
+    const __m128 tMin = _mm_set1_ps(RayTMin);
+    const __m128 one = _mm_set1_ps(1.0f);
+    ClosestLanes closest(t_max);
+
+    // one slab, narrows [tNear, tFar] branchlessly, infinities from parallel axes fall out of min/max
+    auto slab = [](__m128 origin, __m128 invDirection, const float* min, const float* max, __m128& tNear, __m128& tFar)
+    {
+        const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(min), origin), invDirection);
+        const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(max), origin), invDirection);
+        tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+        tFar  = _mm_min_ps(tFar,  _mm_max_ps(t0, t1));
+    };
+
+    // with motion the transforms are lerped between the keys around the ray time
+    size_t key = 0, next = 0;
+    __m128 fraction = _mm_setzero_ps();
+    if (pack.motionSteps > 0)
+    {
+        float keyFraction;
+        key = MotionKey(ray.time, pack.motionSteps, keyFraction) * PaddedCount(count);
+        next = key + PaddedCount(count);
+        fraction = _mm_set1_ps(keyFraction);
+    }
+
+    for (int i = 0; i < count; i += 4)
+    {
+        __m128 m[12];
+        if (pack.motionSteps > 0)
+        {
+            for (int k = 0; k < 12; ++k)
+            {
+                const __m128 a = _mm_loadu_ps(&pack.motionTransform[k][key + i]);
+                m[k] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pack.motionTransform[k][next + i]), a), fraction));
+            }
+        }
+        else for (int k = 0; k < 12; ++k) m[k] = _mm_loadu_ps(&pack.transform[k][i]);
+
+        // ray into the local space of each box, distances along the ray are unchanged by the affine map
+        const __m128 localOriginX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(originX, m[0]), _mm_mul_ps(originY, m[3])), _mm_mul_ps(originZ, m[6])), m[9]);
+        const __m128 localOriginY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(originX, m[1]), _mm_mul_ps(originY, m[4])), _mm_mul_ps(originZ, m[7])), m[10]);
+        const __m128 localOriginZ = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(originX, m[2]), _mm_mul_ps(originY, m[5])), _mm_mul_ps(originZ, m[8])), m[11]);
+        const __m128 localDirectionX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, m[0]), _mm_mul_ps(directionY, m[3])), _mm_mul_ps(directionZ, m[6]));
+        const __m128 localDirectionY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, m[1]), _mm_mul_ps(directionY, m[4])), _mm_mul_ps(directionZ, m[7]));
+        const __m128 localDirectionZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, m[2]), _mm_mul_ps(directionY, m[5])), _mm_mul_ps(directionZ, m[8]));
+
+        __m128 tNear = _mm_set1_ps(-FLT_MAX), tFar = _mm_set1_ps(FLT_MAX);
+        slab(localOriginX, _mm_div_ps(one, localDirectionX), &pack.minX[i], &pack.maxX[i], tNear, tFar);
+        slab(localOriginY, _mm_div_ps(one, localDirectionY), &pack.minY[i], &pack.maxY[i], tNear, tFar);
+        slab(localOriginZ, _mm_div_ps(one, localDirectionZ), &pack.minZ[i], &pack.maxZ[i], tNear, tFar);
+
+        // leave through the far side when the origin is inside
+        const __m128 t = _mm_blendv_ps(tFar, tNear, _mm_cmpgt_ps(tNear, tMin));
+
+        __m128 valid = _mm_and_ps(LaneMask(i, count), _mm_cmple_ps(tNear, tFar));
+        valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, tMin));
+        closest.Update(t, valid, i);
+    }
+
+    float t;
+    const int index = closest.Resolve(t);
+    if (index < 0) return false;
+
+    const Cube& cube = pack.cubes[index];
+    Cube::FillRecord(ray, t, cube.min, cube.max, pack.WorldToLocal(index, ray.time), cube.texture, record);
+    t_max = t;
+    return true;
+}
+
+bool HitMany(const Ray& ray, const PlanePack& pack, float& t_max, HitRecord& record)
+{
+    const int count = pack.Count();
+    const __m128 originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+    const __m128 directionX = _mm_set1_ps(ray.direction.x), directionY = _mm_set1_ps(ray.direction.y), directionZ = _mm_set1_ps(ray.direction.z);
+    const __m128 tMin = _mm_set1_ps(RayTMin);
+    ClosestLanes closest(t_max);
+
+    for (int i = 0; i < count; i += 4)
+    {
+        const __m128 normalX = _mm_loadu_ps(&pack.normalX[i]);
+        const __m128 normalY = _mm_loadu_ps(&pack.normalY[i]);
+        const __m128 normalZ = _mm_loadu_ps(&pack.normalZ[i]);
+
+        const __m128 normalDotOrigin = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, originX), _mm_mul_ps(normalY, originY)), _mm_mul_ps(normalZ, originZ));
+        const __m128 normalDotDirection = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, directionX), _mm_mul_ps(normalY, directionY)), _mm_mul_ps(normalZ, directionZ));
+        // parallel rays give inf or nan, both fail the ordered compare
+        const __m128 t = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(&pack.distance[i]), normalDotOrigin), normalDotDirection);
+
+        const __m128 valid = _mm_and_ps(LaneMask(i, count), _mm_cmpgt_ps(t, tMin));
+        closest.Update(t, valid, i);
+    }
+
+    float t;
+    const int index = closest.Resolve(t);
+    if (index < 0) return false;
+
+    const Plane& plane = pack.planes[index];
+    Plane::FillRecord(ray, t, plane.normal, plane.distance, plane.texture, record);
+    t_max = t;
+    return true;
+}
+
+AMATH_END_NAMESPACE
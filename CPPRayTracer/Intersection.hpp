@@ -0,0 +1,140 @@
+#pragma once
+#include "BVH.hpp"
+#include <vector>
+
+AMATH_NAMESPACE
+
+// structure of arrays copies of the primitives so one ray is tested against 4 of them per SSE instruction
+// arrays are padded to a multiple of 4, the padding lanes are masked out by count
+// the original primitives are kept next to the arrays, only the closest hit fills its HitRecord from them
+
+// array that either owns its elements or points into a mapped scene file, builders write through storage
+template<typename T>
+struct PackArray
+{
+	std::vector<T> storage;
+	const T* data = nullptr;
+
+	PackArray() = default;
+	PackArray(const PackArray& other) { *this = other; }
+	PackArray(PackArray&&) = default;
+	PackArray& operator=(const PackArray& other)
+	{
+		storage = other.storage;
+		data = storage.empty() ? other.data : storage.data();
+		return *this;
+	}
+	PackArray& operator=(PackArray&&) = default;
+
+	void Assign(size_t count, T value) { storage.assign(count, value); data = storage.data(); }
+	void View(const T* mapped) { storage.clear(); storage.shrink_to_fit(); data = mapped; }
+
+	const T& operator[](size_t index) const { return data[index]; }
+};
+
+// loose sphere arrays in any order, what scene parsers fill before SpherePack sorts them by its BVH.
+// centers are kept in double until the pack rounds them relative to its origin
+struct SphereArrays
+{
+	std::vector<double> centerX, centerY, centerZ;
+	std::vector<float> radius;
+	std::vector<int> texture;
+
+	void Add(const Vector3d& center, float _radius, int _texture)
+	{
+		centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+		radius.push_back(_radius);
+		texture.push_back(_texture);
+	}
+	void Add(const Vector3& center, float _radius, int _texture) { Add(Vector3d(center.x, center.y, center.z), _radius, _texture); }
+	void Reserve(size_t count)
+	{
+		for (std::vector<double>* array : { &centerX, &centerY, &centerZ }) array->reserve(count);
+		radius.reserve(count);
+		texture.reserve(count);
+	}
+	size_t Count() const { return radius.size(); }
+};
+
+// spheres are stored in the order of their BVH so every leaf is a contiguous range of lanes.
+// the arrays hold three lanes of padding past the last sphere, a leaf may start at any lane
+struct SpherePack
+{
+	PackArray<float> centerX, centerY, centerZ, radius;
+	PackArray<int> texture;
+	BVH bvh;
+	int count = 0;
+	std::vector<int> lanes; // lane of every sphere of the source arrays, empty for a view
+	// motion blur, the center of a lane at key k of the shutter is at [k * PaddedLanes(count) + lane], empty without motion
+	std::vector<float> motionX, motionY, motionZ;
+	int motionSteps = 0;
+
+
+	void Build(const std::vector<Sphere>& source);
+	// centers are stored relative to origin, see RayTracer::SetLargeWorld
+	void Build(const SphereArrays& source, const Vector3d& origin = Vector3d::Zero());
+	// uses arrays and nodes that live elsewhere, they must outlive the pack
+	void View(int sphereCount, const float* _centerX, const float* _centerY, const float* _centerZ, const float* _radius,
+	          const int* _texture, const BVHNode* nodes, int nodeCount);
+	int Count() const { return count; }
+	// moves the sphere the source arrays had at index, Refit has to follow before the pack is traced
+	void Move(int index, const Vector3& center)
+	{
+		const int lane = lanes[index];
+		centerX.storage[lane] = center.x; centerY.storage[lane] = center.y; centerZ.storage[lane] = center.z;
+	}
+	// steps + 1 keys evenly spaced over the shutter, every one starts out as the centers the pack has now.
+	// 1 is linear motion, more follow curved paths. 0 drops the motion
+	void SetMotion(int steps);
+	// moves a sphere at one key of the shutter, key 0 is also where rays without motion see it
+	void Move(int index, const Vector3& center, int key)
+	{
+		if (key == 0) Move(index, center);
+		const size_t slot = size_t(key) * PaddedLanes(count) + lanes[index];
+		motionX[slot] = center.x; motionY[slot] = center.y; motionZ[slot] = center.z;
+	}
+	// the bvh bounds every key with motion
+	void Refit();
+	Vector3 Center(int lane, float time) const;
+	static size_t PaddedLanes(size_t count) { return (count + 3 + 3) & ~size_t(3); }
+
+	AABB Bounds(int index) const
+	{
+		const Vector3 center(centerX[index], centerY[index], centerZ[index]);
+		return AABB(center - Vector3(radius[index]), center + Vector3(radius[index]));
+	}
+};
+
+struct CubePack
+{
+	// affine part of worldToLocal, row r column c at [r * 3 + c], row 3 is the translation
+	std::vector<float> transform[12];
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<Cube> cubes;
+	// motion blur, transform of key k at [k * padded count + index], empty without motion. keys are lerped
+	// element wise, a spin that is fast against the number of keys shrinks the box in between them
+	std::vector<float> motionTransform[12];
+	int motionSteps = 0;
+
+	void Build(const std::vector<Cube>& source);
+	// keys.size() - 1 steps evenly spaced over the shutter, the boxes and textures come from the first key
+	void BuildMotion(const std::vector<std::vector<Cube>>& keys);
+	int Count() const { return int(cubes.size()); }
+	Matrix4 WorldToLocal(int index, float time) const;
+};
+
+struct PlanePack
+{
+	std::vector<float> normalX, normalY, normalZ, distance;
+	std::vector<Plane> planes;
+
+	void Build(const std::vector<Plane>& source);
+	int Count() const { return int(planes.size()); }
+};
+
+// closest hit in the pack closer than t_max, spheres are found through the BVH, t_max is lowered to the hit distance so packs can be chained
+bool HitMany(const Ray& ray, const SpherePack& pack, float& t_max, HitRecord& record);
+bool HitMany(const Ray& ray, const CubePack& pack, float& t_max, HitRecord& record);
+bool HitMany(const Ray& ray, const PlanePack& pack, float& t_max, HitRecord& record);
+
+AMATH_END_NAMESPACE
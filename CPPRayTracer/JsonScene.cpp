@@ -0,0 +1,574 @@
+#include "JsonScene.hpp"
+#include "MappedFile.hpp"
+#include "Math/Quaternion.hpp"
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+AMATH_NAMESPACE
+
+// powers of ten that are exact in a double, see JsonReader::Number
+static const double ExactPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                           1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// cursor over the text. the first error is logged, moves the cursor to the end and every read after it
+// returns a default value, so the parse loops only have to check Failed where they loop
+class JsonReader
+{
+public:
+    JsonReader(const char* text, size_t size, const char* _name) : begin(text), p(text), end(text + size), name(_name) {}
+
+    bool Failed() const { return failed; }
+
+    void Fail(const char* message)
+    {
+        if (failed) return;
+        int line = 1;
+        const char* lineStart = begin;
+        for (const char* c = begin; c < p; ++c) if (*c == '\n') { line++; lineStart = c + 1; }
+        printf("scene json: %s:%d:%d: %s\n", name, line, int(p - lineStart) + 1, message);
+        failed = true;
+        p = end;
+    }
+
+    void SkipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) ++p;
+    }
+
+    bool Consume(char c)
+    {
+        SkipSpace();
+        if (p < end && *p == c) { ++p; return true; }
+        return false;
+    }
+
+    void Expect(char c)
+    {
+        if (Consume(c)) return;
+        char message[32];
+        snprintf(message, sizeof(message), "expected '%c'", c);
+        Fail(message);
+    }
+
+    // calls field(key) for every key, field has to read or Skip the value
+    template<typename Field>
+    void Object(Field&& field)
+    {
+        Expect('{');
+        if (Consume('}')) return;
+        do
+        {
+            const std::string_view key = String();
+            Expect(':');
+            if (failed) return;
+            field(key);
+        } while (Consume(','));
+        Expect('}');
+    }
+
+    // calls element() once per element, element has to read or Skip it
+    template<typename Element>
+    void Array(Element&& element)
+    {
+        Expect('[');
+        if (Consume(']')) return;
+        do
+        {
+            element();
+        } while (!failed && Consume(','));
+        Expect(']');
+    }
+
+    // valid until the next String call
+    std::string_view String()
+    {
+        Expect('"');
+        const char* start = p;
+        while (p < end && *p != '"' && *p != '\\') ++p;
+        if (p < end && *p == '"') return std::string_view(start, size_t(p++ - start));
+
+        // escapes are rare, they are decoded into scratch
+        scratch.assign(start, p);
+        while (p < end && *p != '"')
+        {
+            if (*p != '\\') { scratch += *p++; continue; }
+            if (++p == end) break;
+            const char escape = *p++;
+            switch (escape)
+            {
+            case 'n': scratch += '\n'; break;
+            case 't': scratch += '\t'; break;
+            case 'r': scratch += '\r'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'u': AppendCodePoint(); break;
+            default: scratch += escape; break; // " \ /
+            }
+        }
+        if (p == end) { Fail("unterminated string"); return {}; }
+        ++p;
+        return scratch;
+    }
+
+    float Number() { return ParseNumber<float>(); }
+    // positions of large worlds, float only has millimeters left a few kilometers out
+    double Double() { return ParseNumber<double>(); }
+
+    // fast path for up to 15 significant digits and small exponents, the rest goes through from_chars.
+    // both are correctly rounded so the result never depends on which one was taken
+    template<typename T>
+    T ParseNumber()
+    {
+        SkipSpace();
+        const char* start = p;
+        if (p < end && *p == '-') ++p;
+
+        uint64_t mantissa = 0;
+        int exponent = 0, digits = 0, significant = 0;
+        for (; p < end && unsigned(*p - '0') < 10; ++p, ++digits)
+        {
+            if (mantissa == 0 && *p == '0') continue;
+            if (++significant <= 19) mantissa = mantissa * 10 + (*p - '0'); else exponent++;
+        }
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && unsigned(*p - '0') < 10; ++p, ++digits)
+            {
+                if (mantissa == 0 && *p == '0') { exponent--; continue; }
+                if (++significant <= 19) { mantissa = mantissa * 10 + (*p - '0'); exponent--; }
+            }
+        }
+        if (digits == 0) { p = start; Fail("expected a number"); return T(0); }
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            ++p;
+            const bool negative = p < end && *p == '-';
+            if (p < end && (*p == '-' || *p == '+')) ++p;
+            int value = 0;
+            const char* exponentStart = p;
+            for (; p < end && unsigned(*p - '0') < 10; ++p) value = Min(value * 10 + (*p - '0'), 100000);
+            if (p == exponentStart) { Fail("expected an exponent"); return T(0); }
+            exponent += negative ? -value : value;
+        }
+
+        // mantissa and power of ten are exact doubles, so the double is correctly rounded (Clinger 1990).
+        // rounding it again to float gives the correctly rounded float unless it landed exactly between two floats
+        if (significant <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            const double value = exponent < 0 ? double(mantissa) / ExactPowersOfTen[-exponent] : double(mantissa) * ExactPowersOfTen[exponent];
+            if constexpr (std::is_same_v<T, double>) return *start == '-' ? -value : value;
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            if ((bits & 0x1FFFFFFF) != 0x10000000) return float(*start == '-' ? -value : value);
+        }
+
+        T value = T(0);
+        const std::from_chars_result result = std::from_chars(start, p, value);
+        // too small is zero, too large is an error, infinities are not valid in a scene anyway
+        if (result.ec == std::errc::result_out_of_range && exponent < 0) return *start == '-' ? -T(0) : T(0);
+        if (result.ec != std::errc()) { p = start; Fail("number out of range"); }
+        return value;
+    }
+
+    int Integer()
+    {
+        const float value = Number();
+        if (value != floorf(value) || fabsf(value) > float(INT_MAX / 2)) Fail("expected an integer");
+        return int(value);
+    }
+
+    bool Boolean()
+    {
+        SkipSpace();
+        if (Literal("true")) return true;
+        if (!Literal("false")) Fail("expected true or false");
+        return false;
+    }
+
+    Vector3 Vec3()
+    {
+        Vector3 v;
+        Expect('[');
+        v.x = Number(); Expect(',');
+        v.y = Number(); Expect(',');
+        v.z = Number();
+        Expect(']');
+        return v;
+    }
+
+    Vector3d Vec3d()
+    {
+        Vector3d v;
+        Expect('[');
+        v.x = Double(); Expect(',');
+        v.y = Double(); Expect(',');
+        v.z = Double();
+        Expect(']');
+        return v;
+    }
+
+    // [r, g, b] or [r, g, b, a]
+    Color Rgb()
+    {
+        Color c;
+        Expect('[');
+        c.r = Number(); Expect(',');
+        c.g = Number(); Expect(',');
+        c.b = Number();
+        c.a = Consume(',') ? Number() : 1.0f;
+        Expect(']');
+        return c;
+    }
+
+    // any value, containers are skipped by counting brackets outside of strings
+    void Skip()
+    {
+        SkipSpace();
+        if (p == end) return Fail("expected a value");
+        if (*p == '"') { String(); return; }
+        if (*p != '{' && *p != '[')
+        {
+            if (Literal("true") || Literal("false") || Literal("null")) return;
+            Number();
+            return;
+        }
+
+        int depth = 0;
+        while (p < end)
+        {
+            const char c = *p++;
+            if (c == '{' || c == '[') depth++;
+            else if (c == '}' || c == ']') { if (--depth == 0) return; }
+            else if (c == '"')
+            {
+                for (; p < end && *p != '"'; ++p) if (*p == '\\') ++p;
+                ++p;
+            }
+        }
+        Fail("unterminated object or array");
+    }
+
+    bool AtEnd() { SkipSpace(); return p >= end; }
+    size_t Offset() const { return size_t(p - begin); }
+    size_t Remaining() const { return size_t(end - p); }
+
+private:
+    const char* begin;
+    const char* p;
+    const char* end;
+    const char* name;
+    bool failed = false;
+    std::string scratch;
+
+    bool Literal(const char* word)
+    {
+        const size_t length = strlen(word);
+        if (size_t(end - p) < length || memcmp(p, word, length) != 0) return false;
+        p += length;
+        return true;
+    }
+
+    // \uXXXX as utf-8, surrogate pairs are combined
+    void AppendCodePoint()
+    {
+        auto hex4 = [&]()
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i, ++p)
+            {
+                if (p == end) return value;
+                const char c = *p;
+                const uint32_t digit = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : 16;
+                if (digit == 16) { Fail("invalid \\u escape"); return 0u; }
+                value = value * 16 + digit;
+            }
+            return value;
+        };
+        uint32_t code = hex4();
+        if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+        {
+            p += 2;
+            code = 0x10000 + ((code - 0xD800) << 10) + (hex4() - 0xDC00);
+        }
+        if (code < 0x80) scratch += char(code);
+        else if (code < 0x800) { scratch += char(0xC0 | code >> 6); scratch += char(0x80 | (code & 0x3F)); }
+        else if (code < 0x10000) { scratch += char(0xE0 | code >> 12); scratch += char(0x80 | (code >> 6 & 0x3F)); scratch += char(0x80 | (code & 0x3F)); }
+        else
+        {
+            scratch += char(0xF0 | code >> 18); scratch += char(0x80 | (code >> 12 & 0x3F));
+            scratch += char(0x80 | (code >> 6 & 0x3F)); scratch += char(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+// materials get an index the first time they are named, by their definition or by a primitive using them
+class MaterialTable
+{
+public:
+    explicit MaterialTable(std::vector<SceneMaterial>& _materials) : materials(_materials) {}
+
+    int Find(std::string_view name)
+    {
+        // neighbouring primitives usually share their material
+        if (last >= 0 && materials[last].name == name) return last;
+        auto it = indices.find(std::string(name));
+        if (it == indices.end())
+        {
+            it = indices.emplace(std::string(name), int(materials.size())).first;
+            materials.push_back(SceneMaterial());
+            materials.back().name = std::string(name);
+        }
+        return last = it->second;
+    }
+
+private:
+    std::vector<SceneMaterial>& materials;
+    std::unordered_map<std::string, int> indices;
+    int last = -1;
+};
+
+static void ParseSettings(JsonReader& reader, SceneSettings& settings)
+{
+    reader.Object([&](std::string_view key)
+    {
+        if (key == "width") settings.width = reader.Integer();
+        else if (key == "height") settings.height = reader.Integer();
+        else if (key == "samples") settings.samples = reader.Integer();
+        else if (key == "quality") settings.quality = reader.Integer();
+        else if (key == "denoise") settings.denoise = reader.Boolean();
+        else if (key == "tonemap") settings.tonemap = reader.String();
+        else if (key == "exposure") settings.exposure = reader.Number();
+        else if (key == "output") settings.output = reader.String();
+        else if (key == "environment") settings.environment = reader.String();
+        else if (key == "large_world") settings.largeWorld = reader.Boolean();
+        else reader.Skip();
+    });
+    if (settings.width < 0 || settings.height < 0 || settings.samples < 0) reader.Fail("settings must not be negative");
+}
+
+static void ParseCamera(JsonReader& reader, Camera& camera, float* frame = nullptr, Vector3d* position = nullptr)
+{
+    reader.Object([&](std::string_view key)
+    {
+        if (frame && key == "frame") *frame = reader.Number();
+        else if (key == "position" && position) { *position = reader.Vec3d(); camera.position = ToVec3f(*position); }
+        else if (key == "position") camera.position = reader.Vec3();
+        else if (key == "target") camera.target = reader.Vec3();
+        else if (key == "up") camera.up = reader.Vec3();
+        else if (key == "fov") camera.verticalFov = reader.Number();
+        else reader.Skip();
+    });
+    if (!(camera.verticalFov > 0.0f && camera.verticalFov < 180.0f)) reader.Fail("camera fov must be between 0 and 180 degrees");
+}
+
+static void ParseMaterials(JsonReader& reader, MaterialTable& table, std::vector<SceneMaterial>& materials)
+{
+    reader.Array([&]
+    {
+        std::string name, texture;
+        reader.Object([&](std::string_view key)
+        {
+            if (key == "name") name = reader.String();
+            else if (key == "texture") texture = reader.String();
+            else reader.Skip();
+        });
+        if (name.empty()) return reader.Fail("materials need a name");
+
+        SceneMaterial& material = materials[table.Find(name)];
+        if (material.defined) return reader.Fail("material defined twice");
+        material.texture = std::move(texture);
+        material.defined = true;
+    });
+}
+
+static void ParseSpheres(JsonReader& reader, MaterialTable& table, SphereArrays& spheres)
+{
+    const size_t start = reader.Offset();
+    reader.Array([&]
+    {
+        Vector3d center = Vector3d::Zero();
+        float radius = 1.0f;
+        int material = -1;
+        reader.Object([&](std::string_view key)
+        {
+            if (key == "center") center = reader.Vec3d();
+            else if (key == "radius") radius = reader.Number();
+            else if (key == "material") material = table.Find(reader.String());
+            else reader.Skip();
+        });
+        spheres.Add(center, radius, material);
+        // the arrays are sized once from how much text the first sphere took, growing them copies more than the parse costs
+        if (spheres.Count() == 1) spheres.Reserve(spheres.Count() + reader.Remaining() / Max<size_t>(reader.Offset() - start, 1));
+    });
+}
+
+static void ParseCubes(JsonReader& reader, MaterialTable& table, SceneDescription& scene)
+{
+    reader.Array([&]
+    {
+        Vector3 min(-0.5f), max(0.5f), rotation = Vector3::Zero();
+        Vector3d position = Vector3d::Zero();
+        bool transformed = false;
+        int material = -1;
+        reader.Object([&](std::string_view key)
+        {
+            if (key == "min") min = reader.Vec3();
+            else if (key == "max") max = reader.Vec3();
+            else if (key == "position") { position = reader.Vec3d(); transformed = true; }
+            else if (key == "rotation") { rotation = reader.Vec3() * DegToRad; transformed = true; }
+            else if (key == "material") material = table.Find(reader.String());
+            else reader.Skip();
+        });
+        if (!transformed) return scene.AddCube(Cube(min, max, material), Matrix4d::Identity());
+        const Quaternion orientation = Quaternion::FromEuler(rotation);
+        scene.AddCube(Cube(min, max, Matrix4::FromQuaternion(orientation) * Matrix4::FromPosition(ToVec3f(position)), material),
+                      Matrix4d::FromQuaternion(orientation) * Matrix4d::FromPosition(position));
+    });
+}
+
+static void ParsePlanes(JsonReader& reader, MaterialTable& table, SceneDescription& scene)
+{
+    reader.Array([&]
+    {
+        Vector3 normal = Vector3::Up();
+        Vector3d point = Vector3d::Zero();
+        int material = -1;
+        reader.Object([&](std::string_view key)
+        {
+            if (key == "normal") normal = reader.Vec3();
+            else if (key == "point") point = reader.Vec3d();
+            else if (key == "material") material = table.Find(reader.String());
+            else reader.Skip();
+        });
+        if (normal.LengthSquared() == 0.0f) return reader.Fail("plane normal is zero");
+        scene.AddPlane(normal, point, material);
+    });
+}
+
+static void ParseLights(JsonReader& reader, std::vector<Light>& lights)
+{
+    reader.Array([&]
+    {
+        Light light;
+        reader.Object([&](std::string_view key)
+        {
+            if (key == "center") light.center = reader.Vec3();
+            else if (key == "radius") light.radius = reader.Number();
+            else if (key == "emission") light.emission = reader.Rgb();
+            else reader.Skip();
+        });
+        if (!(light.radius > 0.0f)) return reader.Fail("light radius must be positive");
+        lights.push_back(light);
+    });
+}
+
+// keys have to be in frame order
+static void ParseTracks(JsonReader& reader, std::vector<TransformTrack>& tracks)
+{
+    reader.Array([&]
+    {
+        TransformTrack track;
+        track.index = -1;
+        reader.Object([&](std::string_view key)
+        {
+            if (key == "index") track.index = reader.Integer();
+            else if (key == "keys")
+            {
+                reader.Array([&]
+                {
+                    TransformKey transform = track.keys.empty() ? TransformKey() : track.keys.back();
+                    reader.Object([&](std::string_view field)
+                    {
+                        if (field == "frame") transform.frame = reader.Number();
+                        else if (field == "position") transform.position = reader.Vec3();
+                        else if (field == "rotation") transform.rotation = Quaternion::FromEuler(reader.Vec3() * DegToRad);
+                        else reader.Skip();
+                    });
+                    if (!track.keys.empty() && !(transform.frame > track.keys.back().frame)) return reader.Fail("animation keys must be in frame order");
+                    track.keys.push_back(transform);
+                });
+            }
+            else reader.Skip();
+        });
+        if (track.index < 0) return reader.Fail("animation tracks need the index of a primitive");
+        if (track.keys.empty()) return reader.Fail("animation tracks need keys");
+        tracks.push_back(std::move(track));
+    });
+}
+
+static void ParseAnimation(JsonReader& reader, Animation& animation)
+{
+    reader.Object([&](std::string_view key)
+    {
+        if (key == "frames") animation.frames = reader.Integer();
+        else if (key == "output") animation.output = reader.String();
+        else if (key == "camera")
+        {
+            reader.Array([&]
+            {
+                CameraKey camera = animation.camera.empty() ? CameraKey() : animation.camera.back();
+                ParseCamera(reader, camera.camera, &camera.frame);
+                if (!animation.camera.empty() && !(camera.frame > animation.camera.back().frame)) return reader.Fail("animation keys must be in frame order");
+                animation.camera.push_back(camera);
+            });
+        }
+        else if (key == "spheres") ParseTracks(reader, animation.spheres);
+        else if (key == "cubes") ParseTracks(reader, animation.cubes);
+        else reader.Skip();
+    });
+    if (animation.frames < 0) reader.Fail("animation frames must not be negative");
+}
+
+bool JsonScene::Parse(const char* text, size_t size, const char* name, SceneDescription& scene)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    JsonReader reader(text, size, name);
+    MaterialTable table(scene.materials);
+
+    reader.Object([&](std::string_view key)
+    {
+        if (key == "settings") ParseSettings(reader, scene.settings);
+        else if (key == "camera") { ParseCamera(reader, scene.camera, nullptr, &scene.cameraPosition); scene.hasCamera = true; }
+        else if (key == "materials") ParseMaterials(reader, table, scene.materials);
+        else if (key == "spheres") ParseSpheres(reader, table, scene.spheres);
+        else if (key == "cubes") ParseCubes(reader, table, scene);
+        else if (key == "planes") ParsePlanes(reader, table, scene);
+        else if (key == "lights") ParseLights(reader, scene.lights);
+        else if (key == "animation") ParseAnimation(reader, scene.animation);
+        else
+        {
+            // triangle meshes among them, the renderer has no triangle primitive
+            printf("scene json: %s: skipping unsupported section \"%.*s\"\n", name, int(key.size()), key.data());
+            reader.Skip();
+        }
+    });
+    if (!reader.AtEnd()) reader.Fail("unexpected text after the scene");
+    if (reader.Failed()) return false;
+
+    for (const SceneMaterial& material : scene.materials)
+    {
+        if (!material.defined) printf("scene json: %s: material \"%s\" is used but not defined, it is left untextured\n", name, material.name.c_str());
+    }
+
+    scene.bytes = size;
+    scene.parseMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
+bool JsonScene::Parse(const char* path, SceneDescription& scene)
+{
+    MappedFile file;
+    if (!file.OpenRead(path))
+    {
+        printf("scene json: could not open %s\n", path);
+        return false;
+    }
+    file.AdviseSequential();
+    return Parse(reinterpret_cast<const char*>(file.Data()), file.Size(), path, scene);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,96 @@
+#pragma once
+#include "Intersection.hpp"
+#include "LightBVH.hpp"
+#include "Animation.hpp"
+#include "Math/Matrix4d.hpp"
+#include <string>
+
+AMATH_NAMESPACE
+
+// human readable scene description. every section is optional, unknown keys are skipped:
+// {
+//   "settings":  { "width": 400, "height": 225, "samples": 8, "denoise": true, "tonemap": "aces", "exposure": 0, "output": "export.jpg", "quality": 90, "environment": "sky.hdr", "large_world": false },
+//   "camera":    { "position": [0, 0, 0], "target": [0, 0, -1], "up": [0, 1, 0], "fov": 90 },
+//   "materials": [ { "name": "bricks", "texture": "bricks.png" } ],
+//   "spheres":   [ { "center": [0, 0, -1], "radius": 0.5, "material": "bricks" } ],
+//   "cubes":     [ { "min": [-0.2, -0.2, -0.2], "max": [0.2, 0.2, 0.2], "position": [1, -0.3, -1.4], "rotation": [0, 34, 0] } ],
+//   "planes":    [ { "normal": [0, 1, 0], "point": [0, -0.5, 0] } ],
+//   "lights":    [ { "center": [0, 2, 0], "radius": 0.1, "emission": [4, 4, 4] } ],
+//   "animation": { "frames": 96, "output": "frames/shot_%04d.png",
+//                  "camera": [ { "frame": 0, "position": [0, 0, 0], "target": [0, 0, -1], "up": [0, 1, 0], "fov": 90 } ],
+//                  "spheres": [ { "index": 0, "keys": [ { "frame": 0, "position": [0, 0, -1] }, { "frame": 95, "position": [0, 1, -1] } ] } ],
+//                  "cubes":   [ { "index": 0, "keys": [ { "frame": 0, "position": [1, -0.3, -1.4], "rotation": [0, 0, 0] } ] } ] }
+// }
+// rotations and the field of view are in degrees. sphere centers, cube positions, plane points and the camera position are read in double,
+// a large world is rebased around its camera from them. materials are referenced by name and may be defined after their first use.
+// animated primitives are referred to by their index in their section, camera keys start from the key before them
+
+struct SceneMaterial
+{
+	std::string name;
+	std::string texture; // empty for the plain diffuse albedo
+	bool defined = false;
+};
+
+// zero, -1 or empty for settings the file does not set
+struct SceneSettings
+{
+	int width = 0, height = 0;
+	int samples = 0;
+	int quality = 0;
+	int denoise = -1;
+	std::string tonemap;
+	float exposure = 0.0f;
+	std::string output;
+	std::string environment;
+	int largeWorld = -1;
+};
+
+// what a scene file describes. the texture field of primitives holds an index into materials, or -1
+struct SceneDescription
+{
+	Camera camera;
+	Vector3d cameraPosition; // camera.position in double, a large world is centered on it
+	bool hasCamera = false;
+	SceneSettings settings;
+	std::vector<SceneMaterial> materials;
+	SphereArrays spheres;
+	std::vector<Cube> cubes;
+	std::vector<Plane> planes;
+	// double precision placement of cubes[i] and planes[i], what a large world rebases instead of the float copies
+	std::vector<Matrix4d> cubeTransforms; // localToWorld
+	std::vector<Vector3d> planePoints;
+	std::vector<Light> lights;
+	Animation animation;
+
+	size_t bytes = 0;
+	float parseMilliseconds = 0.0f;
+
+	void SetCamera(const Camera& _camera)
+	{
+		camera = _camera;
+		cameraPosition = ToVec3d(_camera.position);
+		hasCamera = true;
+	}
+	void AddCube(const Cube& cube, const Matrix4d& localToWorld)
+	{
+		cubes.push_back(cube);
+		cubeTransforms.push_back(localToWorld);
+	}
+	void AddPlane(const Vector3& normal, const Vector3d& point, int texture)
+	{
+		planes.push_back(Plane(normal, ToVec3f(point), texture));
+		planePoints.push_back(point);
+	}
+};
+
+// single pass over the text straight into the arrays above, no document tree is built.
+// errors are logged with line and column and leave scene partially filled
+namespace JsonScene
+{
+	bool Parse(const char* path, SceneDescription& scene);
+	// name only appears in error messages
+	bool Parse(const char* text, size_t size, const char* name, SceneDescription& scene);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,240 @@
+#include "LightBVH.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+
+AMATH_NAMESPACE
+
+constexpr int   LightBVHBucketCount = 12;
+constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
+LightCone LightCone::Union(const LightCone& a, const LightCone& b)
+{
+    if (a.IsEmpty()) return b;
+    if (b.IsEmpty()) return a;
+
+    const float thetaE = Max(a.thetaE, b.thetaE);
+    const float thetaD = acosf(Clamp(Vector3::Dot(a.axis, b.axis), -1.0f, 1.0f));
+
+    // one cone already contains the other
+    if (Min(thetaD + b.thetaO, PI) <= a.thetaO) return LightCone(a.axis, a.thetaO, thetaE);
+    if (Min(thetaD + a.thetaO, PI) <= b.thetaO) return LightCone(b.axis, b.thetaO, thetaE);
+
+    const float thetaO = (a.thetaO + thetaD + b.thetaO) * 0.5f;
+    if (thetaO >= PI) return LightCone(a.axis, PI, thetaE);
+
+    // rotate a's axis towards b's axis
+    const float thetaR = thetaO - a.thetaO;
+    Vector3 perpendicular = b.axis - a.axis * Vector3::Dot(a.axis, b.axis);
+    const float perpendicularLength = perpendicular.Length();
+    if (perpendicularLength < 1e-6f) return LightCone(a.axis, PI, thetaE);
+    perpendicular /= perpendicularLength;
+
+    const Vector3 axis = a.axis * cosf(thetaR) + perpendicular * sinf(thetaR);
+    return LightCone(axis, thetaO, thetaE);
+}
+
+float LightCone::Measure() const
+{
+    const float thetaW = Min(thetaO + thetaE, PI);
+    const float cosO = cosf(thetaO), sinO = sinf(thetaO);
+    return TwoPI * (1.0f - cosO) +
+           PIDiv2 * (2.0f * thetaW * sinO - cosf(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinO + cosO);
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b
+FINLINE float CosSubClamped(float sinA, float cosA, float sinB, float cosB) { return cosA > cosB ? 1.0f : cosA * cosB + sinA * sinB; }
+FINLINE float SinSubClamped(float sinA, float cosA, float sinB, float cosB) { return cosA > cosB ? 0.0f : sinA * cosB - cosA * sinB; }
+FINLINE float SafeSqrt(float x) { return sqrtf(Max(x, 0.0f)); }
+
+float LightBVH::Importance(const LightBVHNode& node, const Vector3& point, const Vector3& normal)
+{
+    const Vector3 toPoint = point - node.bounds.Center();
+    const float radiusSq = node.bounds.Diagonal().LengthSquared() * 0.25f;
+    const float lengthSq = toPoint.LengthSquared();
+
+    // don't let the estimate blow up when the point is inside the bounds
+    if (lengthSq <= radiusSq) return node.power / Max(radiusSq, 1e-8f);
+
+    const Vector3 wi = toPoint / sqrtf(lengthSq);
+    // cone that bounds the node, seen from point
+    const float sinThetaB = sqrtf(radiusSq / lengthSq);
+    const float cosThetaB = SafeSqrt(1.0f - sinThetaB * sinThetaB);
+
+    // emission side: angle between the cone and the direction to the shading point
+    const float cosThetaW = Clamp(Vector3::Dot(node.axis, wi), -1.0f, 1.0f);
+    const float sinThetaW = SafeSqrt(1.0f - cosThetaW * cosThetaW);
+    const float sinThetaO = SafeSqrt(1.0f - node.cosThetaO * node.cosThetaO);
+    const float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+    const float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO);
+    const float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= node.cosThetaE) return 0.0f;
+
+    // receiver side: lights below the shading hemisphere can't contribute
+    const float cosThetaI = Clamp(-Vector3::Dot(normal, wi), -1.0f, 1.0f);
+    const float sinThetaI = SafeSqrt(1.0f - cosThetaI * cosThetaI);
+    const float cosThetaIP = CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    if (cosThetaIP <= 0.0f) return 0.0f;
+
+    return node.power * cosThetaP * cosThetaIP / lengthSq;
+}
+
+void LightBVH::Build(const std::vector<Light>& lights)
+{
+    Trace::Scope scope("light bvh build");
+    const auto start = std::chrono::high_resolution_clock::now();
+    Clear();
+
+    if (!lights.empty())
+    {
+        std::vector<int> indices(lights.size());
+        for (int i = 0; i < (int)lights.size(); ++i) indices[i] = i;
+
+        nodes.reserve(lights.size() * 2 - 1);
+        BuildRecursive(lights, indices, 0, (int)lights.size());
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    buildMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+int LightBVH::BuildRecursive(const std::vector<Light>& lights, std::vector<int>& indices, int begin, int end)
+{
+    const int nodeIndex = (int)nodes.size();
+    nodes.emplace_back();
+
+    LightBVHNode node;
+    LightCone cone;
+    node.power = 0.0f;
+    node.rightChild = -1;
+    node.light = -1;
+
+    AABB centroidBounds;
+    for (int i = begin; i < end; ++i)
+    {
+        const Light& light = lights[indices[i]];
+        node.bounds.Grow(light.Bounds());
+        cone = LightCone::Union(cone, LightCone::Sphere());
+        node.power += light.Power();
+        centroidBounds.Grow(light.center);
+    }
+
+    node.axis = cone.axis;
+    node.cosThetaO = cosf(cone.thetaO);
+    node.cosThetaE = cosf(cone.thetaE);
+
+    if (end - begin == 1)
+    {
+        node.light = indices[begin];
+        nodes[nodeIndex] = node;
+        return nodeIndex;
+    }
+
+    // bucketed surface area orientation heuristic
+    struct Bucket { AABB bounds; LightCone cone; float power = 0.0f; };
+
+    const Vector3 extent = centroidBounds.Diagonal();
+    const float maxExtent = Max(extent.x, Max(extent.y, extent.z));
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestSplit = -1;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent.arr[axis] <= 0.0f) continue;
+        Bucket buckets[LightBVHBucketCount];
+
+        for (int i = begin; i < end; ++i)
+        {
+            const Light& light = lights[indices[i]];
+            float offset = (light.center.arr[axis] - centroidBounds.min.arr[axis]) / extent.arr[axis];
+            int b = Min(int(offset * LightBVHBucketCount), LightBVHBucketCount - 1);
+            buckets[b].bounds.Grow(light.Bounds());
+            buckets[b].cone = LightCone::Union(buckets[b].cone, LightCone::Sphere());
+            buckets[b].power += light.Power();
+        }
+
+        // thin boxes are penalized so splits follow the longest axis
+        const float regularization = maxExtent / extent.arr[axis];
+
+        for (int split = 0; split < LightBVHBucketCount - 1; ++split)
+        {
+            Bucket left, right;
+            for (int b = 0; b <= split; ++b)
+            {
+                left.bounds.Grow(buckets[b].bounds);
+                left.cone = LightCone::Union(left.cone, buckets[b].cone);
+                left.power += buckets[b].power;
+            }
+            for (int b = split + 1; b < LightBVHBucketCount; ++b)
+            {
+                right.bounds.Grow(buckets[b].bounds);
+                right.cone = LightCone::Union(right.cone, buckets[b].cone);
+                right.power += buckets[b].power;
+            }
+            if (left.bounds.IsEmpty() || right.bounds.IsEmpty()) continue;
+
+            const float cost = regularization *
+                (left.power  * left.cone.Measure()  * left.bounds.SurfaceArea() +
+                 right.power * right.cone.Measure() * right.bounds.SurfaceArea());
+
+            if (cost < bestCost) { bestCost = cost; bestAxis = axis; bestSplit = split; }
+        }
+    }
+
+    int mid;
+    if (bestAxis != -1)
+    {
+        const float axisMin = centroidBounds.min.arr[bestAxis], axisExtent = extent.arr[bestAxis];
+        int* split = std::partition(indices.data() + begin, indices.data() + end, [&](int index)
+        {
+            float offset = (lights[index].center.arr[bestAxis] - axisMin) / axisExtent;
+            return Min(int(offset * LightBVHBucketCount), LightBVHBucketCount - 1) <= bestSplit;
+        });
+        mid = int(split - indices.data());
+    }
+    else
+    {
+        // every centroid is at the same place, split in the middle
+        mid = (begin + end) / 2;
+    }
+
+    BuildRecursive(lights, indices, begin, mid);
+    node.rightChild = BuildRecursive(lights, indices, mid, end);
+    nodes[nodeIndex] = node;
+    return nodeIndex;
+}
+
+bool LightBVH::Sample(const Vector3& point, const Vector3& normal, float u, int& lightIndex, float& pmf) const
+{
+    if (nodes.empty() || Importance(nodes[0], point, normal) <= 0.0f) return false;
+
+    int index = 0;
+    pmf = 1.0f;
+
+    while (nodes[index].rightChild != -1)
+    {
+        const float left  = Importance(nodes[index + 1], point, normal);
+        const float right = Importance(nodes[nodes[index].rightChild], point, normal);
+        if (left + right <= 0.0f) return false;
+
+        const float probabilityLeft = left / (left + right);
+        // reuse u for the next level instead of drawing a new random number
+        if (u < probabilityLeft)
+        {
+            index = index + 1;
+            pmf *= probabilityLeft;
+            u = Min(u / probabilityLeft, OneMinusEpsilon);
+        }
+        else
+        {
+            index = nodes[index].rightChild;
+            pmf *= 1.0f - probabilityLeft;
+            u = Min((u - probabilityLeft) / (1.0f - probabilityLeft), OneMinusEpsilon);
+        }
+    }
+
+    lightIndex = nodes[index].light;
+    return pmf > 0.0f;
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,78 @@
+#pragma once
+#include "Structures.hpp"
+#include "Math/Color.hpp"
+#include <vector>
+
+AMATH_NAMESPACE
+
+// small spherical emitter, only reached through next event estimation
+struct Light
+{
+	Vector3 center;
+	float radius;
+	Color emission;
+
+	Light() : center(Vector3::Zero()), radius(1.0f), emission(1.0f) {}
+	Light(const Vector3& _center, float _radius, const Color& _emission) : center(_center), radius(_radius), emission(_emission) {}
+
+	// emitted flux, luminance * area * PI
+	FINLINE float Power() const { return emission.Luminance() * 4.0f * PI * radius * radius * PI; }
+
+	FINLINE AABB Bounds() const { return AABB(center - Vector3(radius), center + Vector3(radius)); }
+};
+
+// bounds the emission directions of a set of lights
+// thetaO bounds the normals around axis, thetaE is the spread around each normal
+struct LightCone
+{
+	Vector3 axis;
+	float thetaO;
+	float thetaE;
+
+	LightCone() : axis(Vector3::Forward()), thetaO(-1.0f), thetaE(0.0f) {}
+	LightCone(const Vector3& _axis, float _thetaO, float _thetaE) : axis(_axis), thetaO(_thetaO), thetaE(_thetaE) {}
+
+	FINLINE bool IsEmpty() const { return thetaO < 0.0f; }
+
+	// spheres emit in every direction
+	static LightCone Sphere() { return LightCone(Vector3::Forward(), PI, PIDiv2); }
+	static LightCone Union(const LightCone& a, const LightCone& b);
+	// solid angle measure used by the build cost
+	float Measure() const;
+};
+
+struct LightBVHNode
+{
+	AABB bounds;
+	// cone stored as cosines so importance needs no trigonometry
+	Vector3 axis;
+	float cosThetaO;
+	float cosThetaE;
+	float power;
+	int rightChild; // left child is always the next node, -1 for leaves
+	int light;		// light index for leaves
+};
+
+// light hierarchy from "Importance Sampling of Many Lights with Adaptive Tree Splitting" (Conty Estevez, Kulla 2018)
+// each node stores bounds, orientation cone and power; traversal picks a child proportional to its estimated contribution
+class LightBVH
+{
+public:
+	std::vector<LightBVHNode> nodes;
+	float buildMilliseconds = 0.0f;
+
+	void Build(const std::vector<Light>& lights);
+	void Clear() { nodes.clear(); }
+	bool Empty() const { return nodes.empty(); }
+
+	// picks one light for a shading point with probability proportional to its importance
+	// returns false if no light can contribute
+	bool Sample(const Vector3& point, const Vector3& normal, float u, int& lightIndex, float& pmf) const;
+
+	static float Importance(const LightBVHNode& node, const Vector3& point, const Vector3& normal);
+
+private:
+	int BuildRecursive(const std::vector<Light>& lights, std::vector<int>& indices, int begin, int end);
+};
+
+AMATH_END_NAMESPACE
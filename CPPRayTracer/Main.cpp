@@ -1,15 +1,125 @@
 
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include <gl/glew.h>
 #include <GLFW/glfw3.h>
 #include "RayTracer.hpp"
+#include "MathBenchmark.hpp"
 #include <Windows.h>
 #include "Math/All.hpp"
 
 using namespace mat;
 
-int main()
+int main(int argc, char** argv)
 {
+	// --checkpoint <path> saves the frame in progress every minute, --resume continues from it
+	// --scene <path> renders a binary scene or a .json scene description, --export-scene <path> writes the built in scene as one and exits
+	// --corpus <name> renders a generated benchmark scene (default, weekend, cloud, mesh, lights)
+	// --corpus-benchmark <dir> renders every one and exits with 1 if one is slower than the baseline in dir by more than
+	// --corpus-tolerance <fraction> (0.1) or its image changed, --corpus-update stores a new baseline there instead
+	// --startup-benchmark <path> times loading a binary scene cold and warm and exits
+	// --math-benchmark times the math library against scalar code, checks its accuracy and exits
+	// --frame-benchmark <frames> renders the scene that many times, logs time and heap allocations per frame and exits
+	// --animation renders every frame of the scene animation, --animation-frames <first> <count> renders only those
+	// --motion-blur <shutter> <segments> blurs the frames over shutter frames, the paths in segments straight pieces
+	// --large-world traces json scenes around their camera with primitives placed in double, for worlds kilometers wide
+	// --large-world-benchmark <dir> <distance> compares scenes moved that far away with and without it and exits
+	// --deterministic renders on every thread with an image that does not depend on the thread count, --threads <n> limits them
+	// --region <x> <y> <width> <height> renders only that rectangle in the full image, --crop <x> <y> <width> <height> writes just
+	// the rectangle, --priority <x> <y> <width> <height> renders it before the rest and writes it as soon as it is done
+	// --bvh-cache <dir> stores built bvhs there instead of ./bvhcache, --no-bvh-cache always builds
+	// --stats <path> writes the ray counts and Mrays/s of the frame as json
+	// --trace <path> records a timeline of the run as chrome trace json, open it in ui.perfetto.dev
+	// --heatmap renders bvh traversal cost instead of the image, --heatmap-counts <path> also dumps the raw counts as pfm/exr
+	// --tonemap aces|reinhard|none, --exposure <stops> and --no-dither change the 8 bit output stage
+	const char* checkpointPath = "render.checkpoint";
+	const char* scenePath = nullptr;
+	const char* exportScenePath = nullptr;
+	const char* benchmarkScenePath = nullptr;
+	const char* largeWorldDirectory = nullptr;
+	double largeWorldDistance = 10000.0;
+	const char* corpusScene = nullptr;
+	const char* corpusDirectory = nullptr;
+	float corpusTolerance = 0.1f;
+	bool corpusUpdate = false;
+	int benchmarkFrames = 0;
+	bool animation = false;
+	int animationFirst = 0, animationCount = 0;
+	bool mathBenchmark = false;
+	const char* toneCurve = nullptr;
+	float exposure = 0.0f;
+	bool dither = true;
+	bool resume = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--resume") == 0) resume = true;
+		else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) checkpointPath = argv[++i];
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) scenePath = argv[++i];
+		else if (strcmp(argv[i], "--export-scene") == 0 && i + 1 < argc) exportScenePath = argv[++i];
+		else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) corpusScene = argv[++i];
+		else if (strcmp(argv[i], "--corpus-benchmark") == 0 && i + 1 < argc) corpusDirectory = argv[++i];
+		else if (strcmp(argv[i], "--corpus-tolerance") == 0 && i + 1 < argc) corpusTolerance = float(atof(argv[++i]));
+		else if (strcmp(argv[i], "--corpus-update") == 0) corpusUpdate = true;
+		else if (strcmp(argv[i], "--startup-benchmark") == 0 && i + 1 < argc) benchmarkScenePath = argv[++i];
+		else if (strcmp(argv[i], "--math-benchmark") == 0) mathBenchmark = true;
+		else if (strcmp(argv[i], "--frame-benchmark") == 0 && i + 1 < argc) benchmarkFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--animation") == 0) animation = true;
+		else if (strcmp(argv[i], "--animation-frames") == 0 && i + 2 < argc)
+		{
+			animation = true;
+			animationFirst = atoi(argv[i + 1]);
+			animationCount = atoi(argv[i + 2]);
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--motion-blur") == 0 && i + 2 < argc)
+		{
+			RayTracer::SetMotionBlur(float(atof(argv[i + 1])), atoi(argv[i + 2]));
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--large-world") == 0) RayTracer::SetLargeWorld(true);
+		else if (strcmp(argv[i], "--large-world-benchmark") == 0 && i + 2 < argc)
+		{
+			largeWorldDirectory = argv[i + 1];
+			largeWorldDistance = atof(argv[i + 2]);
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--deterministic") == 0) RayTracer::SetDeterministic(true);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) RayTracer::SetThreads(atoi(argv[++i]));
+		else if ((strcmp(argv[i], "--region") == 0 || strcmp(argv[i], "--crop") == 0) && i + 4 < argc)
+		{
+			RayTracer::SetRegion(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]), atoi(argv[i + 4]), strcmp(argv[i], "--crop") == 0);
+			i += 4;
+		}
+		else if (strcmp(argv[i], "--priority") == 0 && i + 4 < argc)
+		{
+			RayTracer::SetPriorityRegion(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]), atoi(argv[i + 4]));
+			i += 4;
+		}
+		else if (strcmp(argv[i], "--bvh-cache") == 0 && i + 1 < argc) RayTracer::SetBVHCache(argv[++i]);
+		else if (strcmp(argv[i], "--no-bvh-cache") == 0) RayTracer::SetBVHCache(nullptr);
+		else if (strcmp(argv[i], "--tonemap") == 0 && i + 1 < argc) toneCurve = argv[++i];
+		else if (strcmp(argv[i], "--exposure") == 0 && i + 1 < argc) exposure = float(atof(argv[++i]));
+		else if (strcmp(argv[i], "--no-dither") == 0) dither = false;
+		else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) RayTracer::SetStatisticsOutput(argv[++i]);
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) RayTracer::SetTrace(argv[++i]);
+		else if (strcmp(argv[i], "--heatmap") == 0) RayTracer::SetHeatmap(true);
+		else if (strcmp(argv[i], "--heatmap-counts") == 0 && i + 1 < argc) RayTracer::SetHeatmap(true, argv[++i]);
+	}
+
+	if (mathBenchmark)
+	{
+		MathBenchmark::Run();
+		return 0;
+	}
+	if (corpusDirectory) return RayTracer::BenchmarkCorpus(corpusDirectory, corpusTolerance, corpusUpdate) ? 0 : 1;
+	if (largeWorldDirectory) return RayTracer::BenchmarkLargeWorld(largeWorldDirectory, largeWorldDistance) ? 0 : 1;
+	if (benchmarkScenePath)
+	{
+		RayTracer::BenchmarkSceneStartup(benchmarkScenePath);
+		return 0;
+	}
+
 	std::cout << "Hello World!\n";
 
 	float radian = 90.0f * DegToRad;
@@ -26,8 +136,38 @@ int main()
 		}
 		std::cout << std::endl;
 	}
-	// RayTracer::Initialize();
-	// RayTracer::RenderFrame();
+	if (corpusScene)
+	{
+		if (!RayTracer::LoadCorpusScene(corpusScene)) return 1;
+	}
+	else if (scenePath)
+	{
+		const size_t length = strlen(scenePath);
+		const bool json = length > 5 && _stricmp(scenePath + length - 5, ".json") == 0;
+		if (!(json ? RayTracer::LoadJsonScene(scenePath) : RayTracer::LoadScene(scenePath))) return 1;
+	}
+	else RayTracer::Initialize();
+
+	if (exportScenePath) return RayTracer::ExportScene(exportScenePath) ? 0 : 1;
+	// after the scene so the command line wins over its settings
+	if ((toneCurve || exposure != 0.0f || !dither) && !RayTracer::SetTonemap(toneCurve ? toneCurve : "aces", exposure, dither)) return 1;
+
+	if (benchmarkFrames > 0)
+	{
+		RayTracer::BenchmarkFrames(benchmarkFrames);
+		RayTracer::FinishOutput();
+		return 0;
+	}
+	if (animation)
+	{
+		const bool rendered = RayTracer::RenderAnimation(animationFirst, animationCount);
+		RayTracer::FinishOutput();
+		return rendered ? 0 : 1;
+	}
+
+	RayTracer::SetCheckpoint(checkpointPath, 60.0f, resume);
+	RayTracer::RenderFrame();
+	RayTracer::FinishOutput();
 
 
 	// ShellExecute(nullptr, nullptr, L"export.jpg", nullptr, nullptr, 0);
@@ -0,0 +1,152 @@
+#include "MappedFile.hpp"
+#include <filesystem>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::OpenRead(const char* path)
+{
+    Close();
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { file = nullptr; return false; }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) { Close(); return false; }
+    size = size_t(fileSize.QuadPart);
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) { Close(); return false; }
+    return true;
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (!data) return;
+    // starts reading the whole range in the background, page faults then find most pages present
+    WIN32_MEMORY_RANGE_ENTRY range = { data, size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+bool MappedFile::Create(const char* path, size_t _size)
+{
+    Close();
+    if (_size == 0) return false;
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { file = nullptr; return false; }
+
+    size = _size;
+    writable = true;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), nullptr);
+    if (mapping) data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+    if (!data) { Close(); return false; }
+    return true;
+}
+
+bool MappedFile::Flush()
+{
+    if (!data || !writable) return false;
+    return FlushViewOfFile(data, 0) && FlushFileBuffers(file);
+}
+
+void MappedFile::Close()
+{
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    data = nullptr; mapping = nullptr; file = nullptr;
+    size = 0;
+    writable = false;
+}
+
+bool MappedFile::EvictFromCache(const char*)
+{
+    return false;
+}
+
+#else
+
+bool MappedFile::OpenRead(const char* path)
+{
+    Close();
+    file = open(path, O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) { Close(); return false; }
+    size = size_t(status.st_size);
+
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) { Close(); return false; }
+    data = static_cast<uint8_t*>(address);
+    return true;
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (!data) return;
+    // larger readahead on the file and no need to keep pages behind the reader
+    posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+    madvise(data, size, MADV_SEQUENTIAL);
+}
+
+bool MappedFile::Create(const char* path, size_t _size)
+{
+    Close();
+    if (_size == 0) return false;
+    file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) return false;
+    if (ftruncate(file, off_t(_size)) != 0) { Close(); return false; }
+
+    size = _size;
+    writable = true;
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) { Close(); return false; }
+    data = static_cast<uint8_t*>(address);
+    return true;
+}
+
+bool MappedFile::Flush()
+{
+    if (!data || !writable) return false;
+    return msync(data, size, MS_SYNC) == 0 && fsync(file) == 0;
+}
+
+void MappedFile::Close()
+{
+    if (data) munmap(data, size);
+    if (file >= 0) close(file);
+    data = nullptr;
+    file = -1;
+    size = 0;
+    writable = false;
+}
+
+bool MappedFile::EvictFromCache(const char* path)
+{
+    const int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) return false;
+    const bool evicted = posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(descriptor);
+    return evicted;
+}
+
+#endif
+
+bool MappedFile::ReplaceAtomically(const std::string& temporaryPath, const std::string& path)
+{
+    // rename replaces an existing target in one step on both windows and posix
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// whole file memory mapping, read only for loading or read write for a freshly created file of fixed size
+// the mapping is released in Close or the destructor, pointers into it are invalid after that
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
+
+	bool OpenRead(const char* path);
+	// creates or truncates path to size bytes and maps it writable
+	bool Create(const char* path, size_t size);
+	// writes dirty pages back to disk, returns when they are on disk
+	bool Flush();
+	void Close();
+
+	// hint that the mapping is about to be read front to back once, for parsers
+	void AdviseSequential() const;
+
+	bool IsOpen() const { return data != nullptr; }
+	uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+	template<typename T> const T* As(size_t offset = 0) const { return reinterpret_cast<const T*>(data + offset); }
+
+	// renames temporaryPath over path in one step, readers see the old or the new file, never half of one
+	static bool ReplaceAtomically(const std::string& temporaryPath, const std::string& path);
+	// asks the os to drop the cached pages of path so the next open reads from disk, for cold start benchmarks.
+	// best effort, returns false where it is not supported (windows)
+	static bool EvictFromCache(const char* path);
+
+private:
+	uint8_t* data = nullptr;
+	size_t size = 0;
+	bool writable = false;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
@@ -61,8 +61,12 @@ struct Color
 		return a + b;
 	}
 
+	// Rec. 709 luma, used for importance sampling
+	FINLINE float Luminance() const { return 0.2126f * r + 0.7152f * g + 0.0722f * b; }
+
+	// linear, no tone curve or gamma, the renderer's output goes through Tonemapper instead
 	Color32 ConvertToColor32() {
-		Color converted = *this * 255.0f;
+		Color converted = Color(_mm_min_ps(_mm_max_ps(vec, _mm_setzero_ps()), _mm_set1_ps(1.0f))) * 255.0f;
 		return Color32(uint8(converted.r), uint8(converted.g), uint8(converted.b));
 	}
 
@@ -65,7 +65,7 @@ FINLINE double LerpAngle(const double a, const double b, const double t) noexcep
 // Code below adapted from DirectX::Math
 inline void ScalarSinCos(float* pSin, float* pCos, float  Value) noexcept
 {
-	float quotient = (1.0f / PI) * Value;
+	float quotient = (1.0f / TwoPI) * Value;
 
 	if (Value >= 0.0f)
 		quotient = float(int(quotient + 0.5f));
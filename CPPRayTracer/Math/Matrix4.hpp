@@ -87,7 +87,7 @@ struct Matrix4
 
 	FINLINE static Matrix4 VECTORCALL FromQuaternion(const Quaternion quaternion)
 	{
-		static const Vector4 Constant1110 = { { { 1.0f, 1.0f, 1.0f, 0.0f } } };
+		static const Vector4 Constant1110 = Vector4(1.0f, 1.0f, 1.0f, 0.0f);
 
 		__m128  Q0 = _mm_add_ps(quaternion.vec, quaternion.vec);
 		__m128  Q1 = _mm_mul_ps(quaternion.vec, Q0);
@@ -258,9 +258,9 @@ struct Matrix4
 		V02 = _mm_shuffle_ps(MT.r[2], MT.r[0], _MM_SHUFFLE(3, 1, 3, 1));
 		V12 = _mm_shuffle_ps(MT.r[3], MT.r[1], _MM_SHUFFLE(2, 0, 2, 0));
 
-		D0 = _mm_fmadd_ps(V00, V10, D0);
-		D1 = _mm_fmadd_ps(V01, V11, D1);
-		D2 = _mm_fmadd_ps(V02, V12, D2);
+		D0 = _mm_fnmadd_ps(V00, V10, D0);
+		D1 = _mm_fnmadd_ps(V01, V11, D1);
+		D2 = _mm_fnmadd_ps(V02, V12, D2);
 		// V11 = D0Y,D0W,D2Y,D2Y
 		V11 = _mm_shuffle_ps(D0, D2, _MM_SHUFFLE(1, 1, 3, 1));
 		V00 = _mm_permute_ps(MT.r[1], _MM_SHUFFLE(1, 0, 2, 1));
@@ -499,6 +499,21 @@ struct Matrix4
 		return vResult;
 	}
 
+	// same as Vector3Transform without the translation, for directions
+	FINLINE static Vector4 VECTORCALL Vector3TransformNormal(const Vector3 V, const Matrix4 M) noexcept
+	{
+		__m128 vec = V.vec();
+		__m128 vResult = _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(0, 0, 0, 0));
+		vResult = _mm_mul_ps(vResult, M.r[0]);
+		__m128 vTemp = _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(1, 1, 1, 1));
+		vTemp = _mm_mul_ps(vTemp, M.r[1]);
+		vResult = _mm_add_ps(vResult, vTemp);
+		vTemp = _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(2, 2, 2, 2));
+		vTemp = _mm_mul_ps(vTemp, M.r[2]);
+		vResult = _mm_add_ps(vResult, vTemp);
+		return vResult;
+	}
+
 };
 
 
@@ -7,6 +7,8 @@
 
 AMATH_NAMESPACE
 
+// double precision Matrix4 with the same conventions: row vectors, v * M, row 3 is the translation.
+// for transforms that place things kilometers from the origin, where float runs out of bits
 struct Matrix4d
 {
 	union
@@ -14,20 +16,164 @@ struct Matrix4d
 		__m256d  r[4];
 		Vector4d  vec[4];
 		struct { __m256d  r1, r2, r3, r4; };
-		struct { Vector4d vec1, vec2, vec3, vec4; };
-		float m[4][4];
+		double m[4][4];
 	};
 
 	Matrix4d()
-	:	r1(_mm256_set_pd(1, 0, 0, 0)), 
-		r2(_mm256_set_pd(0, 1, 0, 0)), 
-		r3(_mm256_set_pd(0, 0, 1, 0)), 
-		r4(_mm256_set_pd(0, 0, 0, 1)) { }
-	
-	// maybe fill this but working with 1024 bit struct is a bit unnecessary
+	:	r1(_mm256_setr_pd(1, 0, 0, 0)),
+		r2(_mm256_setr_pd(0, 1, 0, 0)),
+		r3(_mm256_setr_pd(0, 0, 1, 0)),
+		r4(_mm256_setr_pd(0, 0, 0, 1)) { }
 
 	VECTORCALL Matrix4d(const __m256d x, const __m256d y, const __m256d& z, const __m256d& w) : r1(x), r2(y), r3(z), r4(w) {}
-	VECTORCALL Matrix4d(const Vector4d x, const Vector4d y, const Vector4d& z, const Vector4d& w) : vec1(x), vec2(y), vec3(z), vec4(w) {}
+	VECTORCALL Matrix4d(const Vector4d x, const Vector4d y, const Vector4d& z, const Vector4d& w) : r1(x.vec), r2(y.vec), r3(z.vec), r4(w.vec) {}
+	explicit Matrix4d(const Matrix4& M) : r1(_mm256_cvtps_pd(M.r[0])), r2(_mm256_cvtps_pd(M.r[1])), r3(_mm256_cvtps_pd(M.r[2])), r4(_mm256_cvtps_pd(M.r[3])) {}
+
+	const double* operator [] (int index) const { return m[index]; }
+		  double* operator [] (int index)	    { return m[index]; }
+
+	Matrix4d VECTORCALL  operator *  (const Matrix4d& M) const noexcept { return Matrix4d::Multiply(*this, M); };
+	Matrix4d& VECTORCALL operator *= (const Matrix4d& M) noexcept { *this = Matrix4d::Multiply(*this, M); return *this; };
+
+	FINLINE static Matrix4d Identity() { return Matrix4d(); }
+
+	FINLINE static Matrix4d FromPosition(const double x, const double y, const double z)
+	{
+		Matrix4d M;
+		M.r[3] = _mm256_setr_pd(x, y, z, 1.0);
+		return M;
+	}
+
+	FINLINE static Matrix4d FromPosition(const Vector3d& vec3)
+	{
+		return FromPosition(vec3.x, vec3.y, vec3.z);
+	}
+
+	FINLINE static Matrix4d CreateScale(const double ScaleX, const double ScaleY, const double ScaleZ)
+	{
+		Matrix4d M;
+		M.r[0] = _mm256_setr_pd(ScaleX, 0, 0, 0);
+		M.r[1] = _mm256_setr_pd(0, ScaleY, 0, 0);
+		M.r[2] = _mm256_setr_pd(0, 0, ScaleZ, 0);
+		return M;
+	}
+
+	FINLINE static Matrix4d CreateScale(const Vector3d& vec3)
+	{
+		return CreateScale(vec3.x, vec3.y, vec3.z);
+	}
+
+	// the same rotation as Matrix4::FromQuaternion, expanded in double
+	inline static Matrix4d FromQuaternion(const Quaternion quaternion)
+	{
+		const double x = quaternion.x, y = quaternion.y, z = quaternion.z, w = quaternion.w;
+		const double xx = x * x, yy = y * y, zz = z * z;
+		const double xy = x * y, xz = x * z, yz = y * z, xw = x * w, yw = y * w, zw = z * w;
+		Matrix4d M;
+		M.r[0] = _mm256_setr_pd(1.0 - 2.0 * (yy + zz), 2.0 * (xy + zw), 2.0 * (xz - yw), 0.0);
+		M.r[1] = _mm256_setr_pd(2.0 * (xy - zw), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + xw), 0.0);
+		M.r[2] = _mm256_setr_pd(2.0 * (xz + yw), 2.0 * (yz - xw), 1.0 - 2.0 * (xx + yy), 0.0);
+		return M;
+	}
+
+	FINLINE static Matrix4d VECTORCALL Transpose(const Matrix4d& M)
+	{
+		const __m256d vTemp1 = _mm256_unpacklo_pd(M.r[0], M.r[1]); // 00 10 02 12
+		const __m256d vTemp2 = _mm256_unpackhi_pd(M.r[0], M.r[1]); // 01 11 03 13
+		const __m256d vTemp3 = _mm256_unpacklo_pd(M.r[2], M.r[3]); // 20 30 22 32
+		const __m256d vTemp4 = _mm256_unpackhi_pd(M.r[2], M.r[3]); // 21 31 23 33
+		Matrix4d mResult;
+		mResult.r[0] = _mm256_permute2f128_pd(vTemp1, vTemp3, 0x20);
+		mResult.r[1] = _mm256_permute2f128_pd(vTemp2, vTemp4, 0x20);
+		mResult.r[2] = _mm256_permute2f128_pd(vTemp1, vTemp3, 0x31);
+		mResult.r[3] = _mm256_permute2f128_pd(vTemp2, vTemp4, 0x31);
+		return mResult;
+	}
+
+	// cofactors from the 2x2 determinants of the top and bottom two rows
+	inline static Matrix4d VECTORCALL Inverse(const Matrix4d& M) noexcept
+	{
+		const double(*a)[4] = M.m;
+		const double s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+		const double s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+		const double s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+		const double s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+		const double s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+		const double s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+
+		const double c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+		const double c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+		const double c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+		const double c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+		const double c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+		const double c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+
+		const double invDet = 1.0 / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+		Matrix4d mResult;
+		mResult.r[0] = _mm256_mul_pd(_mm256_setr_pd(
+			 a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3,
+			-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3,
+			 a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3,
+			-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3), _mm256_set1_pd(invDet));
+		mResult.r[1] = _mm256_mul_pd(_mm256_setr_pd(
+			-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1,
+			 a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1,
+			-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1,
+			 a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1), _mm256_set1_pd(invDet));
+		mResult.r[2] = _mm256_mul_pd(_mm256_setr_pd(
+			 a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0,
+			-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0,
+			 a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0,
+			-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0), _mm256_set1_pd(invDet));
+		mResult.r[3] = _mm256_mul_pd(_mm256_setr_pd(
+			-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0,
+			 a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0,
+			-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0,
+			 a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0), _mm256_set1_pd(invDet));
+		return mResult;
+	}
+
+	inline static Matrix4d VECTORCALL Multiply(const Matrix4d& M1, const Matrix4d& M2)
+	{
+		Matrix4d mResult;
+		for (int row = 0; row < 4; ++row)
+		{
+			__m256d vX = _mm256_mul_pd(_mm256_set1_pd(M1.m[row][0]), M2.r[0]);
+			__m256d vY = _mm256_mul_pd(_mm256_set1_pd(M1.m[row][1]), M2.r[1]);
+			vX = _mm256_fmadd_pd(_mm256_set1_pd(M1.m[row][2]), M2.r[2], vX);
+			vY = _mm256_fmadd_pd(_mm256_set1_pd(M1.m[row][3]), M2.r[3], vY);
+			mResult.r[row] = _mm256_add_pd(vX, vY);
+		}
+		return mResult;
+	}
+
+	FINLINE static Vector3d VECTORCALL ExtractPosition(const Matrix4d& matrix) noexcept
+	{
+		return Vector3d(matrix.r[3]);
+	}
+
+	FINLINE static Vector4d VECTORCALL Vector3Transform(const Vector3d V, const Matrix4d& M) noexcept
+	{
+		__m256d vResult = _mm256_fmadd_pd(_mm256_set1_pd(V.x), M.r[0], M.r[3]);
+		vResult = _mm256_fmadd_pd(_mm256_set1_pd(V.y), M.r[1], vResult);
+		return _mm256_fmadd_pd(_mm256_set1_pd(V.z), M.r[2], vResult);
+	}
+
+	// same as Vector3Transform without the translation, for directions
+	FINLINE static Vector4d VECTORCALL Vector3TransformNormal(const Vector3d V, const Matrix4d& M) noexcept
+	{
+		__m256d vResult = _mm256_mul_pd(_mm256_set1_pd(V.x), M.r[0]);
+		vResult = _mm256_fmadd_pd(_mm256_set1_pd(V.y), M.r[1], vResult);
+		return _mm256_fmadd_pd(_mm256_set1_pd(V.z), M.r[2], vResult);
+	}
+
+	// rounded to float, translate close to the origin first to keep the precision
+	FINLINE static Matrix4 VECTORCALL ToMatrix4(const Matrix4d& M) noexcept
+	{
+		Matrix4 mResult;
+		for (int row = 0; row < 4; ++row) mResult.r[row] = _mm256_cvtpd_ps(M.r[row]);
+		return mResult;
+	}
 };
 
-AMATH_END_NAMESPACE
\ No newline at end of file
+AMATH_END_NAMESPACE
@@ -189,20 +189,20 @@ struct Vector3i
 	[[nodiscard]] FINLINE static Vector3i One() noexcept { return  Vector3i(1, 1, 1); }
 	[[nodiscard]] FINLINE static Vector3i Zero() noexcept { return  Vector3i(0, 0, 0); }
 
-	FINLINE Vector3i VECTORCALL operator - () const { return _mm_mul_epi32(vec, _mm_set1_epi32(-1)); }
+	FINLINE Vector3i VECTORCALL operator - () const { return _mm_sub_epi32(_mm_setzero_si128(), vec); }
 	FINLINE Vector3i VECTORCALL operator + (const Vector3i b) const { return _mm_add_epi32(vec, b.vec); }
 	FINLINE Vector3i VECTORCALL operator - (const Vector3i b) const { return _mm_sub_epi32(vec, b.vec); }
-	FINLINE Vector3i VECTORCALL operator * (const Vector3i b) const { return _mm_mul_epi32(vec, b.vec); }
+	FINLINE Vector3i VECTORCALL operator * (const Vector3i b) const { return _mm_mullo_epi32(vec, b.vec); }
 	FINLINE Vector3i VECTORCALL operator / (const Vector3i b) const { return _mm_div_epi32(vec, b.vec); }
 
 	FINLINE Vector3i VECTORCALL operator += (const Vector3i b) { vec = _mm_add_epi32(vec, b.vec); return *this; }
 	FINLINE Vector3i VECTORCALL operator -= (const Vector3i b) { vec = _mm_sub_epi32(vec, b.vec); return *this; }
-	FINLINE Vector3i VECTORCALL operator *= (const Vector3i b) { vec = _mm_mul_epi32(vec, b.vec); return *this; }
+	FINLINE Vector3i VECTORCALL operator *= (const Vector3i b) { vec = _mm_mullo_epi32(vec, b.vec); return *this; }
 	FINLINE Vector3i VECTORCALL operator /= (const Vector3i b) { vec = _mm_div_epi32(vec, b.vec); return *this; }
 
-	FINLINE Vector3i operator *	 (const int b) const { return _mm_mul_epi32(vec, _mm_set1_epi32(b)); }
+	FINLINE Vector3i operator *	 (const int b) const { return _mm_mullo_epi32(vec, _mm_set1_epi32(b)); }
 	FINLINE Vector3i operator /	 (const int b) const { return _mm_div_epi32(vec, _mm_set1_epi32(b)); }
-	FINLINE Vector3i operator *= (const int b) noexcept { vec = _mm_mul_epi32(vec, _mm_set1_epi32(b)); return *this; }
+	FINLINE Vector3i operator *= (const int b) noexcept { vec = _mm_mullo_epi32(vec, _mm_set1_epi32(b)); return *this; }
 	FINLINE Vector3i operator /= (const int b) noexcept { vec = _mm_div_epi32(vec, _mm_set1_epi32(b)); return *this; }
 };
 
@@ -211,11 +211,12 @@ struct Vector3i
 [[nodiscard]] FINLINE Vector3i VECTORCALL ToVec3i(const Vector3 vec3f)  noexcept { return _mm_cvtps_epi32(vec3f.vec()); }
 [[nodiscard]] FINLINE Vector3i VECTORCALL ToVec3i(const Vector3d vec3d) noexcept { return _mm256_cvtpd_epi32(vec3d.vec); }
 
-[[nodiscard]] FINLINE Vector3 VECTORCALL ToVec3f(const Vector3d vec3d) noexcept { return _mm256_cvtpd_ps(vec3d.vec); }
+// Vector3 is 12 bytes, the float <-> double conversions go component wise so neither side is read or written as 16 bytes
+[[nodiscard]] FINLINE Vector3 VECTORCALL ToVec3f(const Vector3d vec3d) noexcept { return Vector3(float(vec3d.x), float(vec3d.y), float(vec3d.z)); }
 [[nodiscard]] FINLINE Vector3 VECTORCALL ToVec3f(const Vector3i vec3i) noexcept { return _mm_cvtepi32_ps(vec3i.vec); }
 
 [[nodiscard]] FINLINE Vector3d VECTORCALL ToVec3d(const Vector3i vec3i) noexcept { return _mm256_cvtepi32_pd(vec3i.vec); }
-[[nodiscard]] FINLINE Vector3d VECTORCALL ToVec3d(const Vector3 vec3d)  noexcept { return _mm256_cvtps_pd	(vec3d.vec()); }
+[[nodiscard]] FINLINE Vector3d VECTORCALL ToVec3d(const Vector3 vec3f)  noexcept { return Vector3d(vec3f.x, vec3f.y, vec3f.z); }
 
 // --- Angle ---
 
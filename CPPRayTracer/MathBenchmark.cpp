@@ -0,0 +1,504 @@
+#include "MathBenchmark.hpp"
+#include "Math/Matrix4.hpp"
+#include "Math/Matrix4d.hpp"
+#include "Math/Quaternion.hpp"
+#include "Math/Vector3.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+AMATH_NAMESPACE
+
+static constexpr int Count = 1024;	// inputs per operation, the matrices of one operation stay in L2
+static constexpr int Repeats = 16;	// the fastest repeat is reported, the others paid for page faults and interrupts
+
+// results go here so the loops that produce them are not removed
+static volatile uint32_t Sink;
+
+template<typename T>
+static void Consume(const T& value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    Sink = Sink + bits;
+}
+
+// rdtsc ticks per call of op(i) for i in [0, Count)
+template<typename Op>
+static double Ticks(Op&& op)
+{
+    double best = DBL_MAX;
+    for (int repeat = 0; repeat < Repeats; ++repeat)
+    {
+        const uint64_t start = __rdtsc();
+        for (int i = 0; i < Count; ++i) op(i);
+        best = std::min(best, double(__rdtsc() - start) / Count);
+    }
+    return best;
+}
+
+// largest error of values against reference in ulps of the largest reference component, nan counts as infinite
+static double UlpError(const float* values, const double* reference, int count)
+{
+    double largest = 0.0;
+    for (int i = 0; i < count; ++i) largest = std::max(largest, fabs(reference[i]));
+    const float magnitude = float(largest);
+    const double ulp = magnitude > 0.0f ? double(nextafterf(magnitude, INFINITY) - magnitude) : double(FLT_MIN);
+
+    double error = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (std::isnan(values[i])) return INFINITY;
+        error = std::max(error, fabs(values[i] - reference[i]) / ulp);
+    }
+    return error;
+}
+
+// negative columns have nothing to compare against
+static void Report(const char* name, double throughput, double latency, double scalar, double ulps)
+{
+    auto column = [](double value, const char* format)
+    {
+        if (value < 0.0) printf("%10s", "-");
+        else if (value >= 1e6) printf("%10.3g", value); // a broken function still lines up
+        else printf(format, value);
+    };
+    printf("  %-26s", name);
+    column(throughput, "%10.1f");
+    column(latency, "%10.1f");
+    column(scalar, "%10.1f");
+    column(ulps, "%10.1f");
+    printf("\n");
+}
+
+// reference math, T = float for the scalar timings and double for the accuracy checks
+
+template<typename T>
+static void MultiplyReference(const float a[4][4], const float b[4][4], T result[4][4])
+{
+    for (int row = 0; row < 4; ++row)
+        for (int column = 0; column < 4; ++column)
+        {
+            T sum = 0;
+            for (int k = 0; k < 4; ++k) sum += T(a[row][k]) * T(b[k][column]);
+            result[row][column] = sum;
+        }
+}
+
+// gauss jordan with partial pivoting
+template<typename T>
+static void InverseReference(const float m[4][4], T result[4][4])
+{
+    T work[4][8];
+    for (int row = 0; row < 4; ++row)
+        for (int column = 0; column < 4; ++column)
+        {
+            work[row][column] = T(m[row][column]);
+            work[row][column + 4] = row == column ? T(1) : T(0);
+        }
+
+    for (int column = 0; column < 4; ++column)
+    {
+        int pivot = column;
+        for (int row = column + 1; row < 4; ++row) if (std::abs(work[row][column]) > std::abs(work[pivot][column])) pivot = row;
+        if (pivot != column) for (int k = 0; k < 8; ++k) std::swap(work[pivot][k], work[column][k]);
+
+        const T scale = T(1) / work[column][column];
+        for (int k = 0; k < 8; ++k) work[column][k] *= scale;
+        for (int row = 0; row < 4; ++row)
+        {
+            if (row == column) continue;
+            const T factor = work[row][column];
+            for (int k = 0; k < 8; ++k) work[row][k] -= factor * work[column][k];
+        }
+    }
+    for (int row = 0; row < 4; ++row)
+        for (int column = 0; column < 4; ++column) result[row][column] = work[row][column + 4];
+}
+
+// xyzw, the same order as Quaternion::Mul: the rotation of a followed by the rotation of b, b * a in hamilton terms
+template<typename T>
+static void QuaternionMulReference(const float a[4], const float b[4], T result[4])
+{
+    const T ax = a[0], ay = a[1], az = a[2], aw = a[3];
+    const T bx = b[0], by = b[1], bz = b[2], bw = b[3];
+    result[0] = bw * ax + bx * aw + by * az - bz * ay;
+    result[1] = bw * ay - bx * az + by * aw + bz * ax;
+    result[2] = bw * az + bx * ay - by * ax + bz * aw;
+    result[3] = bw * aw - bx * ax - by * ay - bz * az;
+}
+
+// shortest path, falls back to a lerp for nearly equal rotations like Quaternion::Slerp
+template<typename T>
+static void SlerpReference(const float a[4], const float b[4], float t, T result[4])
+{
+    T cosOmega = 0;
+    for (int k = 0; k < 4; ++k) cosOmega += T(a[k]) * T(b[k]);
+    const T sign = cosOmega < 0 ? T(-1) : T(1);
+    cosOmega *= sign;
+
+    T s0 = T(1) - T(t), s1 = T(t);
+    if (cosOmega < T(1.0 - 0.00001))
+    {
+        const T sinOmega = std::sqrt(T(1) - cosOmega * cosOmega);
+        const T omega = std::atan2(sinOmega, cosOmega);
+        s0 = std::sin((T(1) - T(t)) * omega) / sinOmega;
+        s1 = std::sin(T(t) * omega) / sinOmega;
+    }
+    for (int k = 0; k < 4; ++k) result[k] = T(a[k]) * s0 + T(b[k]) * s1 * sign;
+}
+
+template<typename T>
+static void NormalizeReference(const float v[3], T result[3])
+{
+    const T length = std::sqrt(T(v[0]) * T(v[0]) + T(v[1]) * T(v[1]) + T(v[2]) * T(v[2]));
+    for (int k = 0; k < 3; ++k) result[k] = T(v[k]) / length;
+}
+
+struct BenchmarkInputs
+{
+	std::vector<Matrix4> transforms;	// rotation, scale and translation, well conditioned for the inverse
+	std::vector<Matrix4> rotations;		// keep a chain of multiplies from growing or shrinking
+	std::vector<Quaternion> quaternions;
+	std::vector<float> fractions;
+	std::vector<float> angles;
+	std::vector<Vector3> vectors;
+	std::vector<Vector3d> doubleVectors;
+	std::vector<Vector3i> integerVectors;
+};
+
+static BenchmarkInputs MakeInputs()
+{
+    std::mt19937 generator(2024);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> positive(0.5f, 2.0f);
+
+    BenchmarkInputs inputs;
+    for (int i = 0; i < Count; ++i)
+    {
+        Quaternion q(unit(generator), unit(generator), unit(generator), unit(generator));
+        const float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        q = Quaternion(q.x / length, q.y / length, q.z / length, q.w / length);
+        inputs.quaternions.push_back(q);
+        inputs.rotations.push_back(Matrix4::FromQuaternion(q));
+        inputs.transforms.push_back(Matrix4::CreateScale(positive(generator), positive(generator), positive(generator)) *
+                                    Matrix4::FromQuaternion(q) * Matrix4::FromPosition(unit(generator) * 10.0f, unit(generator) * 10.0f, unit(generator) * 10.0f));
+        inputs.fractions.push_back(unit(generator) * 0.5f + 0.5f);
+        inputs.angles.push_back(unit(generator) * 4.0f * PI);
+        inputs.vectors.push_back(Vector3(unit(generator), unit(generator), unit(generator)) * 10.0f);
+        inputs.doubleVectors.push_back(Vector3d(unit(generator), unit(generator), unit(generator)) * 10.0);
+        inputs.integerVectors.push_back(Vector3i(int(unit(generator) * 1000.0f), int(unit(generator) * 1000.0f), int(unit(generator) * 1000.0f)));
+    }
+    return inputs;
+}
+
+static void BenchmarkMatrices(const BenchmarkInputs& inputs)
+{
+    const std::vector<Matrix4>& a = inputs.transforms;
+    const std::vector<Matrix4>& rotations = inputs.rotations;
+    std::vector<Matrix4> results(Count);
+
+    {
+        const double throughput = Ticks([&](int i) { results[i] = Matrix4::Multiply(a[i], rotations[(i + 1) % Count]); });
+        Consume(results[Count - 1]);
+        Matrix4 chain = a[0];
+        const double latency = Ticks([&](int i) { chain = Matrix4::Multiply(chain, rotations[i]); });
+        Consume(chain);
+        std::vector<float> scalarResults(Count * 16);
+        const double scalar = Ticks([&](int i) { MultiplyReference(a[i].m, rotations[(i + 1) % Count].m, reinterpret_cast<float(*)[4]>(&scalarResults[i * 16])); });
+        Consume(scalarResults[Count * 16 - 1]);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            double reference[4][4];
+            MultiplyReference(a[i].m, rotations[(i + 1) % Count].m, reference);
+            ulps = std::max(ulps, UlpError(&results[i].m[0][0], &reference[0][0], 16));
+        }
+        Report("Matrix4::Multiply", throughput, latency, scalar, ulps);
+    }
+    {
+        const double throughput = Ticks([&](int i) { results[i] = Matrix4::Inverse(a[i]); });
+        Consume(results[Count - 1]);
+        // inverting the inverse leads back, the chain stays well conditioned
+        Matrix4 chain = a[0];
+        const double latency = Ticks([&](int) { chain = Matrix4::Inverse(chain); });
+        Consume(chain);
+        std::vector<float> scalarResults(Count * 16);
+        const double scalar = Ticks([&](int i) { InverseReference(a[i].m, reinterpret_cast<float(*)[4]>(&scalarResults[i * 16])); });
+        Consume(scalarResults[Count * 16 - 1]);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            double reference[4][4];
+            InverseReference(a[i].m, reference);
+            ulps = std::max(ulps, UlpError(&results[i].m[0][0], &reference[0][0], 16));
+        }
+        Report("Matrix4::Inverse", throughput, latency, scalar, ulps);
+    }
+
+    // the double versions are held to the float ulps of the same reference, what they gain over Matrix4 shows as ~0
+    std::vector<Matrix4d> doubleA, doubleRotations;
+    for (int i = 0; i < Count; ++i) { doubleA.emplace_back(a[i]); doubleRotations.emplace_back(rotations[i]); }
+    std::vector<Matrix4d> doubleResults(Count);
+    auto doubleUlps = [&](auto&& reference)
+    {
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            double expected[4][4];
+            float rounded[16];
+            reference(i, expected);
+            for (int k = 0; k < 16; ++k) rounded[k] = float(doubleResults[i].m[k / 4][k % 4]);
+            ulps = std::max(ulps, UlpError(rounded, &expected[0][0], 16));
+        }
+        return ulps;
+    };
+    {
+        const double throughput = Ticks([&](int i) { doubleResults[i] = Matrix4d::Multiply(doubleA[i], doubleRotations[(i + 1) % Count]); });
+        Consume(doubleResults[Count - 1]);
+        Matrix4d chain = doubleA[0];
+        const double latency = Ticks([&](int i) { chain = Matrix4d::Multiply(chain, doubleRotations[i]); });
+        Consume(chain);
+        const double ulps = doubleUlps([&](int i, double (*expected)[4]) { MultiplyReference(a[i].m, rotations[(i + 1) % Count].m, expected); });
+        Report("Matrix4d::Multiply", throughput, latency, -1.0, ulps);
+    }
+    {
+        const double throughput = Ticks([&](int i) { doubleResults[i] = Matrix4d::Inverse(doubleA[i]); });
+        Consume(doubleResults[Count - 1]);
+        Matrix4d chain = doubleA[0];
+        const double latency = Ticks([&](int) { chain = Matrix4d::Inverse(chain); });
+        Consume(chain);
+        const double ulps = doubleUlps([&](int i, double (*expected)[4]) { InverseReference(a[i].m, expected); });
+        Report("Matrix4d::Inverse", throughput, latency, -1.0, ulps);
+    }
+    {
+        // the conversion large world scenes pay per instance when they are moved next to the camera
+        std::vector<Matrix4> converted(Count);
+        const double throughput = Ticks([&](int i) { converted[i] = Matrix4d::ToMatrix4(Matrix4d::Multiply(doubleA[i], Matrix4d::FromPosition(-1e4, 0.0, 2e4))); });
+        Consume(converted[Count - 1]);
+        Report("Matrix4d rebase + ToMatrix4", throughput, -1.0, -1.0, -1.0);
+    }
+}
+
+static void BenchmarkQuaternions(const BenchmarkInputs& inputs)
+{
+    const std::vector<Quaternion>& q = inputs.quaternions;
+    std::vector<Quaternion> results(Count);
+    std::vector<float> scalarResults(Count * 4);
+
+    {
+        const double throughput = Ticks([&](int i) { results[i] = Quaternion::Mul(q[i].vec, q[(i + 1) % Count].vec); });
+        Consume(results[Count - 1]);
+        Quaternion chain = q[0];
+        const double latency = Ticks([&](int i) { chain = Quaternion::Mul(chain.vec, q[i].vec); });
+        Consume(chain);
+        const double scalar = Ticks([&](int i) { QuaternionMulReference(q[i].arr, q[(i + 1) % Count].arr, &scalarResults[i * 4]); });
+        Consume(scalarResults[Count * 4 - 1]);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            double reference[4];
+            QuaternionMulReference(q[i].arr, q[(i + 1) % Count].arr, reference);
+            ulps = std::max(ulps, UlpError(results[i].arr, reference, 4));
+        }
+        Report("Quaternion::Mul", throughput, latency, scalar, ulps);
+    }
+    {
+        const std::vector<float>& t = inputs.fractions;
+        Quaternion slerp; // Slerp is a non const member that ignores this
+        const double throughput = Ticks([&](int i) { results[i] = slerp.Slerp(q[i], q[(i + 1) % Count], t[i]); });
+        Consume(results[Count - 1]);
+        Quaternion chain = q[0];
+        const double latency = Ticks([&](int i) { chain = slerp.Slerp(chain, q[i], t[i]); });
+        Consume(chain);
+        const double scalar = Ticks([&](int i) { SlerpReference(q[i].arr, q[(i + 1) % Count].arr, t[i], &scalarResults[i * 4]); });
+        Consume(scalarResults[Count * 4 - 1]);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            double reference[4];
+            SlerpReference(q[i].arr, q[(i + 1) % Count].arr, t[i], reference);
+            ulps = std::max(ulps, UlpError(results[i].arr, reference, 4));
+        }
+        Report("Quaternion::Slerp", throughput, latency, scalar, ulps);
+    }
+}
+
+static void BenchmarkScalars(const BenchmarkInputs& inputs)
+{
+    const std::vector<float>& angles = inputs.angles;
+    std::vector<float> sines(Count), cosines(Count);
+
+    const double throughput = Ticks([&](int i) { ScalarSinCos(&sines[i], &cosines[i], angles[i]); });
+    Consume(sines[Count - 1] + cosines[Count - 1]);
+    float chain = angles[0];
+    const double latency = Ticks([&](int) { float s, c; ScalarSinCos(&s, &c, chain); chain = s + c; });
+    Consume(chain);
+    std::vector<float> scalarSines(Count), scalarCosines(Count);
+    const double scalar = Ticks([&](int i) { scalarSines[i] = sinf(angles[i]); scalarCosines[i] = cosf(angles[i]); });
+    Consume(scalarSines[Count - 1] + scalarCosines[Count - 1]);
+
+    double ulps = 0.0;
+    for (int i = 0; i < Count; ++i)
+    {
+        const float values[2] = { sines[i], cosines[i] };
+        const double reference[2] = { sin(double(angles[i])), cos(double(angles[i])) };
+        ulps = std::max(ulps, UlpError(values, reference, 2));
+    }
+    Report("ScalarSinCos (vs sinf/cosf)", throughput, latency, scalar, ulps);
+}
+
+static void BenchmarkVectors(const BenchmarkInputs& inputs)
+{
+    const std::vector<Vector3>& v = inputs.vectors;
+    std::vector<Vector3> results(Count);
+
+    {
+        // Vector4 rather than __m128, the vector would drop the type's alignment attribute
+        std::vector<Vector4> simdResults(Count);
+        const double throughput = Ticks([&](int i) { simdResults[i] = SSEVector3Normalize(_mm_setr_ps(v[i].x, v[i].y, v[i].z, 0.0f)); });
+        Consume(simdResults[Count - 1]);
+        __m128 chain = _mm_setr_ps(v[0].x, v[0].y, v[0].z, 0.0f);
+        const double latency = Ticks([&](int) { chain = SSEVector3Normalize(chain); });
+        Consume(chain);
+        const double scalar = Ticks([&](int i) { NormalizeReference(v[i].arr, results[i].arr); });
+        Consume(results[Count - 1]);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            float values[4];
+            _mm_storeu_ps(values, simdResults[i].vec);
+            double reference[3];
+            NormalizeReference(v[i].arr, reference);
+            ulps = std::max(ulps, UlpError(values, reference, 3));
+        }
+        Report("SSEVector3Normalize", throughput, latency, scalar, ulps);
+    }
+
+    // Vector3 is the scalar code itself, there is no separate baseline
+    auto vectorOperation = [&](const char* name, auto&& operation, auto&& reference)
+    {
+        const double throughput = Ticks([&](int i) { results[i] = operation(v[i], v[(i + 1) % Count]); });
+        Consume(results[Count - 1]);
+        Vector3 chain = v[0];
+        const double latency = Ticks([&](int i) { chain = operation(chain, v[i]); });
+        Consume(chain);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            double expected[3];
+            reference(v[i], v[(i + 1) % Count], expected);
+            ulps = std::max(ulps, UlpError(results[i].arr, expected, 3));
+        }
+        Report(name, throughput, latency, -1.0, ulps);
+    };
+    vectorOperation("Vector3 +", [](Vector3 a, Vector3 b) { return a + b; },
+                    [](const Vector3& a, const Vector3& b, double* r) { for (int k = 0; k < 3; ++k) r[k] = double(a.arr[k]) + b.arr[k]; });
+    vectorOperation("Vector3 *", [](Vector3 a, Vector3 b) { return a * (b * 0.1f); },
+                    [](const Vector3& a, const Vector3& b, double* r) { for (int k = 0; k < 3; ++k) r[k] = double(a.arr[k]) * double(b.arr[k] * 0.1f); });
+    vectorOperation("Vector3::Cross", [](Vector3 a, Vector3 b) { return Vector3::Cross(a, b) * 0.01f; },
+                    [](const Vector3& a, const Vector3& b, double* r)
+                    {
+                        r[0] = (double(a.y) * b.z - double(a.z) * b.y) * 0.01f;
+                        r[1] = (double(a.z) * b.x - double(a.x) * b.z) * 0.01f;
+                        r[2] = (double(a.x) * b.y - double(a.y) * b.x) * 0.01f;
+                    });
+    vectorOperation("Vector3::Normalize", [](Vector3 a, Vector3 b) { return Vector3::Normalize(a + b); },
+                    [](const Vector3& a, const Vector3& b, double* r) { const Vector3 sum = a + b; NormalizeReference(sum.arr, r); });
+    {
+        std::vector<float> dots(Count);
+        const double throughput = Ticks([&](int i) { dots[i] = Vector3::Dot(v[i], v[(i + 1) % Count]); });
+        Consume(dots[Count - 1]);
+        float chain = 1.0f;
+        const double latency = Ticks([&](int i) { chain = Vector3::Dot(v[i] * chain, v[i]) * 0.01f; });
+        Consume(chain);
+
+        double ulps = 0.0;
+        for (int i = 0; i < Count; ++i)
+        {
+            const Vector3& a = v[i];
+            const Vector3& b = v[(i + 1) % Count];
+            // the three products are the largest components of a dot product, cancellation is measured against them
+            const double terms[4] = { double(a.x) * b.x, double(a.y) * b.y, double(a.z) * b.z, double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z };
+            const float values[4] = { float(terms[0]), float(terms[1]), float(terms[2]), dots[i] };
+            ulps = std::max(ulps, UlpError(values, terms, 4));
+        }
+        Report("Vector3::Dot", throughput, latency, -1.0, ulps);
+    }
+
+    // double vectors are timed only, there is no wider type to check them against everywhere
+    const std::vector<Vector3d>& d = inputs.doubleVectors;
+    std::vector<Vector3d> doubleResults(Count);
+    auto doubleOperation = [&](const char* name, auto&& operation)
+    {
+        const double throughput = Ticks([&](int i) { doubleResults[i] = operation(d[i], d[(i + 1) % Count]); });
+        Consume(doubleResults[Count - 1]);
+        Vector3d chain = d[0];
+        const double latency = Ticks([&](int i) { chain = operation(chain, d[i]); });
+        Consume(chain);
+        Report(name, throughput, latency, -1.0, -1.0);
+    };
+    doubleOperation("Vector3d +", [](Vector3d a, Vector3d b) { return a + b; });
+    doubleOperation("Vector3d *", [](Vector3d a, Vector3d b) { return a * (b * 0.1); });
+    doubleOperation("Vector3d::Cross", [](Vector3d a, Vector3d b) { return Vector3d::Cross(a, b) * 0.01; });
+    doubleOperation("Vector3d::Normalize", [](Vector3d a, Vector3d b) { return Vector3d::Normalize(a + b); });
+
+    // integer results have to be exact, the error column is the largest difference
+    const std::vector<Vector3i>& n = inputs.integerVectors;
+    std::vector<Vector3i> integerResults(Count);
+    auto integerOperation = [&](const char* name, auto&& operation, auto&& reference)
+    {
+        const double throughput = Ticks([&](int i) { integerResults[i] = operation(n[i], n[(i + 1) % Count]); });
+        Consume(integerResults[Count - 1]);
+        Vector3i chain = n[0];
+        const double latency = Ticks([&](int i) { chain = operation(chain, n[i]); });
+        Consume(chain);
+
+        int64_t error = 0;
+        for (int i = 0; i < Count; ++i)
+            for (int k = 0; k < 3; ++k)
+            {
+                const int64_t expected = reference(int64_t(n[i].arr[k]), int64_t(n[(i + 1) % Count].arr[k]));
+                error = std::max(error, std::abs(int64_t(integerResults[i].arr[k]) - expected));
+            }
+        Report(name, throughput, latency, -1.0, double(error));
+    };
+    integerOperation("Vector3i +", [](Vector3i a, Vector3i b) { return a + b; }, [](int64_t a, int64_t b) { return a + b; });
+    integerOperation("Vector3i -", [](Vector3i a, Vector3i b) { return -(a - b); }, [](int64_t a, int64_t b) { return b - a; });
+    integerOperation("Vector3i *", [](Vector3i a, Vector3i b) { return a * b; }, [](int64_t a, int64_t b) { return a * b; });
+}
+
+void MathBenchmark::Run()
+{
+    // rdtsc counts at a fixed reference rate, not the core clock, this says how it relates to time
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t startTicks = __rdtsc();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50)) {}
+    const double ticksPerNanosecond = double(__rdtsc() - startTicks) /
+                                      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    const BenchmarkInputs inputs = MakeInputs();
+    printf("math benchmark: %d inputs, best of %d runs, rdtsc ticks per call at %.2f GHz, max error in ulps\n", Count, Repeats, ticksPerNanosecond);
+    printf("  %-26s%10s%10s%10s%10s\n", "operation", "through", "latency", "scalar", "ulps");
+    BenchmarkMatrices(inputs);
+    BenchmarkQuaternions(inputs);
+    BenchmarkScalars(inputs);
+    BenchmarkVectors(inputs);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,18 @@
+#pragma once
+#include "Math/Math.hpp"
+
+AMATH_NAMESPACE
+
+// times the hot math primitives one by one and checks them against a double precision scalar reference.
+// every operation is measured three ways, in rdtsc ticks per call:
+//   throughput - independent calls over an array, what a loop over many rays or objects sees
+//   latency    - every call takes the previous result, what a dependent chain sees
+//   scalar     - throughput of a plain float implementation of the same math, the baseline the simd code has to beat
+// accuracy is the largest error over random inputs in ulps of the largest component of the reference result,
+// components that cancel to nearly zero would otherwise make any rounding look like a huge ulp error
+namespace MathBenchmark
+{
+	void Run();
+}
+
+AMATH_END_NAMESPACE
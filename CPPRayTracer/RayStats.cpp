@@ -0,0 +1,77 @@
+#include "RayStats.hpp"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// the blocks belong to the registry, not the threads, so counts of a thread that has exited are still collected
+static std::mutex RegistryMutex;
+static std::vector<std::unique_ptr<RayStats::Counters>> Registry;
+
+RayStats::Counters* RayStats::Register()
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+    Registry.push_back(std::make_unique<Counters>());
+    ThreadBlock = Registry.back().get();
+    return ThreadBlock;
+}
+
+RayStats::Counters RayStats::Collect()
+{
+    Counters total;
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+    for (auto& counters : Registry)
+    {
+        for (size_t i = 0; i < size_t(RayCounter::Count); ++i) total.values[i] += counters->values[i];
+        *counters = Counters();
+    }
+    return total;
+}
+
+static double Mrays(uint64_t rays, double seconds)
+{
+    return seconds > 0.0 ? rays / seconds * 1e-6 : 0.0;
+}
+
+void RayStats::Log(const Counters& counters, double seconds)
+{
+    const uint64_t rays = counters.Rays();
+    printf("ray stats: %.2f Mrays/s (primary %.2f, secondary %.2f, shadow %.2f), %.1f nodes and %.1f primitives per ray, %llu early outs\n",
+           Mrays(rays, seconds), Mrays(counters[RayCounter::PrimaryRays], seconds), Mrays(counters[RayCounter::SecondaryRays], seconds),
+           Mrays(counters[RayCounter::ShadowRays], seconds),
+           rays ? double(counters[RayCounter::NodeVisits]) / rays : 0.0, rays ? double(counters[RayCounter::PrimitiveTests]) / rays : 0.0,
+           (unsigned long long)counters[RayCounter::EarlyOuts]);
+}
+
+bool RayStats::WriteJson(const char* path, const Counters& counters, double seconds, int width, int height, int samples, int threads)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        printf("ray stats: could not write %s\n", path);
+        return false;
+    }
+
+    auto category = [&](const char* name, uint64_t rays, bool last)
+    {
+        fprintf(file, "    \"%s\": { \"count\": %llu, \"mrays_per_second\": %.3f }%s\n", name, (unsigned long long)rays, Mrays(rays, seconds), last ? "" : ",");
+    };
+    const uint64_t rays = counters.Rays();
+    fprintf(file, "{\n");
+    fprintf(file, "  \"width\": %d, \"height\": %d, \"samples\": %d, \"threads\": %d,\n", width, height, samples, threads);
+    fprintf(file, "  \"trace_seconds\": %.6f,\n", seconds);
+    fprintf(file, "  \"rays\": {\n");
+    category("primary", counters[RayCounter::PrimaryRays], false);
+    category("secondary", counters[RayCounter::SecondaryRays], false);
+    category("shadow", counters[RayCounter::ShadowRays], false);
+    category("total", rays, true);
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"hits\": %llu,\n", (unsigned long long)counters[RayCounter::Hits]);
+    fprintf(file, "  \"node_visits\": %llu,\n", (unsigned long long)counters[RayCounter::NodeVisits]);
+    fprintf(file, "  \"primitive_tests\": %llu,\n", (unsigned long long)counters[RayCounter::PrimitiveTests]);
+    fprintf(file, "  \"early_outs\": %llu,\n", (unsigned long long)counters[RayCounter::EarlyOuts]);
+    fprintf(file, "  \"node_visits_per_ray\": %.3f,\n", rays ? double(counters[RayCounter::NodeVisits]) / rays : 0.0);
+    fprintf(file, "  \"primitive_tests_per_ray\": %.3f\n", rays ? double(counters[RayCounter::PrimitiveTests]) / rays : 0.0);
+    fprintf(file, "}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 0 compiles every counter out, the traversal and intersection code is then exactly what it was without them
+#ifndef RAY_STATISTICS
+#define RAY_STATISTICS 1
+#endif
+
+enum class RayCounter : uint32_t
+{
+	PrimaryRays,	// camera rays, including the first hit feature rays
+	SecondaryRays,	// diffuse bounces
+	ShadowRays,		// towards lights and the environment
+	Hits,
+	NodeVisits,		// bvh node bounds tested
+	PrimitiveTests,
+	EarlyOuts,		// bvh subtrees skipped because a closer hit was found after they were pushed
+	Count
+};
+
+// per thread ray counters. every thread adds to its own cache line sized block without atomics,
+// Collect sums them once the frame is done and the workers are idle
+namespace RayStats
+{
+	constexpr bool Enabled = RAY_STATISTICS != 0;
+
+	struct alignas(64) Counters
+	{
+		uint64_t values[size_t(RayCounter::Count)] = {};
+
+		uint64_t& operator[](RayCounter counter) { return values[size_t(counter)]; }
+		uint64_t operator[](RayCounter counter) const { return values[size_t(counter)]; }
+		uint64_t Rays() const { return values[0] + values[1] + values[2]; }
+	};
+
+	// constant initialized so reading it is a plain thread local access without an init check call
+	inline thread_local Counters* ThreadBlock = nullptr;
+	Counters* Register();
+
+	// the calling thread's block, registered on first use
+	inline Counters& ThreadCounters()
+	{
+		Counters* counters = ThreadBlock;
+		if (counters == nullptr) counters = Register();
+		return *counters;
+	}
+
+	inline void Add(RayCounter counter, uint64_t count = 1)
+	{
+		if constexpr (Enabled) ThreadCounters()[counter] += count;
+	}
+
+	// sum over every thread, the blocks are zeroed for the next frame
+	Counters Collect();
+
+	// one line per frame with the ray throughput of each category
+	void Log(const Counters& counters, double seconds);
+	// the same as json, rates are in millions of rays per second of tracing
+	bool WriteJson(const char* path, const Counters& counters, double seconds, int width, int height, int samples, int threads);
+}
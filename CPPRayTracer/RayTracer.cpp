@@ -7,24 +7,90 @@
 #include "Math/Color.hpp"
 #include "Math/Vector3.hpp"
 #include "Structures.hpp"
+#include "LightBVH.hpp"
+#include "EnvironmentMap.hpp"
+#include "Texture.hpp"
+#include "Intersection.hpp"
+#include "Denoiser.hpp"
+#include "Tonemap.hpp"
+#include "ThreadPool.hpp"
+#include "ImageWriter.hpp"
+#include "Checkpoint.hpp"
+#include "SceneFile.hpp"
+#include "BVHCache.hpp"
+#include "JsonScene.hpp"
+#include "SceneCorpus.hpp"
+#include "FloatImage.hpp"
+#include "Arena.hpp"
+#include "RayStats.hpp"
+#include "Trace.hpp"
+#include "Math/Matrix4.hpp"
+#include "Math/Quaternion.hpp"
 #include <memory>
 #include <vector>
 #include <random>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define MaxDepth 500
 
 using namespace mat;
 
+// the one random engine of the renderer, its state is part of render checkpoints
+static std::mt19937 Sampler;
+
+// deterministic mode draws from a pcg32 stream seeded by the pixel and sample instead, so the numbers a sample
+// gets do not depend on which thread takes its tile or what ran before it there
+struct SampleStream
+{
+    uint64_t state;
+
+    void Seed(uint64_t pixel, uint64_t sample)
+    {
+        // splitmix64 finalizer, neighbouring pixels and samples start far apart
+        uint64_t z = pixel * 0x9E3779B97F4A7C15ull + sample * 0xD1B54A32D192ED03ull + 0x2545F4914F6CDD1Dull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        state = z ^ (z >> 31);
+    }
+
+    float Next()
+    {
+        const uint64_t old = state;
+        state = old * 6364136223846793005ull + 1442695040888963407ull;
+        const uint32_t shifted = uint32_t(((old >> 18) ^ old) >> 27);
+        const uint32_t rotation = uint32_t(old >> 59);
+        const uint32_t bits = (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+        return (bits >> 8) * (1.0f / 16777216.0f);
+    }
+};
+static bool DeterministicSampling = false;
+static thread_local SampleStream PixelStream;
+
 inline double RandomFloat() {
+    if (DeterministicSampling) return PixelStream.Next();
     static std::uniform_real_distribution<float> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
+    return distribution(Sampler);
 }
 
 inline double RandomFloat(float min, float max) {
     return  min + (max - min) * RandomFloat();
 }
 
+// scenes are built from the shared sampler in either mode so both render the same scene
+inline float SceneRandom(float min, float max) {
+    static std::uniform_real_distribution<float> distribution(0.0, 1.0);
+    return min + (max - min) * distribution(Sampler);
+}
+
 inline static Vector3 RandomVec3()
 {
     return Vector3(RandomFloat(), RandomFloat(), RandomFloat());
@@ -43,29 +109,189 @@ static inline Vector3 random_in_unit_sphere() {
     }
 }
 
+static inline Vector3 RandomUnitVector() {
+    return Vector3::Normalize(random_in_unit_sphere());
+}
+
+// cosine weighted direction around normal, pdf is cos / PI
+static inline Vector3 RandomCosineDirection(const Vector3& normal) {
+    Vector3 direction = normal + RandomUnitVector();
+    if (direction.LengthSquared() < 1e-8f) return normal;
+    return Vector3::Normalize(direction);
+}
+
+static inline float PowerHeuristic(float pdf, float otherPdf) {
+    return (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+}
+
+// samples a direction inside the cone that the sphere subtends, returns false if point is inside the sphere
+static bool SampleSphereLight(const Light& light, const Vector3& point, float u1, float u2, Vector3& direction, float& distance, float& pdf)
+{
+    const Vector3 toCenter = light.center - point;
+    const float distanceSq = toCenter.LengthSquared();
+    const float radiusSq = light.radius * light.radius;
+    if (distanceSq <= radiusSq) return false;
+
+    const float centerDistance = sqrtf(distanceSq);
+    const Vector3 w = toCenter / centerDistance;
+    const float sinThetaMaxSq = radiusSq / distanceSq;
+    const float cosThetaMax = sqrtf(Max(0.0f, 1.0f - sinThetaMaxSq));
+    // 1 - cosThetaMax without cancellation for far away lights
+    const float oneMinusCosThetaMax = sinThetaMaxSq / (1.0f + cosThetaMax);
+
+    const float cosTheta = 1.0f - u1 * oneMinusCosThetaMax;
+    const float sinTheta = sqrtf(Max(0.0f, 1.0f - cosTheta * cosTheta));
+    const float phi = TwoPI * u2;
+
+    const Vector3 helper = fabsf(w.x) > 0.9f ? Vector3::Up() : Vector3::Right();
+    const Vector3 tangent = Vector3::Normalize(Vector3::Cross(helper, w));
+    const Vector3 bitangent = Vector3::Cross(w, tangent);
+    direction = tangent * (sinTheta * cosf(phi)) + bitangent * (sinTheta * sinf(phi)) + w * cosTheta;
+
+    const float projection = centerDistance * cosTheta;
+    distance = projection - sqrtf(Max(0.0f, radiusSq - (distanceSq - projection * projection)));
+    pdf = 1.0f / (TwoPI * oneMinusCosThetaMax);
+    return true;
+}
+
+// rmse of two images of the same size with every channel mapped through x / (1 + x), the lights would dominate it otherwise
+static double MappedRmse(const std::vector<Color>& image, const std::vector<Color>& reference)
+{
+    double squaredError = 0.0;
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            const double a = image[i].arr[channel], b = reference[i].arr[channel];
+            const double difference = a / (1.0 + a) - b / (1.0 + b);
+            squaredError += difference * difference;
+        }
+    }
+    return sqrt(squaredError / (image.size() * 3));
+}
+
 namespace RayTracer
 {
+    constexpr float DiffuseAlbedo = 0.5f;
+    constexpr float ShadowEpsilon = 0.001f;
+
     std::vector<Sphere> Spheres;
+    std::vector<Cube> Cubes;
+    std::vector<Plane> Planes;
+    // SoA copies of the primitives above that rays are traced against, rebuilt by BuildPrimitivePacks
+    SpherePack SpherePrimitives;
+    CubePack CubePrimitives;
+    PlanePack PlanePrimitives;
+    std::vector<Light> Lights;
+    std::vector<std::string> TexturePaths; // index is the texture id
+    // keeps a loaded binary scene mapped, SpherePrimitives point into it
+    SceneFile MappedScene;
+    LightBVH LightTree;
+    EnvironmentMap Environment;
+    Camera SceneCamera;
+    Animation SceneAnimation;
+    float MotionShutter = 0.0f;
+    int MotionSegments = 1;
+    // large worlds are traced in float around an origin at their camera, primitives are placed relative to it in double
+    bool LargeWorld = false;
+    Vector3d WorldOrigin;
+    int ImageWidth = 400;
+    int ImageHeight = 225;
+    // angle between neighbouring primary rays, picks the mip level of textures
+    float PixelSpreadAngle = 0.0f;
+    int SamplesPerPixel = 8;
+    bool DenoiseOutput = true;
+    Denoiser FrameDenoiser;
+    Tonemapper FrameTonemapper;
+    // sample sums and denoiser features of the frame being rendered
+    RenderProgress Progress;
+    ImageWriter Output;
+    std::string OutputPath = "export.jpg";
+    int OutputQuality = 90;
+    std::string CheckpointPath;
+    float CheckpointInterval = 60.0f;
+    bool ResumeFromCheckpoint = false;
+    std::string StatisticsPath;
+    std::string TracePath;
+    bool HeatmapMode = false;
+    std::string HeatmapCountsPath;
+    // operator new calls of the last RenderFrame on any thread, up to handing the image to the writer
+    uint64_t LastFrameAllocations = 0;
+
+    // pixel rectangle with x and y from the top left of the image, an empty one stands for the whole image
+    struct PixelRect
+    {
+        int x = 0, y = 0, width = 0, height = 0;
+
+        bool Empty() const { return width <= 0 || height <= 0; }
+        bool Overlaps(int x0, int y0, int x1, int y1) const { return x0 < x + width && x < x1 && y0 < y + height && y < y1; }
+        // the part inside the image, the whole image when that is empty
+        PixelRect Clamp(int imageWidth, int imageHeight) const
+        {
+            PixelRect clamped;
+            clamped.x = Max(x, 0);
+            clamped.y = Max(y, 0);
+            clamped.width = Min(x + width, imageWidth) - clamped.x;
+            clamped.height = Min(y + height, imageHeight) - clamped.y;
+            if (Empty() || clamped.Empty()) return PixelRect { 0, 0, imageWidth, imageHeight };
+            return clamped;
+        }
+    };
+    PixelRect Region;
+    bool CropToRegion = false;
+    PixelRect PriorityRegion;
+
+    // primary rays of a frame, u runs left to right and v bottom to top, both from 0 to 1
+    struct FrameView
+    {
+        Vector3 origin, horizontal, vertical, lowerLeftCorner;
+
+        Ray At(float u, float v) const { return Ray(origin, lowerLeftCorner + (horizontal * u) + (vertical * v) - origin); }
+    };
     
-    float HitSphere(const Sphere& sphere, const Ray& ray, HitRecord& record);
-    bool TraceSpheres(const Ray& ray, float t_max, HitRecord& record);
-    Color RayColor(const Ray& ray, int depth);
+    void BuildPrimitivePacks();
+    void UseScene(SceneDescription& scene);
+    bool TraceScene(const Ray& ray, float t_max, HitRecord& record);
+    Color SampleLights(const HitRecord& record);
+    Color SurfaceAlbedo(const HitRecord& record);
+    Color SampleEnvironment(const HitRecord& record);
+    Color Background(const Ray& ray, float bouncePdf);
+    // pixel and sample weight a camera ray adds its first hit to the denoiser features with
+    struct FeatureSample { size_t index; float weight; };
+    // features is null for bounce rays and when the frame is not denoised
+    Color RayColor(const Ray& ray, int depth, float bouncePdf = 0.0f, const FeatureSample* features = nullptr);
+    void AccumulateFeatures(const FeatureSample& sample, const Ray& ray, const HitRecord* record, const Color& albedo);
+    void LogLightStatistics();
+    ContentHash SceneHash();
+    void SaveCheckpoint();
+    FrameView SetupView(int width, int height);
+    void RenderHeatmap(const FrameView& view, int width, int height);
+    void ApplyAnimation(float frame, SpherePack& spheres, CubePack& cubes, std::vector<std::vector<Cube>>& cubeKeys);
+    Vector3 Rebase(const Vector3& position);
+    Camera MoveOrigin(const Camera& camera, const Vector3d& from, const Vector3d& to);
 }
 
-bool RayTracer::TraceSpheres(const Ray& ray, float t_max, HitRecord& record) 
+void RayTracer::BuildPrimitivePacks()
 {
-    HitRecord temp_rec;
-    bool hit_anything = false;
-    float closest_so_far = t_max;
+    SpherePrimitives.Build(Spheres);
+    CubePrimitives.Build(Cubes);
+    PlanePrimitives.Build(Planes);
+}
 
-    for (const auto& object : Spheres) {
-        if (object.Hit(ray, closest_so_far, temp_rec)) {
-            hit_anything = true;
-            closest_so_far = temp_rec.t;
-            record = temp_rec;
-        }
+bool RayTracer::TraceScene(const Ray& ray, float t_max, HitRecord& record) 
+{
+    // each pack only reports hits closer than the ones before it
+    bool hit_anything = HitMany(ray, SpherePrimitives, t_max, record);
+    hit_anything |= HitMany(ray, CubePrimitives, t_max, record);
+    hit_anything |= HitMany(ray, PlanePrimitives, t_max, record);
+    record.time = ray.time;
+    if constexpr (RayStats::Enabled)
+    {
+        // cubes and planes are tested all at once, the spheres count the leaves they visit
+        RayStats::Counters& counters = RayStats::ThreadCounters();
+        counters[RayCounter::PrimitiveTests] += CubePrimitives.Count() + PlanePrimitives.Count();
+        counters[RayCounter::Hits] += hit_anything;
     }
-
     return hit_anything;
 }
 
@@ -73,71 +299,1164 @@ void RayTracer::Initialize()
 {
     Spheres.push_back(std::move(Sphere(0.5f, Vector3(0,0,-1))));
     Spheres.push_back(std::move(Sphere(100.0f, Vector3(0, -100.5, -1))));
+    // box resting on the ground, turned towards the camera
+    Cubes.push_back(Cube(Vector3(-0.2f), Vector3(0.2f), Matrix4::FromQuaternion(Quaternion::FromEuler(0.0f, 0.6f, 0.0f)) * Matrix4::FromPosition(1.0f, -0.3f, -1.4f)));
+    BuildPrimitivePacks();
+
+    // street lights scattered over the ground
+    for (int z = 0; z < 32; ++z)
+    {
+        for (int x = 0; x < 32; ++x)
+        {
+            Vector3 position = Vector3(-4.0f + x * 0.25f, -0.45f, -6.0f + z * 0.2f);
+            Color emission = Color(SceneRandom(2.0f, 6.0f), SceneRandom(1.5f, 4.0f), SceneRandom(0.5f, 2.0f));
+            Lights.push_back(Light(position, 0.01f, emission));
+        }
+    }
+
+    LightTree.Build(Lights);
+    LogLightStatistics();
 }
 
-float RayTracer::HitSphere(const Sphere& sphere, const Ray& ray, HitRecord& record)
+Color RayTracer::SampleLights(const HitRecord& record)
 {
-    Vector3 oc = ray.origin - sphere.center;
-    float a = Vector3::Dot(ray.direction, ray.direction);
-    float b = 2.0 * Vector3::Dot(oc, ray.direction);
-    float c = Vector3::Dot(oc, oc) - sphere.radius * sphere.radius;
-    float discriminant = b * b - 4 * a * c;
-    
-    if (discriminant <= 0) return -1.0f;
-    else return (-b - sqrtf(discriminant)) / (2.0 * a);
+    int lightIndex;
+    float pmf;
+    if (!LightTree.Sample(record.point, record.normal, RandomFloat(), lightIndex, pmf)) return Color(0);
+
+    const Light& light = Lights[lightIndex];
+    Vector3 direction;
+    float distance, pdf;
+    if (!SampleSphereLight(light, record.point, RandomFloat(), RandomFloat(), direction, distance, pdf)) return Color(0);
+
+    const float cosTheta = Vector3::Dot(record.normal, direction);
+    if (cosTheta <= 0.0f) return Color(0);
+
+    HitRecord shadowRecord;
+    RayStats::Add(RayCounter::ShadowRays);
+    if (TraceScene(Ray(OffsetRayOrigin(record), direction, record.time), distance - ShadowEpsilon, shadowRecord)) return Color(0);
+
+    // lambertian brdf is albedo / PI, the caller applies the albedo
+    return light.emission * (cosTheta * OneDivPI / (pdf * pmf));
 }
 
-Color RayTracer::RayColor(const Ray& ray, int depth)
+bool RayTracer::LoadEnvironment(const char* hdrPath)
 {
-    HitRecord record;
-    float t;
-    if (depth < 0) return Color(0);
+    if (!Environment.Load(hdrPath)) return false;
+    printf("environment map: %s %dx%d\n", hdrPath, Environment.width, Environment.height);
+    return true;
+}
+
+int RayTracer::LoadTexture(const char* path)
+{
+    const int texture = TextureSystem::Load(path);
+    if (texture >= 0)
+    {
+        TexturePaths.resize(Max(int(TexturePaths.size()), texture + 1));
+        TexturePaths[texture] = path;
+    }
+    return texture;
+}
+
+bool RayTracer::ExportScene(const char* path)
+{
+    SceneContents contents;
+    contents.spheres = &SpherePrimitives;
+    contents.cubes = &Cubes;
+    contents.planes = &Planes;
+    contents.lights = &Lights;
+    contents.textures = &TexturePaths;
+    if (!SceneFile::Write(path, contents)) return false;
+    printf("scene file: exported %s, %d spheres, %d bvh nodes\n", path, SpherePrimitives.Count(), SpherePrimitives.bvh.nodeCount);
+    return true;
+}
+
+bool RayTracer::LoadScene(const char* path)
+{
+    Trace::Scope scope("scene load");
+    const auto start = std::chrono::high_resolution_clock::now();
+    if (!MappedScene.Open(path)) return false;
+
+    // spheres and their bvh are used straight from the mapping, the rest is small enough to copy
+    Spheres.clear();
+    MappedScene.ViewSpheres(SpherePrimitives);
+    MappedScene.ReadCubes(Cubes);
+    MappedScene.ReadPlanes(Planes);
+    MappedScene.ReadLights(Lights);
+    SceneAnimation = Animation();
+    SceneCamera = MoveOrigin(SceneCamera, WorldOrigin, Vector3d::Zero());
+    WorldOrigin = Vector3d::Zero();
+    CubePrimitives.Build(Cubes);
+    PlanePrimitives.Build(Planes);
+
+    std::vector<std::string> textures;
+    MappedScene.ReadTextures(textures);
+    for (const std::string& texture : textures)
+    {
+        const int expected = int(&texture - textures.data());
+        if (LoadTexture(texture.c_str()) != expected) printf("scene file: texture %s did not get id %d, load scenes before other textures\n", texture.c_str(), expected);
+    }
+
+    LightTree.Build(Lights);
+    printf("scene file: %s, %.2f MB, %d spheres, %d bvh nodes, mapped in %.3f ms, ready in %.3f ms\n", path, MappedScene.Size() / (1024.0f * 1024.0f),
+           SpherePrimitives.Count(), SpherePrimitives.bvh.nodeCount, MappedScene.openMilliseconds,
+           std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    return true;
+}
+
+// replaces the current scene with a parsed or generated description and applies the settings it has
+void RayTracer::UseScene(SceneDescription& scene)
+{
+    // primitives refer to materials by index, the renderer by texture id
+    std::vector<int> textures(scene.materials.size(), -1);
+    for (size_t i = 0; i < scene.materials.size(); ++i)
+    {
+        if (!scene.materials[i].texture.empty()) textures[i] = LoadTexture(scene.materials[i].texture.c_str());
+    }
+    auto textureOf = [&](int material) { return material >= 0 ? textures[material] : -1; };
+    for (int& texture : scene.spheres.texture) texture = textureOf(texture);
+    for (Cube& cube : scene.cubes) cube.texture = textureOf(cube.texture);
+    for (Plane& plane : scene.planes) plane.texture = textureOf(plane.texture);
+
+    if (scene.settings.largeWorld >= 0) SetLargeWorld(scene.settings.largeWorld != 0);
+    // a camera kept from the scene before is still around the origin of that scene
+    const Camera camera = scene.hasCamera ? scene.camera : MoveOrigin(SceneCamera, WorldOrigin, Vector3d::Zero());
+    const Vector3d cameraPosition = scene.hasCamera ? scene.cameraPosition : ToVec3d(camera.position);
+    // the camera is the origin, only the offsets from it are rounded to float
+    WorldOrigin = LargeWorld ? cameraPosition : Vector3d::Zero();
+    if (LargeWorld)
+    {
+        for (size_t i = 0; i < scene.cubes.size(); ++i)
+        {
+            Cube& cube = scene.cubes[i];
+            cube.worldToLocal = Matrix4d::ToMatrix4(Matrix4d::Inverse(scene.cubeTransforms[i] * Matrix4d::FromPosition(-WorldOrigin)));
+        }
+        for (size_t i = 0; i < scene.planes.size(); ++i)
+        {
+            Plane& plane = scene.planes[i];
+            plane = Plane(plane.normal, ToVec3f(scene.planePoints[i] - WorldOrigin), plane.texture);
+        }
+        // lights are only sampled, a millimeter off does not show
+        for (Light& light : scene.lights) light.center = Rebase(light.center);
+        printf("scene: large world around %.3f %.3f %.3f\n", WorldOrigin.x, WorldOrigin.y, WorldOrigin.z);
+    }
+
+    MappedScene.Close();
+    Spheres.clear();
+    SpherePrimitives.Build(scene.spheres, WorldOrigin);
+    Cubes = std::move(scene.cubes);
+    Planes = std::move(scene.planes);
+    Lights = std::move(scene.lights);
+    CubePrimitives.Build(Cubes);
+    PlanePrimitives.Build(Planes);
+    LightTree.Build(Lights);
+
+    SceneCamera = MoveOrigin(camera, Vector3d::Zero(), WorldOrigin);
+    SceneCamera.position = ToVec3f(cameraPosition - WorldOrigin);
+    SceneAnimation = std::move(scene.animation);
+    const SceneSettings& settings = scene.settings;
+    if (settings.width > 0 || settings.height > 0) SetResolution(settings.width > 0 ? settings.width : ImageWidth, settings.height > 0 ? settings.height : ImageHeight);
+    if (settings.samples > 0) SetSamplesPerPixel(settings.samples);
+    if (settings.denoise >= 0) SetDenoise(settings.denoise != 0);
+    if (!settings.tonemap.empty() || settings.exposure != 0.0f) SetTonemap(settings.tonemap.empty() ? "aces" : settings.tonemap.c_str(), settings.exposure);
+    if (!settings.output.empty()) SetOutput(settings.output.c_str(), settings.quality > 0 ? settings.quality : OutputQuality);
+    else if (settings.quality > 0) OutputQuality = settings.quality;
+    if (!settings.environment.empty() && !LoadEnvironment(settings.environment.c_str())) printf("scene: could not load environment %s\n", settings.environment.c_str());
+}
+
+bool RayTracer::LoadJsonScene(const char* path)
+{
+    Trace::Scope scope("scene load");
+    SceneDescription scene;
+    if (!JsonScene::Parse(path, scene)) return false;
+    const auto start = std::chrono::high_resolution_clock::now();
+    UseScene(scene);
+
+    printf("scene json: %s, %.2f MB parsed in %.1f ms (%.0f MB/s), %d spheres, %d cubes, %d planes, %d lights, %d materials, ready in %.1f ms\n",
+           path, scene.bytes / (1024.0f * 1024.0f), scene.parseMilliseconds, scene.bytes / (1024.0f * 1024.0f) / Max(scene.parseMilliseconds * 0.001f, 1e-6f),
+           SpherePrimitives.Count(), int(Cubes.size()), int(Planes.size()), int(Lights.size()), int(scene.materials.size()),
+           std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    return true;
+}
+
+void RayTracer::BenchmarkSceneStartup(const char* path)
+{
+    // startup is measured up to the end of a coarse grid of primary rays, which is what pulls the top of the bvh
+    // and the spheres near the camera in from the file
+    auto probe = [&]()
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        if (!LoadScene(path)) return -1.0f;
+        int hits = 0;
+        for (int y = 0; y < 90; ++y)
+        {
+            for (int x = 0; x < 160; ++x)
+            {
+                const Vector3 direction((x + 0.5f) / 160.0f * 3.5f - 1.75f, (y + 0.5f) / 90.0f * 2.0f - 1.0f, -1.0f);
+                HitRecord record;
+                hits += TraceScene(Ray(Vector3::Zero(), direction), FLT_MAX, record);
+            }
+        }
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    };
+
+    const bool evicted = MappedFile::EvictFromCache(path);
+    const float cold = probe();
+    const float warm = probe();
+    printf("scene startup: %s cold %.3f ms%s, warm %.3f ms\n", path, cold, evicted ? "" : " (page cache not dropped)", warm);
+}
+
+void RayTracer::BenchmarkFrames(int frames)
+{
+    // the first frame sizes every buffer and arena, the ones after it should not allocate at all.
+    // the writer is drained first so its encoders do not allocate while a frame is counted
+    double totalMilliseconds = 0.0;
+    uint64_t warmAllocations = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        Output.Flush();
+        const auto start = std::chrono::high_resolution_clock::now();
+        RenderFrame();
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        printf("frame benchmark: frame %d, %.1f ms, %llu heap allocations, frame arena peak %.2f MB\n", frame, milliseconds,
+               (unsigned long long)LastFrameAllocations, Memory::ThreadArena().PeakBytes() / (1024.0 * 1024.0));
+        if (frame == 0) continue;
+        totalMilliseconds += milliseconds;
+        warmAllocations += LastFrameAllocations;
+    }
+    Output.Flush();
+    if (frames > 1) printf("frame benchmark: %d warm frames, %.1f ms per frame, %llu heap allocations\n", frames - 1, totalMilliseconds / (frames - 1), (unsigned long long)warmAllocations);
+}
+
+// poses the animated primitives of the packs at frame, the other primitives keep whatever the packs hold.
+// with motion blur they are posed at every key of the shutter that opens at frame
+void RayTracer::ApplyAnimation(float frame, SpherePack& spheres, CubePack& cubes, std::vector<std::vector<Cube>>& cubeKeys)
+{
+    const int steps = MotionShutter > 0.0f ? MotionSegments : 0;
+    auto keyFrame = [&](int key) { return steps > 0 ? frame + MotionShutter * key / steps : frame; };
+
+    bool moved = false;
+    if (!SceneAnimation.spheres.empty() && !spheres.lanes.empty() && spheres.motionSteps != steps) spheres.SetMotion(steps);
+    for (const TransformTrack& track : SceneAnimation.spheres)
+    {
+        if (track.index >= int(spheres.lanes.size())) continue;
+        if (steps == 0) spheres.Move(track.index, Rebase(Animation::Sample(track.keys, frame).position));
+        for (int key = 0; key <= steps && steps > 0; ++key) spheres.Move(track.index, Rebase(Animation::Sample(track.keys, keyFrame(key)).position), key);
+        moved = true;
+    }
+    if (moved) spheres.Refit();
+
+    if (SceneAnimation.cubes.empty()) return;
+    cubeKeys.resize(steps + 1);
+    for (int key = 0; key <= steps; ++key)
+    {
+        std::vector<Cube>& pose = cubeKeys[key];
+        pose = Cubes;
+        for (const TransformTrack& track : SceneAnimation.cubes)
+        {
+            if (track.index >= int(pose.size())) continue;
+            const TransformKey transform = Animation::Sample(track.keys, keyFrame(key));
+            Cube& cube = pose[track.index];
+            cube = Cube(cube.min, cube.max, Matrix4::FromQuaternion(transform.rotation) * Matrix4::FromPosition(Rebase(transform.position)), cube.texture);
+        }
+    }
+    if (steps > 0) cubes.BuildMotion(cubeKeys);
+    else cubes.Build(cubeKeys[0]);
+}
 
-    for (auto& sphere : Spheres)
+bool RayTracer::RenderAnimation(int first, int count)
+{
+    const int frames = SceneAnimation.frames;
+    if (frames == 0)
+    {
+        printf("animation: the scene is not animated\n");
+        return false;
+    }
+    const int end = count > 0 ? Min(first + count, frames) : frames;
+    if (first < 0 || first >= end)
     {
-        t = HitSphere(sphere, ray, record);
-        if (t > 0.0)
+        printf("animation: frames %d to %d are outside of the %d frames of the scene\n", first, end - 1, frames);
+        return false;
+    }
+    for (const TransformTrack& track : SceneAnimation.spheres)
+    {
+        if (SpherePrimitives.lanes.empty()) { printf("animation: spheres of a mapped scene file do not move, load the json scene instead\n"); break; }
+        if (track.index >= int(SpherePrimitives.lanes.size())) printf("animation: there is no sphere %d to move\n", track.index);
+    }
+    for (const TransformTrack& track : SceneAnimation.cubes)
+    {
+        if (track.index >= int(Cubes.size())) printf("animation: there is no cube %d to move\n", track.index);
+    }
+
+    // the next frame is posed and its bvh refit into a second set of packs on another thread while this one is
+    // traced, swapping them is all that is left between frames
+    std::vector<std::vector<Cube>> cubeScratch, nextCubeScratch;
+    ApplyAnimation(float(first), SpherePrimitives, CubePrimitives, cubeScratch);
+    SpherePack nextSpheres = SpherePrimitives;
+    CubePack nextCubes = CubePrimitives;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool posed = false; // the next packs hold a frame that is not swapped in yet
+    float refitMilliseconds = 0.0f;
+    std::thread refitter([&]
+    {
+        Trace::SetThreadName("animation refit");
+        for (int frame = first + 1; frame < end; ++frame)
         {
-            Vector3 N = Vector3::Normalize(ray.At(t) - Vector3(0, 0, -1));
-            Vector3 target = record.point + record.normal + random_in_unit_sphere();
-            return RayColor(Ray(record.point, target - record.point), depth-1) * 0.5f;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return !posed; });
+            }
+            const auto start = std::chrono::high_resolution_clock::now();
+            {
+                Trace::Scope scope("refit");
+                ApplyAnimation(float(frame), nextSpheres, nextCubes, nextCubeScratch);
+            }
+            const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                refitMilliseconds = milliseconds;
+                posed = true;
+            }
+            changed.notify_all();
         }
+    });
+
+    const std::string outputPath = OutputPath;
+    for (int frame = first; frame < end; ++frame)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        if (!SceneAnimation.camera.empty()) SceneCamera = MoveOrigin(SceneAnimation.CameraAt(float(frame)), Vector3d::Zero(), WorldOrigin);
+        const std::string framePath = SceneAnimation.FramePath(outputPath, frame);
+        const std::filesystem::path directory = std::filesystem::path(framePath).parent_path();
+        std::error_code error;
+        if (!directory.empty()) std::filesystem::create_directories(directory, error);
+        OutputPath = framePath;
+        RenderFrame();
+        const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        printf("animation: frame %d of %d, %s, %.1f ms\n", frame, frames, framePath.c_str(), milliseconds);
+        if (frame + 1 == end) break;
+
+        // a refit slower than the frame shows up as the wait here
+        float refit;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return posed; });
+            std::swap(SpherePrimitives, nextSpheres);
+            std::swap(CubePrimitives, nextCubes);
+            refit = refitMilliseconds;
+        }
+        // every animated primitive is posed from its keys, the packs swapped out need nothing from the frame they held
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            posed = false;
+        }
+        changed.notify_all();
+        printf("animation: frame %d posed and refit in %.2f ms next to the render\n", frame + 1, refit);
     }
+    refitter.join();
+    OutputPath = outputPath;
+    return true;
+}
 
+bool RayTracer::LoadCorpusScene(const char* name)
+{
+    Trace::Scope scope("scene load");
+    const auto start = std::chrono::high_resolution_clock::now();
+    SceneDescription scene;
+    if (!SceneCorpus::Generate(name, scene)) return false;
+    UseScene(scene);
+    printf("scene corpus: %s, %d spheres, %d cubes, %d planes, %d lights, ready in %.1f ms\n", name, SpherePrimitives.Count(),
+           int(Cubes.size()), int(Planes.size()), int(Lights.size()), std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    return true;
+}
+
+bool RayTracer::BenchmarkCorpus(const char* directory, float tolerance, bool updateBaseline)
+{
+    // every scene renders at the same size and sample count from the same random state without denoising,
+    // so a change that should not affect the image renders the baseline bit for bit
+    constexpr int Width = 320, Height = 180, Samples = 4;
+    constexpr int Repeats = 3; // the fastest is compared, the others absorb noise from the rest of the machine
+    // see MappedRmse
+    constexpr double RmseLimit = 0.01;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const std::string baselinePath = std::string(directory) + "/baseline.txt";
+
+    // one "scene milliseconds" line per scene
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!updateBaseline)
+    {
+        FILE* file = fopen(baselinePath.c_str(), "r");
+        if (!file)
+        {
+            printf("scene benchmark: no baseline at %s, run with the update option first\n", baselinePath.c_str());
+            return false;
+        }
+        char name[64];
+        double milliseconds;
+        while (fscanf(file, "%63s %lf", name, &milliseconds) == 2) baseline.emplace_back(name, milliseconds);
+        fclose(file);
+    }
+
+    SetResolution(Width, Height);
+    SetSamplesPerPixel(Samples);
+    SetDenoise(false);
+    SetRegion(0, 0, 0, 0);
+    SetPriorityRegion(0, 0, 0, 0);
+    HeatmapMode = false;
+    CheckpointPath.clear();
+
+    bool passed = true;
+    std::vector<std::pair<std::string, double>> measured;
+    for (const char* name : SceneCorpus::Names)
+    {
+        if (!LoadCorpusScene(name)) return false;
+        const std::string imagePath = std::string(directory) + "/" + name + (updateBaseline ? ".pfm" : ".current.pfm");
+        SetOutput(imagePath.c_str());
+
+        double best = DBL_MAX;
+        for (int repeat = 0; repeat < Repeats; ++repeat)
+        {
+            Sampler.seed(std::mt19937::default_seed);
+            Output.Flush();
+            const auto start = std::chrono::high_resolution_clock::now();
+            RenderFrame();
+            best = Min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        Output.Flush();
+        measured.emplace_back(name, best);
+        const double samplesPerSecond = double(Width) * Height * Samples / (best * 1e-3);
+        if (updateBaseline)
+        {
+            printf("scene benchmark: %-8s %8.1f ms, %.2f Msamples/s\n", name, best, samplesPerSecond * 1e-6);
+            continue;
+        }
+
+        auto entry = std::find_if(baseline.begin(), baseline.end(), [&](const auto& line) { return line.first == name; });
+        const std::string referencePath = std::string(directory) + "/" + name + ".pfm";
+        int width, height, referenceWidth, referenceHeight;
+        std::vector<Color> image, reference;
+        if (entry == baseline.end() || !FloatImage::ReadPfm(imagePath.c_str(), width, height, image) ||
+            !FloatImage::ReadPfm(referencePath.c_str(), referenceWidth, referenceHeight, reference) ||
+            width != referenceWidth || height != referenceHeight)
+        {
+            printf("scene benchmark: %-8s FAILED, no baseline time or image to compare with\n", name);
+            passed = false;
+            continue;
+        }
+
+        const double rmse = MappedRmse(image, reference);
+        const double change = entry->second / best - 1.0; // throughput, positive is faster
+        const bool slower = change < -tolerance, different = !(rmse <= RmseLimit);
+        passed &= !slower && !different;
+        printf("scene benchmark: %-8s %8.1f ms, baseline %8.1f ms, throughput %+6.1f%%, %.2f Msamples/s, rmse %.5f%s%s\n", name, best,
+               entry->second, change * 100.0, samplesPerSecond * 1e-6, rmse, slower ? ", TOO SLOW" : "", different ? ", IMAGE CHANGED" : "");
+    }
+
+    if (updateBaseline)
+    {
+        FILE* file = fopen(baselinePath.c_str(), "w");
+        if (!file)
+        {
+            printf("scene benchmark: could not write %s\n", baselinePath.c_str());
+            return false;
+        }
+        for (const auto& line : measured) fprintf(file, "%s %.3f\n", line.first.c_str(), line.second);
+        passed = fclose(file) == 0;
+        printf("scene benchmark: baseline of %d scenes written to %s\n", int(measured.size()), directory);
+        return passed;
+    }
+    printf("scene benchmark: %s, throughput tolerance %.0f%%, rmse limit %.3f\n", passed ? "passed" : "FAILED", tolerance * 100.0f, RmseLimit);
+    return passed;
+}
+
+bool RayTracer::BenchmarkLargeWorld(const char* directory, double distance)
+{
+    // scenes with spheres, a cube and a plane. each is rendered where it was made as the reference, then moved
+    // distance along every axis and rendered in float world space and in large world mode
+    constexpr const char* Scenes[] = { "default", "weekend", "mesh" };
+    constexpr int Width = 320, Height = 180, Samples = 4;
+    const Vector3d offset(distance, distance, distance);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    SetResolution(Width, Height);
+    SetSamplesPerPixel(Samples);
+    SetDenoise(false);
+    SetRegion(0, 0, 0, 0);
+    SetPriorityRegion(0, 0, 0, 0);
+    HeatmapMode = false;
+    CheckpointPath.clear();
+    // the same random numbers for every pixel in all three, what is left of the difference is geometry
+    const bool largeWorld = LargeWorld, deterministic = DeterministicSampling;
+    SetDeterministic(true);
+
+    for (const char* name : Scenes)
+    {
+        std::vector<Color> reference;
+        for (int run = 0; run < 3; ++run)
+        {
+            SceneDescription scene;
+            if (!SceneCorpus::Generate(name, scene)) return false;
+            if (run > 0)
+            {
+                // what a scene file placed out there holds, the float copies rounded where they are
+                for (size_t i = 0; i < scene.spheres.Count(); ++i)
+                {
+                    scene.spheres.centerX[i] += offset.x; scene.spheres.centerY[i] += offset.y; scene.spheres.centerZ[i] += offset.z;
+                }
+                for (size_t i = 0; i < scene.cubes.size(); ++i)
+                {
+                    scene.cubeTransforms[i] *= Matrix4d::FromPosition(offset);
+                    scene.cubes[i].worldToLocal = Matrix4d::ToMatrix4(Matrix4d::Inverse(scene.cubeTransforms[i]));
+                }
+                for (size_t i = 0; i < scene.planes.size(); ++i)
+                {
+                    scene.planePoints[i] += offset;
+                    scene.planes[i] = Plane(scene.planes[i].normal, ToVec3f(scene.planePoints[i]), scene.planes[i].texture);
+                }
+                for (Light& light : scene.lights) light.center = ToVec3f(ToVec3d(light.center) + offset);
+                const Vector3d cameraPosition = scene.cameraPosition + offset;
+                scene.SetCamera(MoveOrigin(scene.camera, offset, Vector3d::Zero()));
+                scene.cameraPosition = cameraPosition;
+            }
+            SetLargeWorld(run == 2);
+            const auto start = std::chrono::high_resolution_clock::now();
+            UseScene(scene);
+            const double ready = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            const std::string imagePath = std::string(directory) + "/" + name + (run == 0 ? ".origin.pfm" : run == 1 ? ".float.pfm" : ".large.pfm");
+            SetOutput(imagePath.c_str());
+            const auto renderStart = std::chrono::high_resolution_clock::now();
+            RenderFrame();
+            const double rendered = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count();
+            Output.Flush();
+
+            int width, height;
+            std::vector<Color> image;
+            if (!FloatImage::ReadPfm(imagePath.c_str(), width, height, image))
+            {
+                printf("large world benchmark: could not read back %s\n", imagePath.c_str());
+                SetLargeWorld(largeWorld);
+                SetDeterministic(deterministic);
+                return false;
+            }
+            if (run == 0) reference = std::move(image);
+            const char* label = run == 0 ? "at the origin" : run == 1 ? "float world" : "large world";
+            printf("large world benchmark: %-8s %-13s ready in %7.1f ms, rendered in %7.1f ms, rmse %.5f\n", name, label, ready, rendered,
+                   run == 0 ? 0.0 : MappedRmse(image, reference));
+        }
+    }
+    SetLargeWorld(largeWorld);
+    SetDeterministic(deterministic);
+    printf("large world benchmark: scenes moved %.0f along every axis, images in %s\n", distance, directory);
+    return true;
+}
+
+void RayTracer::SetResolution(int width, int height)
+{
+    ImageWidth = Max(width, 1);
+    ImageHeight = Max(height, 1);
+}
+
+void RayTracer::SetSamplesPerPixel(int samples)
+{
+    SamplesPerPixel = Max(samples, 1);
+}
+
+void RayTracer::SetDenoise(bool enabled)
+{
+    DenoiseOutput = enabled;
+}
+
+void RayTracer::SetDeterministic(bool enabled)
+{
+    DeterministicSampling = enabled;
+    // a time budget would make the number of denoiser iterations depend on the machine and its load
+    FrameDenoiser.settings.timeBudgetMs = enabled ? FLT_MAX : DenoiserSettings().timeBudgetMs;
+}
+
+void RayTracer::SetMotionBlur(float shutter, int segments)
+{
+    MotionShutter = Max(shutter, 0.0f);
+    MotionSegments = Max(segments, 1);
+}
+
+void RayTracer::SetLargeWorld(bool enabled)
+{
+    LargeWorld = enabled;
+}
+
+// keyframes and lights are kept in float, they are moved next to the origin from there
+Vector3 RayTracer::Rebase(const Vector3& position)
+{
+    return ToVec3f(ToVec3d(position) - WorldOrigin);
+}
+
+Camera RayTracer::MoveOrigin(const Camera& camera, const Vector3d& from, const Vector3d& to)
+{
+    const Vector3d offset = from - to;
+    return Camera(ToVec3f(ToVec3d(camera.position) + offset), ToVec3f(ToVec3d(camera.target) + offset), camera.up, camera.verticalFov);
+}
+
+void RayTracer::SetRegion(int x, int y, int width, int height, bool crop)
+{
+    Region = PixelRect { x, y, width, height };
+    CropToRegion = crop && !Region.Empty();
+}
+
+void RayTracer::SetPriorityRegion(int x, int y, int width, int height)
+{
+    PriorityRegion = PixelRect { x, y, width, height };
+}
+
+void RayTracer::SetThreads(int count)
+{
+    JobSystem::Pool.Initialize(count);
+}
+
+bool RayTracer::SetTonemap(const char* curve, float exposure, bool dither)
+{
+    TonemapSettings& settings = FrameTonemapper.settings;
+    if (strcmp(curve, "aces") == 0) settings.curve = ToneCurve::Aces;
+    else if (strcmp(curve, "reinhard") == 0) settings.curve = ToneCurve::Reinhard;
+    else if (strcmp(curve, "none") == 0) settings.curve = ToneCurve::None;
+    else
+    {
+        printf("tonemap: unknown curve %s\n", curve);
+        return false;
+    }
+    settings.exposure = exposure;
+    settings.dither = dither;
+    return true;
+}
+
+void RayTracer::SetStatisticsOutput(const char* path)
+{
+    StatisticsPath = path ? path : "";
+}
+
+void RayTracer::SetHeatmap(bool enabled, const char* countsPath)
+{
+    HeatmapMode = enabled;
+    HeatmapCountsPath = countsPath ? countsPath : "";
+}
+
+void RayTracer::SetOutput(const char* path, int quality)
+{
+    OutputPath = path;
+    OutputQuality = quality;
+}
+
+void RayTracer::FinishOutput()
+{
+    Output.Flush();
+    // everything that records is idle now
+    if (!TracePath.empty()) Trace::Export(TracePath.c_str());
+}
+
+void RayTracer::SetTrace(const char* path)
+{
+    TracePath = path ? path : "";
+    if (TracePath.empty()) return;
+    Trace::SetThreadName("main");
+    Trace::Start();
+}
+
+void RayTracer::SetCheckpoint(const char* path, float intervalSeconds, bool resume)
+{
+    CheckpointPath = path ? path : "";
+    CheckpointInterval = intervalSeconds;
+    ResumeFromCheckpoint = resume;
+}
+
+void RayTracer::SetBVHCache(const char* directory)
+{
+    BVHCache::Directory = directory ? directory : "";
+}
+
+// geometry, lights and everything else that changes the image, camera and resolution are added by RenderFrame
+ContentHash RayTracer::SceneHash()
+{
+    ContentHash hash;
+    hash.Add(MaxDepth);
+    hash.Add(int(DeterministicSampling)); // the two modes draw different samples, their passes do not mix
+    for (int i = 0; i < SpherePrimitives.Count(); ++i)
+    {
+        hash.Add(SpherePrimitives.centerX[i]); hash.Add(SpherePrimitives.centerY[i]); hash.Add(SpherePrimitives.centerZ[i]);
+        hash.Add(SpherePrimitives.radius[i]); hash.Add(SpherePrimitives.texture[i]);
+    }
+    // moving primitives are hashed where they are at every key of the shutter
+    hash.Add(SpherePrimitives.motionSteps);
+    for (const std::vector<float>* array : { &SpherePrimitives.motionX, &SpherePrimitives.motionY, &SpherePrimitives.motionZ })
+    {
+        for (float value : *array) hash.Add(value);
+    }
+    for (const Cube& cube : CubePrimitives.cubes)
+    {
+        hash.Add(cube.min); hash.Add(cube.max); hash.Add(cube.texture);
+        for (int row = 0; row < 4; ++row) for (int column = 0; column < 4; ++column) hash.Add(cube.worldToLocal.m[row][column]);
+    }
+    hash.Add(CubePrimitives.motionSteps);
+    for (const std::vector<float>& array : CubePrimitives.motionTransform)
+    {
+        for (float value : array) hash.Add(value);
+    }
+    for (const Plane& plane : Planes) { hash.Add(plane.normal); hash.Add(plane.distance); hash.Add(plane.texture); }
+    for (const Light& light : Lights) { hash.Add(light.center); hash.Add(light.radius); hash.Add(light.emission); }
+    hash.Add(Environment.width); hash.Add(Environment.height); hash.Add(&Environment.texelHash, sizeof(Environment.texelHash));
+    // textures by source path, size and modification time, an edited image gets new tiles and a new hash
+    for (const std::string& path : TexturePaths)
+    {
+        hash.Add(path.data(), path.size());
+        std::error_code error;
+        const uint64_t size = std::filesystem::file_size(path, error);
+        const int64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        hash.Add(&size, sizeof(size)); hash.Add(&modified, sizeof(modified));
+    }
+    return hash;
+}
+
+void RayTracer::SaveCheckpoint()
+{
+    Trace::Scope scope("checkpoint save");
+    std::ostringstream sampler;
+    sampler << Sampler;
+    Progress.sampler = sampler.str();
+    if (!Checkpoint::Save(CheckpointPath, Progress)) printf("checkpoint: failed to save %s\n", CheckpointPath.c_str());
+}
+
+Color RayTracer::SurfaceAlbedo(const HitRecord& record)
+{
+    if (record.texture < 0) return Color(DiffuseAlbedo);
+
+    // ray cone footprint of the hit in texels of the finest level
+    const Texture& texture = TextureSystem::Cache.GetTexture(record.texture);
+    const float footprint = record.t * PixelSpreadAngle * record.uvPerUnit;
+    const float lod = log2f(Max(footprint * Max(texture.Width(), texture.Height()), 1.0f));
+    return TextureSystem::SampleTrilinear(record.texture, record.u, record.v, lod);
+}
+
+// next event estimation towards the environment, combined with bounce rays that escape through MIS
+Color RayTracer::SampleEnvironment(const HitRecord& record)
+{
+    if (!Environment.Loaded()) return Color(0);
+
+    Vector3 direction;
+    float pdf;
+    const Color radiance = Environment.Sample(RandomFloat(), RandomFloat(), direction, pdf);
+    if (pdf <= 0.0f) return Color(0);
+
+    const float cosTheta = Vector3::Dot(record.normal, direction);
+    if (cosTheta <= 0.0f) return Color(0);
+
+    HitRecord shadowRecord;
+    RayStats::Add(RayCounter::ShadowRays);
+    if (TraceScene(Ray(OffsetRayOrigin(record), direction, record.time), FLT_MAX, shadowRecord)) return Color(0);
+
+    const float bsdfPdf = cosTheta * OneDivPI;
+    return radiance * (cosTheta * OneDivPI * PowerHeuristic(pdf, bsdfPdf) / pdf);
+}
+
+// radiance of rays that leave the scene, bouncePdf is zero for camera rays
+Color RayTracer::Background(const Ray& ray, float bouncePdf)
+{
 	const Vector3 unitDirection = Vector3::Normalize(ray.direction);
-	t = 0.5f * (unitDirection.y + 1.0);
+
+    if (Environment.Loaded())
+    {
+        const Color radiance = Environment.Lookup(unitDirection);
+        if (bouncePdf <= 0.0f) return radiance;
+        return radiance * PowerHeuristic(bouncePdf, Environment.Pdf(unitDirection));
+    }
+
+	const float t = 0.5f * (unitDirection.y + 1.0);
 	const float oneMinusT = 1.0 - t;
 	return Color(oneMinusT) + Color(0.5f * t, 0.7f * t, 1.0f * t) ;
 }
 
-void RayTracer::RenderFrame()
+// logs the light tree build and query cost and how much it reduces variance compared to uniform light selection
+void RayTracer::LogLightStatistics()
 {
-    // Image
-    const float aspect_ratio = 16.0 / 9.0;
-    const int image_width = 400;
-    const int image_height = int(image_width / aspect_ratio);
+    if (LightTree.Empty()) return;
 
-    // Camera
+    constexpr int PointCount = 1024;
+    constexpr int SampleCount = 64;
+    const AABB& bounds = LightTree.nodes[0].bounds;
 
-    const float viewport_height = 2.0;
+    // unshadowed direct lighting estimate for one light, this is what both strategies estimate
+    auto estimate = [](const Light& light, const Vector3& point, const Vector3& normal, float pmf)
+    {
+        Vector3 direction;
+        float distance, pdf;
+        if (!SampleSphereLight(light, point, RandomFloat(), RandomFloat(), direction, distance, pdf)) return 0.0f;
+        float cosTheta = Max(Vector3::Dot(normal, direction), 0.0f);
+        return light.emission.Luminance() * cosTheta * OneDivPI / (pdf * pmf);
+    };
+
+    std::vector<Vector3> points(PointCount), normals(PointCount);
+    for (int i = 0; i < PointCount; ++i)
+    {
+        points[i] = bounds.min + bounds.Diagonal() * Vector3(RandomFloat(), RandomFloat(), RandomFloat());
+        normals[i] = RandomUnitVector();
+    }
+
+    double uniformVariance = 0.0, treeVariance = 0.0;
+    int measuredPoints = 0;
+
+    for (int i = 0; i < PointCount; ++i)
+    {
+        double uniformSum = 0.0, uniformSumSq = 0.0, treeSum = 0.0, treeSumSq = 0.0;
+        for (int s = 0; s < SampleCount; ++s)
+        {
+            int uniformIndex = Min(int(RandomFloat() * Lights.size()), int(Lights.size()) - 1);
+            double value = estimate(Lights[uniformIndex], points[i], normals[i], 1.0f / Lights.size());
+            uniformSum += value; uniformSumSq += value * value;
+
+            int treeIndex; float pmf;
+            value = LightTree.Sample(points[i], normals[i], RandomFloat(), treeIndex, pmf) ? estimate(Lights[treeIndex], points[i], normals[i], pmf) : 0.0;
+            treeSum += value; treeSumSq += value * value;
+        }
+        // both strategies estimate the same value, the pooled mean is the least noisy reference
+        const double mean = (uniformSum + treeSum) / (2.0 * SampleCount);
+        if (mean <= 0.0) continue;
+        // relative variance so every point has the same weight
+        const double uniformMean = uniformSum / SampleCount, treeMean = treeSum / SampleCount;
+        uniformVariance += (uniformSumSq / SampleCount - uniformMean * uniformMean) / (mean * mean);
+        treeVariance    += (treeSumSq / SampleCount - treeMean * treeMean) / (mean * mean);
+        measuredPoints++;
+    }
+
+    int lightIndex; float pmf; int sampled = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < PointCount; ++i) sampled += LightTree.Sample(points[i], normals[i], RandomFloat(), lightIndex, pmf);
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double queryNanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / PointCount;
+
+    printf("light bvh: %d lights, %d nodes, build %.2f ms, query %.1f ns, variance reduction %.2fx (%d/%d points)\n",
+           int(Lights.size()), int(LightTree.nodes.size()), LightTree.buildMilliseconds, queryNanoseconds,
+           treeVariance > 0.0 ? uniformVariance / treeVariance : 0.0, measuredPoints, PointCount);
+}
+
+Color RayTracer::RayColor(const Ray& ray, int depth, float bouncePdf, const FeatureSample* features)
+{
+    HitRecord record;
+    if (depth < 0) return Color(0);
+
+    if (TraceScene(ray, FLT_MAX, record))
+    {
+        const Color albedo = SurfaceAlbedo(record);
+        if (features) AccumulateFeatures(*features, ray, &record, albedo);
+        Color direct = SampleLights(record) + SampleEnvironment(record);
+        Vector3 direction = RandomCosineDirection(record.normal);
+        float pdf = Max(Vector3::Dot(record.normal, direction), 0.0f) * OneDivPI;
+        // the last bounce returns before tracing
+        if (depth > 0) RayStats::Add(RayCounter::SecondaryRays);
+        return (direct + RayColor(Ray(OffsetRayOrigin(record), direction, record.time), depth-1, pdf)) * albedo;
+    }
+
+    if (features) AccumulateFeatures(*features, ray, nullptr, Color(1.0f));
+    return Background(ray, bouncePdf);
+}
+
+// first hit albedo, normal and depth for the denoiser, averaged over the samples of a pixel. record is null for a miss
+void RayTracer::AccumulateFeatures(const FeatureSample& sample, const Ray& ray, const HitRecord* record, const Color& albedo)
+{
+    Progress.features.albedo.Data()[sample.index] += albedo * sample.weight;
+    if (!record) return;
+    Progress.features.normal.Data()[sample.index] += record->normal * sample.weight;
+    Progress.features.depth.Data()[sample.index] += record->t * ray.direction.Length() * sample.weight;
+}
+
+RayTracer::FrameView RayTracer::SetupView(int width, int height)
+{
+    const float aspect_ratio = float(width) / height;
+    const float viewport_height = 2.0f * tanf(SceneCamera.verticalFov * DegToRad * 0.5f);
     const float viewport_width = aspect_ratio * viewport_height;
     const float focal_length = 1.0;
 
-    const Vector3 origin     = Vector3(0, 0, 0);
-    const Vector3 horizontal = Vector3(viewport_width, 0, 0);
-    const Vector3 vertical   = Vector3(0, viewport_height, 0);
-    const Vector3 lower_left_corner = origin - horizontal / 2 - vertical / 2 - Vector3(0, 0, focal_length);
+    // right handed basis, the camera looks down -back
+    const Vector3 back  = Vector3::Normalize(SceneCamera.position - SceneCamera.target);
+    const Vector3 right = Vector3::Normalize(Vector3::Cross(SceneCamera.up, back));
+    const Vector3 up    = Vector3::Cross(back, right);
+
+    FrameView view;
+    view.origin     = SceneCamera.position;
+    view.horizontal = right * viewport_width;
+    view.vertical   = up * viewport_height;
+    view.lowerLeftCorner = view.origin - view.horizontal / 2 - view.vertical / 2 - back * focal_length;
+    PixelSpreadAngle = atanf(viewport_height / (focal_length * height));
+    return view;
+}
+
+// black through blue, cyan, green and yellow to red for t from 0 to 1
+static Color HeatColor(float t)
+{
+    static const Color Ramp[] = { Color(0.0f, 0.0f, 0.0f), Color(0.0f, 0.0f, 1.0f), Color(0.0f, 1.0f, 1.0f),
+                                  Color(0.0f, 1.0f, 0.0f), Color(1.0f, 1.0f, 0.0f), Color(1.0f, 0.0f, 0.0f) };
+    constexpr int Segments = int(sizeof(Ramp) / sizeof(Ramp[0])) - 1;
+    const float x = Clamp(t, 0.0f, 1.0f) * Segments;
+    const int segment = Min(int(x), Segments - 1);
+    return Color::Mix(Ramp[segment], Ramp[segment + 1], x - segment);
+}
+
+// one ray through the center of every pixel, colored by the bvh nodes visited plus primitives tested to find its hit.
+// the ramp is scaled to the most expensive pixel of the frame. float outputs get the raw counts instead:
+// nodes in red, primitives in green and their sum in blue
+void RayTracer::RenderHeatmap(const FrameView& view, int width, int height)
+{
+    if constexpr (!RayStats::Enabled)
+    {
+        printf("heatmap: needs the ray counters, RAY_STATISTICS is 0 in this build\n");
+        return;
+    }
+
+    Arena& frameArena = Memory::ThreadArena();
+    const size_t pixelCount = size_t(width) * height;
+    Color* counts = frameArena.Allocate<Color>(pixelCount);
+    RayStats::Counters& counters = RayStats::ThreadCounters();
+
+    float maxCost = 0.0f;
+    double nodeSum = 0.0, primitiveSum = 0.0;
+    for (int y = 0; y < height; ++y)
+    {
+        const int j = height - 1 - y;
+        for (int i = 0; i < width; ++i)
+        {
+            const uint64_t nodesBefore = counters[RayCounter::NodeVisits];
+            const uint64_t primitivesBefore = counters[RayCounter::PrimitiveTests];
+            HitRecord record;
+            TraceScene(view.At((i + 0.5f) / (width - 1), (j + 0.5f) / (height - 1)), FLT_MAX, record);
+            const float nodes = float(counters[RayCounter::NodeVisits] - nodesBefore);
+            const float primitives = float(counters[RayCounter::PrimitiveTests] - primitivesBefore);
+
+            counts[size_t(y) * width + i] = Color(nodes, primitives, nodes + primitives);
+            maxCost = Max(maxCost, nodes + primitives);
+            nodeSum += nodes; primitiveSum += primitives;
+        }
+    }
+    printf("heatmap: %.2f nodes and %.2f primitives per primary ray on average, %.0f at most\n",
+           nodeSum / pixelCount, primitiveSum / pixelCount, maxCost);
+
+    if (!HeatmapCountsPath.empty())
+    {
+        OutputImage raw;
+        raw.path = HeatmapCountsPath;
+        raw.width = width; raw.height = height;
+        raw.radiance.assign(counts, counts + pixelCount);
+        ImageWriter::Write(raw);
+    }
+
+    OutputImage* image = Output.AcquireBuffer();
+    image->path = OutputPath;
+    image->quality = OutputQuality;
+    if (ImageWriter::IsFloatFormat(OutputPath))
+    {
+        image->width = width;
+        image->height = height;
+        image->radiance.assign(counts, counts + pixelCount);
+    }
+    else
+    {
+        image->Resize(width, height);
+        const float scale = maxCost > 0.0f ? 1.0f / maxCost : 0.0f;
+        for (size_t pixel = 0; pixel < pixelCount; ++pixel) image->pixels[pixel] = HeatColor(counts[pixel].b * scale).ConvertToColor32();
+    }
+    Output.Submit(image);
+}
+
+void RayTracer::RenderFrame()
+{
+    Trace::Scope frameScope("frame");
+    // frame temporaries come from the arena of the rendering thread, everything of the last frame is dropped here
+    const uint64_t allocationsAtStart = Memory::HeapAllocations();
+    Arena& frameArena = Memory::ThreadArena();
+    frameArena.Reset();
+
+    // Image
+    const int image_width = ImageWidth;
+    const int image_height = ImageHeight;
+    const FrameView view = SetupView(image_width, image_height);
+    if (HeatmapMode) return RenderHeatmap(view, image_width, image_height);
+
+    const size_t pixelCount = size_t(image_width) * image_height;
+    const float sampleWeight = 1.0f / SamplesPerPixel;
+    // only the region is rendered, the priority part of it first
+    const PixelRect region = Region.Clamp(image_width, image_height);
+    const bool prioritized = !PriorityRegion.Empty() && PriorityRegion.Overlaps(region.x, region.y, region.x + region.width, region.y + region.height);
+    const PixelRect priority = PriorityRegion.Clamp(image_width, image_height);
+    // rays only draw a time when something moves while the shutter is open
+    const bool motion = SpherePrimitives.motionSteps > 0 || CubePrimitives.motionSteps > 0;
 
-    Color32* image = (Color32*)malloc(image_width * image_height * sizeof(Color));
+    ContentHash hash = SceneHash();
+    hash.Add(image_width); hash.Add(image_height);
+    hash.Add(view.origin); hash.Add(view.horizontal); hash.Add(view.vertical); hash.Add(view.lowerLeftCorner);
+    hash.Add(SamplesPerPixel); // the feature weights depend on it
+    hash.Add(region.x); hash.Add(region.y); hash.Add(region.width); hash.Add(region.height);
+    if (prioritized) { hash.Add(priority.x); hash.Add(priority.y); hash.Add(priority.width); hash.Add(priority.height); }
 
-    for (int j = image_height - 1; j >= 0; --j) {
-        for (int i = 0; i < image_width; ++i) {
-            auto u = float(i) / (image_width - 1);
-            auto v = float(j) / (image_height - 1);
-            Ray r = Ray(origin, lower_left_corner + (horizontal * u) + (vertical * v) - origin);
-            image[((image_height - j) * image_width) + i] = RayColor(r, MaxDepth).ConvertToColor32();
+    Progress.Resize(image_width, image_height);
+    Progress.sceneHash = hash.value;
+    if (ResumeFromCheckpoint && !CheckpointPath.empty() && Checkpoint::Load(CheckpointPath, Progress))
+    {
+        std::istringstream sampler(Progress.sampler);
+        sampler >> Sampler;
+    }
+    ResumeFromCheckpoint = false; // only the first frame continues where the last run stopped
+
+    // the tiles that touch the region, in phases of SamplesPerPixel passes each. with a priority region the
+    // tiles that touch it are the first phase and the rest of the region the second, otherwise there is one
+    constexpr int TileSize = Framebuffer<Color>::TileSize;
+    const int tilesX = (image_width + TileSize - 1) / TileSize;
+    const int tilesY = (image_height + TileSize - 1) / TileSize;
+    int* tiles = frameArena.Allocate<int>(size_t(tilesX) * tilesY);
+    int phaseStart[3] = { 0, 0, 0 };
+    size_t phasePixels[2] = { 0, 0 };
+    const int phaseCount = prioritized ? 2 : 1;
+    for (int phase = 0; phase < phaseCount; ++phase)
+    {
+        int scheduled = phaseStart[phase];
+        for (int tile = 0; tile < tilesX * tilesY; ++tile)
+        {
+            const int x0 = (tile % tilesX) * TileSize, y0 = (tile / tilesX) * TileSize;
+            const int x1 = Min(x0 + TileSize, image_width), y1 = Min(y0 + TileSize, image_height);
+            if (!region.Overlaps(x0, y0, x1, y1)) continue;
+            if (prioritized && priority.Overlaps(x0, y0, x1, y1) != (phase == 0)) continue;
+            tiles[scheduled++] = tile;
+            phasePixels[phase] += size_t(Min(x1, region.x + region.width) - Max(x0, region.x)) * (Min(y1, region.y + region.height) - Max(y0, region.y));
         }
+        phaseStart[phase + 1] = scheduled;
     }
-	stbi_write_jpg("export.jpg", image_width, image_height, 4, image, 900);
-    free(image);
+
+    // resolves the region, denoises it and hands it to the writer, in the full frame or cropped to the region.
+    // pixels without samples stay black
+    auto submitImage = [&](bool denoise)
+    {
+        const bool expand = !CropToRegion && (region.width != image_width || region.height != image_height);
+        const int outputWidth = expand ? image_width : region.width, outputHeight = expand ? image_height : region.height;
+
+        // float formats are resolved straight into the writer's radiance buffer, 8 bit ones into the frame arena for the
+        // tonemapper. encoding happens on the writer thread, acquiring only waits if both output buffers are still queued
+        OutputImage* image = nullptr;
+        Color* output;
+        if (ImageWriter::IsFloatFormat(OutputPath))
+        {
+            image = Output.AcquireBuffer();
+            image->width = outputWidth;
+            image->height = outputHeight;
+            image->radiance.resize(size_t(outputWidth) * outputHeight);
+            output = image->radiance.data();
+        }
+        else output = frameArena.Allocate<Color>(size_t(outputWidth) * outputHeight);
+
+        Color* pixels = expand ? frameArena.Allocate<Color>(size_t(region.width) * region.height) : output;
+        Progress.accumulation.ToScanlines(pixels, region.x, region.y, region.width, region.height, [](const Color& sum, size_t index)
+        {
+            const uint32_t count = Progress.sampleCounts.Data()[index];
+            return count > 0 ? sum * (1.0f / count) : Color(0.0f);
+        });
+
+        if (denoise)
+        {
+            FrameDenoiser.Denoise(region.width, region.height, pixels, Progress.features, pixels, region.x, region.y);
+            printf("denoiser: %dx%d, %d iterations, %.2f ms on %d threads\n", region.width, region.height,
+                   FrameDenoiser.lastIterations, FrameDenoiser.lastMilliseconds, JobSystem::Pool.ThreadCount());
+        }
+
+        if (expand)
+        {
+            std::fill(output, output + pixelCount, Color(0.0f));
+            for (int y = 0; y < region.height; ++y)
+                memcpy(output + size_t(region.y + y) * image_width + region.x, pixels + size_t(y) * region.width, region.width * sizeof(Color));
+        }
+
+        if (!image)
+        {
+            image = Output.AcquireBuffer();
+            image->Resize(outputWidth, outputHeight);
+            FrameTonemapper.Convert(outputWidth, outputHeight, output, image->pixels.data());
+        }
+        image->path = OutputPath;
+        image->quality = OutputQuality;
+        // writer allocations happen on its own thread after this and are not the frame's
+        LastFrameAllocations = Memory::HeapAllocations() - allocationsAtStart;
+        Output.Submit(image);
+    };
+
+    // samples are taken in passes over the scheduled tiles so a checkpoint always holds complete passes.
+    // a pass walks them in the order the buffers are stored in
+    const int passCount = phaseCount * SamplesPerPixel;
+    const auto frameStart = std::chrono::steady_clock::now();
+    auto lastCheckpoint = frameStart;
+    double traceSeconds = 0.0;
+    RayStats::Collect(); // rays traced outside of frames are not this frame's
+    for (int pass = Progress.nextSample; pass < passCount; ++pass) {
+        const int phase = pass / SamplesPerPixel;
+        const int s = pass % SamplesPerPixel;
+        const auto passStart = std::chrono::steady_clock::now();
+        Trace::Scope passScope("sample pass");
+        auto renderTile = [&](int scheduled) {
+            Trace::Scope tileScope("tile");
+            const int tile = tiles[phaseStart[phase] + scheduled];
+            const int tileX = (tile % tilesX) * TileSize;
+            const int tileY = (tile / tilesX) * TileSize;
+            const int beginY = Max(tileY, region.y), endY = Min(tileY + TileSize, region.y + region.height);
+            const int beginX = Max(tileX, region.x), endX = Min(tileX + TileSize, region.x + region.width);
+            for (int y = beginY; y < endY; ++y) {
+                // y counts rows top down, j bottom up like the viewport
+                const int j = image_height - 1 - y;
+                for (int i = beginX; i < endX; ++i) {
+                    // every progress buffer has the same layout, one index addresses all of them
+                    const size_t index = Progress.accumulation.Index(i, y);
+                    if (DeterministicSampling) PixelStream.Seed(size_t(y) * image_width + i, s);
+                    auto u = (i + RandomFloat()) / (image_width - 1);
+                    auto v = (j + RandomFloat()) / (image_height - 1);
+                    Ray r = view.At(u, v);
+                    if (motion) r.time = float(RandomFloat());
+                    const FeatureSample features { index, sampleWeight };
+                    Progress.accumulation.Data()[index] += RayColor(r, MaxDepth, 0.0f, DenoiseOutput ? &features : nullptr);
+                    Progress.sampleCounts.Data()[index]++;
+                }
+            }
+        };
+        // a pixel belongs to one tile and takes its samples in pass order, so its sums come out the same on
+        // any number of threads. the shared mt19937 only allows one thread
+        const int tileCount = phaseStart[phase + 1] - phaseStart[phase];
+        if (DeterministicSampling) JobSystem::Pool.ParallelFor(tileCount, renderTile);
+        else for (int tile = 0; tile < tileCount; ++tile) renderTile(tile);
+        Progress.nextSample = pass + 1;
+        RayStats::Add(RayCounter::PrimaryRays, phasePixels[phase]);
+
+        const auto now = std::chrono::steady_clock::now();
+        traceSeconds += std::chrono::duration<double>(now - passStart).count();
+        if (prioritized && pass + 1 == SamplesPerPixel)
+        {
+            // the priority region is complete, it is written right away and the whole frame replaces it later
+            submitImage(false);
+            printf("priority region: %dx%d done in %.1f ms, written to %s\n", priority.width, priority.height,
+                   std::chrono::duration<float, std::milli>(now - frameStart).count(), OutputPath.c_str());
+        }
+        if (!CheckpointPath.empty() && pass + 1 < passCount && std::chrono::duration<float>(now - lastCheckpoint).count() >= CheckpointInterval)
+        {
+            SaveCheckpoint();
+            lastCheckpoint = now;
+        }
+    }
+
+    // the checkpoint is done with once the frame is complete
+    if (!CheckpointPath.empty()) remove(CheckpointPath.c_str());
+
+    if constexpr (RayStats::Enabled)
+    {
+        const RayStats::Counters statistics = RayStats::Collect();
+        RayStats::Log(statistics, traceSeconds);
+        if (!StatisticsPath.empty()) RayStats::WriteJson(StatisticsPath.c_str(), statistics, traceSeconds, region.width, region.height, SamplesPerPixel, DeterministicSampling ? JobSystem::Pool.ThreadCount() : 1);
+    }
+
+    submitImage(DenoiseOutput);
+
+    if (TextureSystem::Cache.TextureCount() > 0) TextureSystem::Cache.LogStatistics();
 }
@@ -3,5 +3,78 @@
 namespace RayTracer
 {
 	void Initialize();
+	// equirectangular .hdr used for escaping rays and light sampling instead of the gradient
+	bool LoadEnvironment(const char* hdrPath);
+	// tiled, mip mapped texture streamed through the texture cache, returns the id spheres refer to or -1
+	int LoadTexture(const char* path);
+	// binary scene with the sphere bvh prebuilt, replaces the current scene and is traced straight from the mapped file
+	bool LoadScene(const char* path);
+	// json scene description (see JsonScene.hpp) with camera and render settings, replaces the current scene
+	bool LoadJsonScene(const char* path);
+	// writes the current scene in the format LoadScene reads
+	bool ExportScene(const char* path);
+	// one of the generated benchmark scenes of SceneCorpus.hpp by name, replaces the current scene
+	bool LoadCorpusScene(const char* name);
+	// renders every corpus scene at a fixed size and sample count and compares its time and image with the baseline in
+	// directory, false when one got slower than tolerance (0.1 is 10% less throughput) or its image changed.
+	// updateBaseline renders and stores a new baseline instead
+	bool BenchmarkCorpus(const char* directory, float tolerance = 0.1f, bool updateBaseline = false);
+	// cold (page cache dropped where the os allows it) and warm time from LoadScene to the first traced rays
+	void BenchmarkSceneStartup(const char* path);
+	// renders a few corpus scenes where they were made and again moved distance away along every axis, once with
+	// float world coordinates and once in large world mode, and logs the time and the difference to the first image
+	bool BenchmarkLargeWorld(const char* directory, double distance = 10000.0);
+	// 400x225 by default
+	void SetResolution(int width, int height);
+	// samples are averaged before the denoiser runs, 8 - 16 is enough with denoising on
+	void SetSamplesPerPixel(int samples);
+	// edge avoiding a-trous filter guided by first hit albedo, normal and depth, on by default
+	void SetDenoise(bool enabled);
+	// every pixel sample draws from its own random stream and tiles are spread over the job system, the image is
+	// bit identical for any thread count and run. off by default, then one thread renders from the shared sampler
+	void SetDeterministic(bool enabled);
+	// renders only the pixels of a rectangle, x and y from the top left of the image. the output is the full image
+	// with black around the rectangle, or with crop just the rectangle. a width or height of 0 renders everything again
+	void SetRegion(int x, int y, int width, int height, bool crop = false);
+	// renders every sample of the tiles that touch the rectangle before the rest of the frame and writes the image
+	// as soon as they are done, the complete frame replaces it at the end. a width or height of 0 turns it off
+	void SetPriorityRegion(int x, int y, int width, int height);
+	// threads of the job system including the calling one, 0 for every hardware thread
+	void SetThreads(int count);
+	// 8 bit outputs go through exposure in stops, a tone curve ("aces", "reinhard" or "none") and sRGB encoding
+	// with an ordered dither, aces at 0 stops with dither by default. false for an unknown curve
+	bool SetTonemap(const char* curve, float exposure = 0.0f, bool dither = true);
+	// debug mode, RenderFrame traces one ray per pixel and shows the bvh nodes plus primitives it took in false color.
+	// with countsPath the raw counts are also written there as a float image (pfm or exr)
+	void SetHeatmap(bool enabled, const char* countsPath = nullptr);
+	// jpg, png, bmp, tga or lossless float pfm/exr by extension, frames are written on a background thread
+	void SetOutput(const char* path, int quality = 90);
+	// ray counts and throughput of every frame are logged, with a path they are also written there as json.
+	// nothing is counted when RAY_STATISTICS is defined to 0
+	void SetStatisticsOutput(const char* path);
+	// records bvh builds, tiles, denoising, tone mapping, image writes and thread pool jobs on every thread,
+	// FinishOutput writes them to path as chrome trace json for chrome://tracing or ui.perfetto.dev
+	void SetTrace(const char* path);
+	// waits until every rendered frame is written, call before exiting
+	void FinishOutput();
+	// saves the frame in progress to path every intervalSeconds, a crashed or preempted render started again
+	// with resume continues at the sample it stopped at and ends with the same image as an uninterrupted run
+	void SetCheckpoint(const char* path, float intervalSeconds = 60.0f, bool resume = false);
+	// built sphere bvhs are stored in directory and mapped again when the same geometry comes back, null turns it off.
+	// call before Initialize or LoadScene, "bvhcache" by default
+	void SetBVHCache(const char* directory);
 	void RenderFrame();
+	// renders frames one after another and logs time and heap allocations per frame, only the first should allocate
+	void BenchmarkFrames(int frames);
+	// renders count frames of the scene animation from first, 0 for all that follow, to the numbered paths of its
+	// output pattern. the next frame is posed and its sphere bvh refit on another thread while one renders.
+	// refitting keeps the tree of the first frame, it slows down as primitives travel far from where they started
+	bool RenderAnimation(int first = 0, int count = 0);
+	// animation frames keep the shutter open for shutter frames (0.5 is a 180 degree shutter) and blur what moves
+	// meanwhile, 0 turns it off. moving primitives follow segments straight pieces of their path over it, and
+	// the bvh bounds them where they are at the ray time instead of everywhere they go. the camera does not blur
+	void SetMotionBlur(float shutter, int segments = 1);
+	// json scenes placed far from the origin are traced in float around their camera instead, every primitive is
+	// moved there in double when the scene loads. binary scenes are float already and are not moved. off by default
+	void SetLargeWorld(bool enabled);
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "SceneCorpus.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+AMATH_NAMESPACE
+
+namespace SceneCorpus
+{
+    // std::uniform_real_distribution may differ between standard libraries, the raw mt19937 output does not
+    struct Random
+    {
+        std::mt19937 generator;
+
+        explicit Random(uint32_t seed) : generator(seed) {}
+        float Float() { return (generator() >> 8) * (1.0f / 16777216.0f); }
+        float Float(float min, float max) { return min + (max - min) * Float(); }
+        Color Emission(float min, float max) { return Color(Float(min, max), Float(min, max), Float(min, max)); }
+    };
+
+    static void Default(SceneDescription& scene)
+    {
+        Random random(1);
+        scene.SetCamera(Camera()); // the default camera, not the one of the scene before
+        scene.spheres.Add(Vector3(0.0f, 0.0f, -1.0f), 0.5f, -1);
+        scene.spheres.Add(Vector3(0.0f, -100.5f, -1.0f), 100.0f, -1);
+        const Quaternion orientation = Quaternion::FromEuler(0.0f, 0.6f, 0.0f);
+        scene.AddCube(Cube(Vector3(-0.2f), Vector3(0.2f), Matrix4::FromQuaternion(orientation) * Matrix4::FromPosition(1.0f, -0.3f, -1.4f)),
+                      Matrix4d::FromQuaternion(orientation) * Matrix4d::FromPosition(1.0, -0.3, -1.4));
+        for (int z = 0; z < 32; ++z)
+        {
+            for (int x = 0; x < 32; ++x)
+            {
+                const Color emission(random.Float(2.0f, 6.0f), random.Float(1.5f, 4.0f), random.Float(0.5f, 2.0f));
+                scene.lights.push_back(Light(Vector3(-4.0f + x * 0.25f, -0.45f, -6.0f + z * 0.2f), 0.01f, emission));
+            }
+        }
+    }
+
+    static void Weekend(SceneDescription& scene)
+    {
+        Random random(2);
+        scene.SetCamera(Camera(Vector3(13.0f, 2.0f, 3.0f), Vector3::Zero(), Vector3::Up(), 20.0f));
+        scene.spheres.Add(Vector3(0.0f, -1000.0f, 0.0f), 1000.0f, -1);
+        const Vector3 big[3] = { Vector3(-4.0f, 1.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), Vector3(4.0f, 1.0f, 0.0f) };
+        for (const Vector3& center : big) scene.spheres.Add(center, 1.0f, -1);
+
+        // small spheres resting on the ground, none inside the big ones
+        int placed = 0;
+        while (placed < 500)
+        {
+            const float radius = random.Float(0.1f, 0.25f);
+            const Vector3 center(random.Float(-11.0f, 11.0f), radius, random.Float(-11.0f, 11.0f));
+            bool free = true;
+            for (const Vector3& other : big) free &= Vector3::Distance(center, other) > 1.0f + radius;
+            if (!free) continue;
+            scene.spheres.Add(center, radius, -1);
+            ++placed;
+        }
+        scene.lights.push_back(Light(Vector3(0.0f, 8.0f, 4.0f), 0.5f, Color(40.0f)));
+    }
+
+    static void Cloud(SceneDescription& scene)
+    {
+        Random random(3);
+        constexpr int Count = 1000000;
+        scene.SetCamera(Camera(Vector3(0.0f, 0.5f, 3.0f), Vector3::Zero(), Vector3::Up(), 45.0f));
+        scene.spheres.Reserve(Count);
+        while (int(scene.spheres.Count()) < Count)
+        {
+            const Vector3 center(random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f));
+            if (center.LengthSquared() > 1.0f) continue;
+            scene.spheres.Add(center, random.Float(0.002f, 0.006f), -1);
+        }
+        scene.lights.push_back(Light(Vector3(2.0f, 3.0f, 2.0f), 0.3f, Color(60.0f)));
+    }
+
+    static void Mesh(SceneDescription& scene)
+    {
+        // the tracer has no triangles, a surface tessellated into tiny spheres has the same shape of work:
+        // a huge number of small primitives packed on a thin shell that rays mostly graze
+        constexpr int Around = 1000, Tube = 400;
+        constexpr float Radius = 1.0f, TubeRadius = 0.35f;
+        scene.SetCamera(Camera(Vector3(0.0f, 1.2f, 3.0f), Vector3::Zero(), Vector3::Up(), 45.0f));
+        scene.spheres.Reserve(size_t(Around) * Tube);
+
+        // tilted around x towards the camera
+        const float tiltSin = sinf(0.6f), tiltCos = cosf(0.6f);
+        for (int i = 0; i < Around; ++i)
+        {
+            const float u = TwoPI * i / Around;
+            for (int j = 0; j < Tube; ++j)
+            {
+                const float v = TwoPI * j / Tube;
+                const float ring = Radius + TubeRadius * cosf(v);
+                const float y = TubeRadius * sinf(v), z = ring * sinf(u);
+                scene.spheres.Add(Vector3(ring * cosf(u), y * tiltCos - z * tiltSin, y * tiltSin + z * tiltCos), 0.006f, -1);
+            }
+        }
+        scene.AddPlane(Vector3::Up(), Vector3d(0.0, -0.8, 0.0), -1);
+        scene.lights.push_back(Light(Vector3(-2.0f, 3.0f, 2.0f), 0.3f, Color(60.0f)));
+    }
+
+    static void Lights(SceneDescription& scene)
+    {
+        Random random(5);
+        constexpr int Side = 256;
+        constexpr float Extent = 16.0f;
+        scene.SetCamera(Camera(Vector3(0.0f, 3.0f, 12.0f), Vector3::Zero(), Vector3::Up(), 50.0f));
+        scene.AddPlane(Vector3::Up(), Vector3d::Zero(), -1);
+        for (int z = 0; z < 16; ++z)
+        {
+            for (int x = 0; x < 16; ++x) scene.spheres.Add(Vector3(-Extent + (x + 0.5f) * 2.0f, 0.3f, -Extent + (z + 0.5f) * 2.0f), 0.3f, -1);
+        }
+
+        scene.lights.reserve(size_t(Side) * Side);
+        for (int z = 0; z < Side; ++z)
+        {
+            for (int x = 0; x < Side; ++x)
+            {
+                const Vector3 position(-Extent + (x + random.Float()) * (2.0f * Extent / Side), 0.05f, -Extent + (z + random.Float()) * (2.0f * Extent / Side));
+                scene.lights.push_back(Light(position, 0.01f, random.Emission(0.5f, 4.0f)));
+            }
+        }
+    }
+
+    bool Generate(const char* name, SceneDescription& scene)
+    {
+        using Generator = void (*)(SceneDescription&);
+        constexpr Generator Generators[] = { Default, Weekend, Cloud, Mesh, Lights };
+        static_assert(sizeof(Generators) / sizeof(Generators[0]) == sizeof(Names) / sizeof(Names[0]), "a generator for every name");
+
+        for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); ++i)
+        {
+            if (strcmp(name, Names[i]) != 0) continue;
+            scene = SceneDescription();
+            Generators[i](scene);
+            return true;
+        }
+        printf("scene corpus: unknown scene %s\n", name);
+        return false;
+    }
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,20 @@
+#pragma once
+#include "JsonScene.hpp"
+
+AMATH_NAMESPACE
+
+// procedurally generated benchmark scenes, the same on every run and every machine:
+//   default - the two spheres, box and street lights of Initialize
+//   weekend - a "ray tracing in one weekend" field of 500 spheres around three big ones
+//   cloud   - one million small spheres in a ball, a bvh far bigger than the caches
+//   mesh    - a torus tessellated into 400k tiny spheres, many small primitives on a thin shell
+//   lights  - 65536 small lights over a ground plane, stresses the light bvh and shadow rays
+namespace SceneCorpus
+{
+	constexpr const char* Names[] = { "default", "weekend", "cloud", "mesh", "lights" };
+
+	// replaces scene with the named one, false for a name that is not above
+	bool Generate(const char* name, SceneDescription& scene);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,253 @@
+#include "SceneFile.hpp"
+#include <chrono>
+#include <cstring>
+
+AMATH_NAMESPACE
+
+constexpr uint32_t SceneFileMagic = 0x4E435341; // "ASCN"
+constexpr uint32_t SceneFileVersion = 1;
+constexpr size_t SceneFileAlignment = 64;
+
+struct SceneFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sectionCount;
+	uint32_t reserved;
+	uint64_t fileSize;
+};
+
+// fixed layouts for the primitives that are copied out, independent of the classes' vtables and padding
+struct CubeRecord
+{
+	float min[3], max[3];
+	float worldToLocal[16];
+	int texture;
+};
+
+struct PlaneRecord
+{
+	float normal[3];
+	float distance;
+	int texture;
+};
+
+struct LightRecord
+{
+	float center[3];
+	float radius;
+	float emission[4];
+};
+
+static size_t SectionRecordSize(SceneSection section)
+{
+    switch (section)
+    {
+    case SceneSection::SphereBVH: return sizeof(BVHNode);
+    case SceneSection::Cubes: return sizeof(CubeRecord);
+    case SceneSection::Planes: return sizeof(PlaneRecord);
+    case SceneSection::Lights: return sizeof(LightRecord);
+    default: return 1;
+    }
+}
+
+static size_t AlignSection(size_t offset) { return (offset + SceneFileAlignment - 1) & ~(SceneFileAlignment - 1); }
+
+bool SceneFile::Write(const char* path, const SceneContents& contents)
+{
+    const SpherePack& spheres = *contents.spheres;
+    const size_t lanes = SpherePack::PaddedLanes(spheres.Count());
+
+    std::string textureBlob;
+    for (const std::string& texture : *contents.textures) textureBlob.append(texture.c_str(), texture.size() + 1);
+
+    // what goes into every section, in table order
+    struct Source { const void* data; size_t bytes; uint32_t count; };
+    std::vector<CubeRecord> cubes(contents.cubes->size());
+    std::vector<PlaneRecord> planes(contents.planes->size());
+    std::vector<LightRecord> lights(contents.lights->size());
+    const Source sources[] =
+    {
+        { spheres.centerX.data, lanes * sizeof(float), uint32_t(spheres.Count()) },
+        { spheres.centerY.data, lanes * sizeof(float), uint32_t(spheres.Count()) },
+        { spheres.centerZ.data, lanes * sizeof(float), uint32_t(spheres.Count()) },
+        { spheres.radius.data,  lanes * sizeof(float), uint32_t(spheres.Count()) },
+        { spheres.texture.data, lanes * sizeof(int),   uint32_t(spheres.Count()) },
+        { spheres.bvh.nodes, size_t(spheres.bvh.nodeCount) * sizeof(BVHNode), uint32_t(spheres.bvh.nodeCount) },
+        { cubes.data(),  cubes.size() * sizeof(CubeRecord),   uint32_t(cubes.size()) },
+        { planes.data(), planes.size() * sizeof(PlaneRecord), uint32_t(planes.size()) },
+        { lights.data(), lights.size() * sizeof(LightRecord), uint32_t(lights.size()) },
+        { textureBlob.data(), textureBlob.size(), uint32_t(contents.textures->size()) },
+    };
+    static_assert(sizeof(sources) / sizeof(Source) == size_t(SceneSection::Count), "every section needs a source");
+
+    for (size_t i = 0; i < cubes.size(); ++i)
+    {
+        const Cube& cube = (*contents.cubes)[i];
+        CubeRecord& record = cubes[i];
+        for (int axis = 0; axis < 3; ++axis) { record.min[axis] = cube.min.arr[axis]; record.max[axis] = cube.max.arr[axis]; }
+        memcpy(record.worldToLocal, cube.worldToLocal.m, sizeof(record.worldToLocal));
+        record.texture = cube.texture;
+    }
+    for (size_t i = 0; i < planes.size(); ++i)
+    {
+        const Plane& plane = (*contents.planes)[i];
+        planes[i] = { { plane.normal.x, plane.normal.y, plane.normal.z }, plane.distance, plane.texture };
+    }
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        const Light& light = (*contents.lights)[i];
+        lights[i] = { { light.center.x, light.center.y, light.center.z }, light.radius,
+                      { light.emission.r, light.emission.g, light.emission.b, light.emission.a } };
+    }
+
+    Section table[size_t(SceneSection::Count)] = {};
+    size_t offset = AlignSection(sizeof(SceneFileHeader) + sizeof(table));
+    for (size_t i = 0; i < size_t(SceneSection::Count); ++i)
+    {
+        table[i].offset = offset;
+        table[i].bytes = sources[i].bytes;
+        table[i].count = sources[i].count;
+        offset = AlignSection(offset + sources[i].bytes);
+    }
+
+    SceneFileHeader header = {};
+    header.magic = SceneFileMagic;
+    header.version = SceneFileVersion;
+    header.sectionCount = uint32_t(SceneSection::Count);
+    header.fileSize = offset;
+
+    const std::string temporaryPath = std::string(path) + ".tmp";
+    {
+        MappedFile output;
+        if (!output.Create(temporaryPath.c_str(), offset)) return false;
+        memcpy(output.Data(), &header, sizeof(header));
+        memcpy(output.Data() + sizeof(header), table, sizeof(table));
+        for (size_t i = 0; i < size_t(SceneSection::Count); ++i)
+        {
+            if (sources[i].bytes && sources[i].data) memcpy(output.Data() + table[i].offset, sources[i].data, sources[i].bytes);
+        }
+        if (!output.Flush()) return false;
+    }
+    return MappedFile::ReplaceAtomically(temporaryPath, path);
+}
+
+bool SceneFile::Open(const char* path)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    Close();
+    if (!file.OpenRead(path) || file.Size() < sizeof(SceneFileHeader)) return false;
+
+    const SceneFileHeader& header = *file.As<SceneFileHeader>();
+    const size_t tableEnd = sizeof(SceneFileHeader) + size_t(SceneSection::Count) * sizeof(Section);
+    if (header.magic != SceneFileMagic || header.version != SceneFileVersion || header.sectionCount != uint32_t(SceneSection::Count) ||
+        header.fileSize != file.Size() || file.Size() < tableEnd)
+    {
+        printf("scene file: %s is not a version %u scene\n", path, SceneFileVersion);
+        Close();
+        return false;
+    }
+
+    // only the table is checked, the sections are used as they are without a pass over them
+    sections = file.As<Section>(sizeof(SceneFileHeader));
+    const uint32_t sphereCount = sections[uint32_t(SceneSection::SphereCenterX)].count;
+    for (uint32_t i = 0; i < uint32_t(SceneSection::Count); ++i)
+    {
+        const Section& section = sections[i];
+        bool valid = section.offset % SceneFileAlignment == 0 && section.bytes <= file.Size() && section.offset <= file.Size() - section.bytes;
+        if (i <= uint32_t(SceneSection::SphereTexture))
+        {
+            valid = valid && section.count == sphereCount && section.bytes >= SpherePack::PaddedLanes(sphereCount) * sizeof(float);
+        }
+        else if (i == uint32_t(SceneSection::Textures))
+        {
+            // every path takes at least its terminator, and the last one has to end inside the section
+            valid = valid && section.count <= section.bytes && (section.count == 0 || file.Data()[section.offset + section.bytes - 1] == '\0');
+        }
+        else
+        {
+            valid = valid && uint64_t(section.count) * SectionRecordSize(SceneSection(i)) <= section.bytes;
+        }
+        if (!valid)
+        {
+            printf("scene file: %s has a broken section table\n", path);
+            Close();
+            return false;
+        }
+    }
+
+    openMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
+void SceneFile::ViewSpheres(SpherePack& pack) const
+{
+    uint32_t count, nodeCount;
+    const float* centerX = SectionData<float>(SceneSection::SphereCenterX, count);
+    const float* centerY = SectionData<float>(SceneSection::SphereCenterY, count);
+    const float* centerZ = SectionData<float>(SceneSection::SphereCenterZ, count);
+    const float* radius = SectionData<float>(SceneSection::SphereRadius, count);
+    const int* texture = SectionData<int>(SceneSection::SphereTexture, count);
+    const BVHNode* nodes = SectionData<BVHNode>(SceneSection::SphereBVH, nodeCount);
+    pack.View(int(count), centerX, centerY, centerZ, radius, texture, nodes, int(nodeCount));
+}
+
+void SceneFile::ReadCubes(std::vector<Cube>& cubes) const
+{
+    uint32_t count;
+    const CubeRecord* records = SectionData<CubeRecord>(SceneSection::Cubes, count);
+    cubes.clear();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const CubeRecord& record = records[i];
+        Cube cube(Vector3(record.min[0], record.min[1], record.min[2]), Vector3(record.max[0], record.max[1], record.max[2]));
+        memcpy(cube.worldToLocal.m, record.worldToLocal, sizeof(record.worldToLocal));
+        cube.texture = record.texture;
+        cubes.push_back(cube);
+    }
+}
+
+void SceneFile::ReadPlanes(std::vector<Plane>& planes) const
+{
+    uint32_t count;
+    const PlaneRecord* records = SectionData<PlaneRecord>(SceneSection::Planes, count);
+    planes.clear();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const PlaneRecord& record = records[i];
+        Plane plane;
+        plane.normal = Vector3(record.normal[0], record.normal[1], record.normal[2]);
+        plane.distance = record.distance;
+        plane.texture = record.texture;
+        planes.push_back(plane);
+    }
+}
+
+void SceneFile::ReadLights(std::vector<Light>& lights) const
+{
+    uint32_t count;
+    const LightRecord* records = SectionData<LightRecord>(SceneSection::Lights, count);
+    lights.clear();
+    lights.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const LightRecord& record = records[i];
+        lights.push_back(Light(Vector3(record.center[0], record.center[1], record.center[2]), record.radius,
+                               Color(record.emission[0], record.emission[1], record.emission[2], record.emission[3])));
+    }
+}
+
+void SceneFile::ReadTextures(std::vector<std::string>& paths) const
+{
+    uint32_t count;
+    const char* blob = SectionData<char>(SceneSection::Textures, count);
+    const char* end = blob + sections[uint32_t(SceneSection::Textures)].bytes;
+    paths.clear();
+    for (uint32_t i = 0; i < count && blob < end; ++i)
+    {
+        paths.push_back(blob);
+        blob += paths.back().size() + 1;
+    }
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,68 @@
+#pragma once
+#include "Intersection.hpp"
+#include "LightBVH.hpp"
+#include "MappedFile.hpp"
+#include <string>
+
+AMATH_NAMESPACE
+
+// binary scene container: a header, a section table and sections that each start on a cache line.
+// the sphere arrays and their BVH are stored exactly as SpherePack keeps them in memory, so a mapped file
+// is traced in place. cubes, planes and lights are small and copied out, textures are stored as paths
+enum class SceneSection : uint32_t
+{
+	SphereCenterX, SphereCenterY, SphereCenterZ, SphereRadius, SphereTexture, SphereBVH,
+	Cubes, Planes, Lights, Textures,
+	Count
+};
+
+struct SceneContents
+{
+	const SpherePack* spheres = nullptr;
+	const std::vector<Cube>* cubes = nullptr;
+	const std::vector<Plane>* planes = nullptr;
+	const std::vector<Light>* lights = nullptr;
+	const std::vector<std::string>* textures = nullptr;
+};
+
+class SceneFile
+{
+public:
+	float openMilliseconds = 0.0f;
+
+	static bool Write(const char* path, const SceneContents& contents);
+
+	// maps and validates the file, the mapping stays until Close or the next Open
+	bool Open(const char* path);
+	void Close() { file.Close(); sections = nullptr; }
+	bool IsOpen() const { return file.IsOpen(); }
+	size_t Size() const { return file.Size(); }
+
+	// points pack at the mapped arrays, no copy
+	void ViewSpheres(SpherePack& pack) const;
+	void ReadCubes(std::vector<Cube>& cubes) const;
+	void ReadPlanes(std::vector<Plane>& planes) const;
+	void ReadLights(std::vector<Light>& lights) const;
+	void ReadTextures(std::vector<std::string>& paths) const;
+
+private:
+	struct Section
+	{
+		uint64_t offset;
+		uint64_t bytes;
+		uint32_t count;
+		uint32_t reserved;
+	};
+
+	MappedFile file;
+	const Section* sections = nullptr;
+
+	template<typename T> const T* SectionData(SceneSection section, uint32_t& count) const
+	{
+		const Section& entry = sections[uint32_t(section)];
+		count = entry.count;
+		return file.As<T>(entry.offset);
+	}
+};
+
+AMATH_END_NAMESPACE
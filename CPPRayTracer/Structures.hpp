@@ -1,33 +1,97 @@
 #pragma once
 #include "Math/Vector3.hpp"
+#include "Math/Matrix4.hpp"
+#include <cfloat>
 
 AMATH_NAMESPACE
 
+// closest hit distance accepted. rays leaving a surface start off it through OffsetRayOrigin instead of
+// skipping a fixed distance, which is too short far from the origin and longer than small primitives close to it
+constexpr float RayTMin = 0.0f;
+
+FINLINE float MaxMagnitude(const Vector3& v) { return Max(fabsf(v.x), Max(fabsf(v.y), fabsf(v.z))); }
 
 struct Ray
 {
 	Vector3 origin;
 	Vector3 direction;
+	float time = 0.0f; // when in the open shutter the ray travels, 0 to 1, only moving primitives look at it
 
-	Ray(const Vector3& _origin, const Vector3& _direction) : origin(_origin), direction(_direction) {}
+	Ray(const Vector3& _origin, const Vector3& _direction, float _time = 0.0f) : origin(_origin), direction(_direction), time(_time) {}
 
 	Vector3 At(float t) const { return origin + (direction * t); }
 };
 
+struct AABB
+{
+	Vector3 min;
+	Vector3 max;
+
+	AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+	AABB(const Vector3& _min, const Vector3& _max) : min(_min), max(_max) {}
+
+	FINLINE bool IsEmpty() const { return min.x > max.x; }
+	FINLINE Vector3 Center()   const { return (min + max) * 0.5f; }
+	FINLINE Vector3 Diagonal() const { return max - min; }
+
+	FINLINE float SurfaceArea() const
+	{
+		if (IsEmpty()) return 0.0f;
+		Vector3 d = Diagonal();
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	FINLINE int LongestAxis() const
+	{
+		Vector3 d = Diagonal();
+		return d.x > d.y ? (d.x > d.z ? 0 : 2) : (d.y > d.z ? 1 : 2);
+	}
+
+	FINLINE void Grow(const Vector3& point)
+	{
+		min = Vector3(Min(min.x, point.x), Min(min.y, point.y), Min(min.z, point.z));
+		max = Vector3(Max(max.x, point.x), Max(max.y, point.y), Max(max.z, point.z));
+	}
+
+	FINLINE void Grow(const AABB& other)
+	{
+		if (other.IsEmpty()) return;
+		Grow(other.min); Grow(other.max);
+	}
+
+	FINLINE static AABB Union(AABB a, const AABB& b) { a.Grow(b); return a; }
+};
+
 struct HitRecord
 {
 	Vector3 point;
 	Vector3 normal;
 	float t;
+	float u, v;
+	float uvPerUnit; // how fast uv changes per world unit, for mip selection
+	int texture; // -1 if the surface is untextured
 	bool frontFace;
+	float time; // of the ray that hit, rays leaving the surface are traced at the same time
+	// bound on how far point may be off the surface from rounding, in units of the values the hit test worked with
+	float error;
 
 	inline void SetFaceNormal(const Ray& ray, const Vector3& outwardNormal)
 	{
-		frontFace = Vector3::Dot(ray.direction, outwardNormal);
+		frontFace = Vector3::Dot(ray.direction, outwardNormal) < 0.0f;
 		normal = frontFace ? outwardNormal : outwardNormal * -1;
 	}
 }; 
 
+// where rays leaving a hit start: out along the normal by a bound on the rounding error of the point and of the tests
+// the next ray runs against the same surface, so it cannot hit that surface again. the idea of OffsetRayOrigin in pbrt
+// with one magnitude per hit instead of an error per axis
+FINLINE Vector3 OffsetRayOrigin(const HitRecord& record)
+{
+	// a few ulps of the point itself so the addition cannot round the offset away
+	const float distance = Max(record.error, MaxMagnitude(record.point)) * (16.0f * FLT_EPSILON);
+	return record.point + record.normal * distance;
+}
+
 class Hittable
 {
 public:
@@ -39,8 +103,9 @@ class Sphere final : Hittable
 public:
 	float radius;
 	Vector3 center;
-	Sphere() : radius(1), center(Vector3::Zero()) {}
-	Sphere(float _radius, const Vector3& _center) : radius(_radius), center(_center) {}
+	int texture;
+	Sphere() : radius(1), center(Vector3::Zero()), texture(-1) {}
+	Sphere(float _radius, const Vector3& _center, int _texture = -1) : radius(_radius), center(_center), texture(_texture) {}
 	
 	bool Hit(const Ray& ray, float t_max, HitRecord& record) const override
 	{
@@ -53,42 +118,150 @@ public:
 		float sqrtd = sqrtf(discriminant);
 
 		float root = (-half_b - sqrtd) / a;
-		constexpr float t_min = 0.001;
 		
-		if (root < t_min || t_max)
+		if (root < RayTMin || t_max < root)
 		{
 			root = (-half_b + sqrtd) / a;
-			if (root < t_min || t_max < root) return false;
+			if (root < RayTMin || t_max < root) return false;
 		}
 
-		record.t = root;
-		record.point = ray.At(record.t);
-		record.normal = (record.point - center) / radius;
+		FillRecord(ray, root, center, radius, texture, record);
 		return true;
 	}
+
+	static void FillRecord(const Ray& ray, float t, const Vector3& center, float radius, int texture, HitRecord& record)
+	{
+		record.t = t;
+		// back onto the surface, t is only as exact as the distance of the ray origin allows
+		const Vector3 outwardNormal = Vector3::Normalize(ray.At(t) - center);
+		record.point = center + outwardNormal * radius;
+		record.SetFaceNormal(ray, outwardNormal);
+		// longitude, latitude
+		record.u = (atan2f(-outwardNormal.z, outwardNormal.x) + PI) * (0.5f * OneDivPI);
+		record.v = acosf(Clamp(-outwardNormal.y, -1.0f, 1.0f)) * OneDivPI;
+		record.uvPerUnit = OneDivPI / radius;
+		record.texture = texture;
+		// |origin - center|^2 - radius^2 of the next test cancels down to the rounding of radius^2
+		record.error = MaxMagnitude(center) + radius;
+	}
 };
 
-class Cube : Hittable
+class Cube final : Hittable
 {
 public:
+	Vector3 min;
+	Vector3 max;
+	// the box is axis aligned in local space, identity for plain AABBs
+	Matrix4 worldToLocal;
+	int texture;
+
+	Cube() : min(-0.5f), max(0.5f), worldToLocal(Matrix4::Identity()), texture(-1) {}
+	Cube(const Vector3& _min, const Vector3& _max, int _texture = -1) : min(_min), max(_max), worldToLocal(Matrix4::Identity()), texture(_texture) {}
+	// oriented box, localToWorld places the local min/max box in the world
+	Cube(const Vector3& _min, const Vector3& _max, const Matrix4& localToWorld, int _texture = -1)
+		: min(_min), max(_max), worldToLocal(Matrix4::Inverse(localToWorld)), texture(_texture) {}
+
 	bool Hit(const Ray& ray, float t_max, HitRecord& record) const override
 	{
-	
+		const Vector4 origin = Matrix4::Vector3Transform(ray.origin, worldToLocal);
+		const Vector4 direction = Matrix4::Vector3TransformNormal(ray.direction, worldToLocal);
+
+		// branchless slab test, infinities from zero direction components fall out of min/max
+		const __m128 invDirection = _mm_div_ps(_mm_set1_ps(1.0f), direction.vec);
+		const __m128 t0 = _mm_mul_ps(_mm_sub_ps(min.vec(), origin.vec), invDirection);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(max.vec(), origin.vec), invDirection);
+		const Vector4 tSmall = _mm_min_ps(t0, t1);
+		const Vector4 tLarge = _mm_max_ps(t0, t1);
+
+		const float tNear = Max(tSmall.x, Max(tSmall.y, tSmall.z));
+		const float tFar  = Min(tLarge.x, Min(tLarge.y, tLarge.z));
+		// leave through the far side when the origin is inside
+		const float t = tNear > RayTMin ? tNear : tFar;
+		if (tNear > tFar || t <= RayTMin || t >= t_max) return false;
+
+		FillRecord(ray, t, min, max, worldToLocal, texture, record);
+		return true;
+	}
+
+	static void FillRecord(const Ray& ray, float t, const Vector3& min, const Vector3& max, const Matrix4& worldToLocal, int texture, HitRecord& record)
+	{
+		record.t = t;
+		record.point = ray.At(t);
+
+		const Vector4 local = Matrix4::Vector3Transform(record.point, worldToLocal);
+		const Vector3 halfExtent = (max - min) * 0.5f;
+		const Vector3 offset = (Vector3(local.x, local.y, local.z) - (min + max) * 0.5f) / halfExtent;
+
+		// the face is the axis the point is furthest along
+		const int axis = fabsf(offset.x) > fabsf(offset.y) ? (fabsf(offset.x) > fabsf(offset.z) ? 0 : 2) : (fabsf(offset.y) > fabsf(offset.z) ? 1 : 2);
+		const float sign = offset.arr[axis] > 0.0f ? 1.0f : -1.0f;
+		// normals go through the inverse transpose, which is the transpose of worldToLocal
+		const Vector3 outwardNormal = Vector3::Normalize(Vector3(worldToLocal.m[0][axis], worldToLocal.m[1][axis], worldToLocal.m[2][axis]) * sign);
+		record.SetFaceNormal(ray, outwardNormal);
+
+		const int uAxis = axis == 0 ? 1 : 0, vAxis = axis == 2 ? 1 : 2;
+		record.u = (offset.arr[uAxis] + 1.0f) * 0.5f;
+		record.v = (offset.arr[vAxis] + 1.0f) * 0.5f;
+		record.uvPerUnit = 0.5f / Max(halfExtent.arr[uAxis], halfExtent.arr[vAxis]);
+		record.texture = texture;
+		// the point is not moved back onto the face, the error of t from the ray origin stays in it
+		record.error = MaxMagnitude(ray.origin) + MaxMagnitude(Vector3(worldToLocal.m[3][0], worldToLocal.m[3][1], worldToLocal.m[3][2]));
 	}
 };
 
-class Plane : Hittable
+// infinite plane, dot(normal, x) = distance
+class Plane final : Hittable
 {
 public:
+	Vector3 normal;
+	float distance;
+	int texture;
+
+	Plane() : normal(Vector3::Up()), distance(0.0f), texture(-1) {}
+	Plane(const Vector3& _normal, const Vector3& point, int _texture = -1)
+		: normal(Vector3::Normalize(_normal)), distance(Vector3::Dot(Vector3::Normalize(_normal), point)), texture(_texture) {}
+
 	bool Hit(const Ray& ray, float t_max, HitRecord& record) const override
 	{
+		// parallel rays divide by zero, inf and nan fail the range test
+		const float t = (distance - Vector3::Dot(normal, ray.origin)) / Vector3::Dot(normal, ray.direction);
+		if (!(t > RayTMin && t < t_max)) return false;
+
+		FillRecord(ray, t, normal, distance, texture, record);
+		return true;
+	}
+
+	static void FillRecord(const Ray& ray, float t, const Vector3& normal, float distance, int texture, HitRecord& record)
+	{
+		record.t = t;
+		// back onto the plane, t is only as exact as the distance of the ray origin allows
+		record.point = ray.At(t);
+		record.point = record.point - normal * (Vector3::Dot(normal, record.point) - distance);
+		record.SetFaceNormal(ray, normal);
 
+		// planar mapping, one uv unit per world unit
+		const Vector3 helper = fabsf(normal.x) > 0.9f ? Vector3::Up() : Vector3::Right();
+		const Vector3 tangent = Vector3::Normalize(Vector3::Cross(helper, normal));
+		const Vector3 bitangent = Vector3::Cross(normal, tangent);
+		record.u = Vector3::Dot(record.point, tangent);
+		record.v = Vector3::Dot(record.point, bitangent);
+		record.uvPerUnit = 1.0f;
+		record.texture = texture;
+		record.error = fabsf(distance);
 	}
 };
 
+// pinhole camera at position looking at target, verticalFov in degrees. the default looks down -z with 90 degrees
 struct Camera
 {
+	Vector3 position;
+	Vector3 target;
+	Vector3 up;
+	float verticalFov;
 
+	Camera() : position(Vector3::Zero()), target(0.0f, 0.0f, -1.0f), up(Vector3::Up()), verticalFov(90.0f) {}
+	Camera(const Vector3& _position, const Vector3& _target, const Vector3& _up, float _verticalFov)
+		: position(_position), target(_target), up(_up), verticalFov(_verticalFov) {}
 };
 
 
@@ -0,0 +1,430 @@
+#include "Texture.hpp"
+#include "External/stb_image.h"
+#include "MappedFile.hpp"
+#include <cmath>
+#include <filesystem>
+
+#ifdef _MSC_VER
+#	define FileSeek _fseeki64
+#else
+#	define FileSeek fseeko
+#endif
+
+AMATH_NAMESPACE
+
+constexpr uint32_t TileFileMagic = 0x4C495441; // "ATIL"
+constexpr uint32_t TileFileVersion = 2; // 2: mips filtered in linear space
+
+struct TileFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	int width, height;
+	int levelCount;
+};
+
+TextureCache TextureSystem::Cache;
+
+// tiles keep the 8 bit sRGB texels of the source image, color channels are decoded to linear through this table
+struct SrgbDecodeTable
+{
+    float values[256];
+
+    SrgbDecodeTable()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            const float x = i / 255.0f;
+            values[i] = x <= 0.04045f ? x / 12.92f : powf((x + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+static const SrgbDecodeTable SrgbToLinear;
+
+static uint8 EncodeSrgb8(float linear)
+{
+    const float x = Clamp(linear, 0.0f, 1.0f);
+    const float encoded = x <= 0.0031308f ? x * 12.92f : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+    return uint8(encoded * 255.0f + 0.5f);
+}
+
+static void ComputeLevels(Texture& texture, int width, int height)
+{
+    texture.levels.clear();
+    uint64_t offset = sizeof(TileFileHeader);
+
+    while (true)
+    {
+        Texture::Level level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = (width + TextureTileSize - 1) / TextureTileSize;
+        level.tilesY = (height + TextureTileSize - 1) / TextureTileSize;
+        level.fileOffset = offset;
+        texture.levels.push_back(level);
+
+        offset += uint64_t(level.tilesX) * level.tilesY * TextureTileBytes;
+        if (width == 1 && height == 1) break;
+        width = Max(width / 2, 1);
+        height = Max(height / 2, 1);
+    }
+}
+
+static uint64_t TileFileBytes(const Texture& texture)
+{
+    const Texture::Level& last = texture.levels.back();
+    return last.fileOffset + uint64_t(last.tilesX) * last.tilesY * TextureTileBytes;
+}
+
+// tile coordinates get 20 bits each in a cache key
+static bool TileCountFits(int width, int height)
+{
+    return width > 0 && height > 0 && (width - 1) / TextureTileSize < (1 << 20) && (height - 1) / TextureTileSize < (1 << 20);
+}
+
+// writes every level of the pyramid tile by tile, edge tiles repeat the last texel
+static bool WriteTileFile(const char* sourcePath, Texture& texture)
+{
+    int width, height, channels;
+    Color32* pixels = (Color32*)stbi_load(sourcePath, &width, &height, &channels, 4);
+    if (!pixels)
+    {
+        printf("texture: failed to load %s (%s)\n", sourcePath, stbi_failure_reason());
+        return false;
+    }
+
+    if (!TileCountFits(width, height))
+    {
+        printf("texture: %s is too large (%dx%d)\n", sourcePath, width, height);
+        stbi_image_free(pixels);
+        return false;
+    }
+    ComputeLevels(texture, width, height);
+
+    // written next to the target and renamed over it, so an interrupted build never leaves a torn tile file behind
+    const std::string temporaryPath = texture.tilePath + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+    {
+        stbi_image_free(pixels);
+        return false;
+    }
+
+    TileFileHeader header = { TileFileMagic, TileFileVersion, width, height, int(texture.levels.size()) };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    std::vector<Color32> level(pixels, pixels + size_t(width) * height);
+    std::vector<Color32> next;
+    std::vector<Color32> tile(TextureTileSize * TextureTileSize);
+    stbi_image_free(pixels);
+
+    for (const Texture::Level& info : texture.levels)
+    {
+        if (!written) break;
+        for (int tileY = 0; tileY < info.tilesY; ++tileY)
+        {
+            for (int tileX = 0; tileX < info.tilesX; ++tileX)
+            {
+                for (int y = 0; y < TextureTileSize; ++y)
+                {
+                    const int sourceY = Min(tileY * TextureTileSize + y, info.height - 1);
+                    for (int x = 0; x < TextureTileSize; ++x)
+                    {
+                        const int sourceX = Min(tileX * TextureTileSize + x, info.width - 1);
+                        tile[y * TextureTileSize + x] = level[size_t(sourceY) * info.width + sourceX];
+                    }
+                }
+                written = written && fwrite(tile.data(), TextureTileBytes, 1, file) == 1;
+            }
+        }
+
+        // 2x2 box filter for the next level, averaged in linear space so dark and bright texels mix like light does
+        const int nextWidth = Max(info.width / 2, 1), nextHeight = Max(info.height / 2, 1);
+        next.resize(size_t(nextWidth) * nextHeight);
+        for (int y = 0; y < nextHeight; ++y)
+        {
+            const int y0 = Min(y * 2, info.height - 1), y1 = Min(y * 2 + 1, info.height - 1);
+            for (int x = 0; x < nextWidth; ++x)
+            {
+                const int x0 = Min(x * 2, info.width - 1), x1 = Min(x * 2 + 1, info.width - 1);
+                const Color32 a = level[size_t(y0) * info.width + x0], b = level[size_t(y0) * info.width + x1];
+                const Color32 c = level[size_t(y1) * info.width + x0], d = level[size_t(y1) * info.width + x1];
+                Color32& out = next[size_t(y) * nextWidth + x];
+                for (int i = 0; i < 3; ++i)
+                {
+                    const float* linear = SrgbToLinear.values;
+                    out.arr[i] = EncodeSrgb8((linear[a.arr[i]] + linear[b.arr[i]] + linear[c.arr[i]] + linear[d.arr[i]]) * 0.25f);
+                }
+                out.a = uint8((a.a + b.a + c.a + d.a + 2) / 4);
+            }
+        }
+        level.swap(next);
+    }
+
+    written = fflush(file) == 0 && written;
+    written = fclose(file) == 0 && written;
+    if (!written || !MappedFile::ReplaceAtomically(temporaryPath, texture.tilePath))
+    {
+        printf("texture: failed to write %s\n", texture.tilePath.c_str());
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool OpenTileFile(const char* sourcePath, Texture& texture)
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    // rebuild the tiles when the source image is newer
+    if (!fs::exists(texture.tilePath, error)) return false;
+    if (fs::exists(sourcePath, error) && fs::last_write_time(sourcePath, error) > fs::last_write_time(texture.tilePath, error)) return false;
+
+    FILE* file = fopen(texture.tilePath.c_str(), "rb");
+    if (!file) return false;
+
+    TileFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != TileFileMagic || header.version != TileFileVersion ||
+        !TileCountFits(header.width, header.height))
+    {
+        fclose(file);
+        return false;
+    }
+
+    // a file that does not hold exactly the tiles of its header is rebuilt instead of read past its end
+    ComputeLevels(texture, header.width, header.height);
+    if (int(texture.levels.size()) != header.levelCount || fs::file_size(texture.tilePath, error) != TileFileBytes(texture) || error)
+    {
+        fclose(file);
+        return false;
+    }
+    texture.file = file;
+    return true;
+}
+
+bool Texture::ReadTile(int level, int tileX, int tileY, Color32* destination)
+{
+    const Level& info = levels[level];
+    const uint64_t offset = info.fileOffset + (uint64_t(tileY) * info.tilesX + tileX) * TextureTileBytes;
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (FileSeek(file, offset, SEEK_SET) != 0) return false;
+    return fread(destination, TextureTileBytes, 1, file) == 1;
+}
+
+void TextureCache::Initialize(size_t capacityBytes)
+{
+    const int tilesPerShard = Max(int(capacityBytes / TextureTileBytes / ShardCount), 1);
+    tileMemory.resize(size_t(tilesPerShard) * ShardCount * TextureTileSize * TextureTileSize);
+
+    for (int s = 0; s < ShardCount; ++s)
+    {
+        Shard& shard = shards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.slots.resize(tilesPerShard);
+        shard.lookup.clear();
+        shard.lookup.reserve(tilesPerShard * 2);
+        shard.head = shard.tail = -1;
+        shard.used = 0;
+
+        for (int i = 0; i < tilesPerShard; ++i)
+        {
+            shard.slots[i].texels = &tileMemory[(size_t(s) * tilesPerShard + i) * TextureTileSize * TextureTileSize];
+        }
+    }
+}
+
+void TextureCache::Clear()
+{
+    for (Shard& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.slots.clear();
+        shard.lookup.clear();
+        shard.head = shard.tail = -1;
+        shard.used = 0;
+    }
+    tileMemory.clear();
+    textures.clear();
+    hits = misses = bytesLoaded = 0;
+}
+
+int TextureCache::AddTexture(std::unique_ptr<Texture> texture)
+{
+    textures.push_back(std::move(texture));
+    return int(textures.size()) - 1;
+}
+
+void TextureCache::Unlink(Shard& shard, int slot)
+{
+    Slot& entry = shard.slots[slot];
+    if (entry.previous != -1) shard.slots[entry.previous].next = entry.next; else shard.head = entry.next;
+    if (entry.next != -1) shard.slots[entry.next].previous = entry.previous; else shard.tail = entry.previous;
+}
+
+void TextureCache::MoveToFront(Shard& shard, int slot)
+{
+    if (shard.head == slot) return;
+    Unlink(shard, slot);
+    Slot& entry = shard.slots[slot];
+    entry.previous = -1;
+    entry.next = shard.head;
+    if (shard.head != -1) shard.slots[shard.head].previous = slot;
+    shard.head = slot;
+    if (shard.tail == -1) shard.tail = slot;
+}
+
+// shard lock must be held, the returned pointer is only valid until it is released
+const Color32* TextureCache::AcquireTile(Shard& shard, uint64_t key, int texture, int level, int tileX, int tileY)
+{
+    auto found = shard.lookup.find(key);
+    if (found != shard.lookup.end())
+    {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        MoveToFront(shard, found->second);
+        return shard.slots[found->second].texels;
+    }
+
+    int slot;
+    if (shard.used < int(shard.slots.size()))
+    {
+        slot = shard.used++;
+        shard.slots[slot].previous = shard.slots[slot].next = -1;
+        if (shard.tail == -1) shard.tail = slot;
+        if (shard.head != -1) shard.slots[shard.head].previous = slot;
+        shard.slots[slot].next = shard.head;
+        shard.head = slot;
+    }
+    else
+    {
+        // evict the least recently used tile
+        slot = shard.tail;
+        shard.lookup.erase(shard.slots[slot].key);
+        MoveToFront(shard, slot);
+    }
+
+    Slot& entry = shard.slots[slot];
+    entry.key = key;
+    shard.lookup.emplace(key, slot);
+
+    if (!textures[texture]->ReadTile(level, tileX, tileY, entry.texels))
+    {
+        std::fill(entry.texels, entry.texels + TextureTileSize * TextureTileSize, Color32(255, 0, 255));
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    bytesLoaded.fetch_add(TextureTileBytes, std::memory_order_relaxed);
+    return entry.texels;
+}
+
+FINLINE uint64_t TileKey(int texture, int level, int tileX, int tileY)
+{
+    return (uint64_t(texture) << 48) | (uint64_t(level) << 40) | (uint64_t(tileY) << 20) | uint64_t(tileX);
+}
+
+void TextureCache::FetchQuad(int texture, int level, int x, int y, Color32 quad[4])
+{
+    const Texture::Level& info = textures[texture]->levels[level];
+    const int x1 = x + 1 == info.width ? 0 : x + 1;
+    const int y1 = y + 1 == info.height ? 0 : y + 1;
+    const int xs[4] = { x, x1, x, x1 };
+    const int ys[4] = { y, y, y1, y1 };
+
+    uint64_t keys[4];
+    for (int i = 0; i < 4; ++i) keys[i] = TileKey(texture, level, xs[i] / TextureTileSize, ys[i] / TextureTileSize);
+
+    bool filled[4] = { false, false, false, false };
+    for (int i = 0; i < 4; ++i)
+    {
+        if (filled[i]) continue;
+        // cheap mix so neighbouring tiles land in different shards
+        Shard& shard = shards[(keys[i] * 0x9E3779B97F4A7C15ull) >> 60];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const Color32* tile = AcquireTile(shard, keys[i], texture, level, xs[i] / TextureTileSize, ys[i] / TextureTileSize);
+
+        for (int j = i; j < 4; ++j)
+        {
+            if (keys[j] != keys[i]) continue;
+            quad[j] = tile[(ys[j] % TextureTileSize) * TextureTileSize + (xs[j] % TextureTileSize)];
+            filled[j] = true;
+        }
+    }
+}
+
+float TextureCache::HitRate() const
+{
+    const uint64_t total = hits + misses;
+    return total ? float(double(hits) / double(total)) : 0.0f;
+}
+
+void TextureCache::LogStatistics() const
+{
+    printf("texture cache: %d textures, hit rate %.2f%%, %llu hits, %llu misses, %.2f MB loaded\n",
+           TextureCount(), HitRate() * 100.0f, (unsigned long long)hits.load(), (unsigned long long)misses.load(),
+           double(bytesLoaded.load()) / (1024.0 * 1024.0));
+}
+
+int TextureSystem::Load(const char* path)
+{
+    if (!Cache.Initialized()) Cache.Initialize(TextureCache::DefaultCapacity);
+
+    auto texture = std::make_unique<Texture>();
+    texture->tilePath = std::string(path) + ".tiles";
+
+    if (!OpenTileFile(path, *texture))
+    {
+        if (!WriteTileFile(path, *texture) || !OpenTileFile(path, *texture)) return -1;
+    }
+    return Cache.AddTexture(std::move(texture));
+}
+
+// linear color in [0, 1], alpha is stored linearly
+FINLINE __m128 VECTORCALL UnpackColor32(const Color32 color)
+{
+    const float* linear = SrgbToLinear.values;
+    return _mm_setr_ps(linear[color.r], linear[color.g], linear[color.b], color.a * Color::OneDiv255);
+}
+
+Color TextureSystem::SampleBilinear(int texture, float u, float v, int level)
+{
+    const Texture& info = Cache.GetTexture(texture);
+    level = Clamp(level, 0, int(info.levels.size()) - 1);
+    const Texture::Level& mip = info.levels[level];
+
+    // texel centers are at half coordinates
+    const float x = (u - floorf(u)) * mip.width - 0.5f;
+    const float y = (v - floorf(v)) * mip.height - 0.5f;
+    const float floorX = floorf(x), floorY = floorf(y);
+    int texelX = int(floorX) % mip.width, texelY = int(floorY) % mip.height;
+    if (texelX < 0) texelX += mip.width;
+    if (texelY < 0) texelY += mip.height;
+
+    Color32 quad[4];
+    Cache.FetchQuad(texture, level, texelX, texelY, quad);
+
+    const __m128 fx = _mm_set1_ps(x - floorX);
+    const __m128 fy = _mm_set1_ps(y - floorY);
+    const __m128 c00 = UnpackColor32(quad[0]), c10 = UnpackColor32(quad[1]);
+    const __m128 c01 = UnpackColor32(quad[2]), c11 = UnpackColor32(quad[3]);
+
+    const __m128 top    = _mm_fmadd_ps(_mm_sub_ps(c10, c00), fx, c00);
+    const __m128 bottom = _mm_fmadd_ps(_mm_sub_ps(c11, c01), fx, c01);
+    return _mm_fmadd_ps(_mm_sub_ps(bottom, top), fy, top);
+}
+
+Color TextureSystem::SampleTrilinear(int texture, float u, float v, float lod)
+{
+    const int maxLevel = int(Cache.GetTexture(texture).levels.size()) - 1;
+    lod = Clamp(lod, 0.0f, float(maxLevel));
+
+    const int level = int(lod);
+    const float t = lod - level;
+    const Color fine = SampleBilinear(texture, u, v, level);
+    if (t <= 0.0f || level == maxLevel) return fine;
+
+    const Color coarse = SampleBilinear(texture, u, v, level + 1);
+    return Color::MixWithA(fine, coarse, t);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,106 @@
+#pragma once
+#include "Math/Color.hpp"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+AMATH_NAMESPACE
+
+constexpr int TextureTileSize = 64; // texels, one tile is 16kb of Color32
+constexpr int TextureTileBytes = TextureTileSize * TextureTileSize * sizeof(Color32);
+
+// image texture stored on disk as a tiled mip pyramid, texels are only brought in through the TextureCache
+// the first Load of an image writes "<path>.tiles" next to it, later runs read tiles from it directly
+struct Texture
+{
+	struct Level
+	{
+		int width, height;
+		int tilesX, tilesY;
+		uint64_t fileOffset; // of the first tile in this level
+	};
+
+	std::string tilePath;
+	std::vector<Level> levels;
+	FILE* file = nullptr;
+	std::mutex fileMutex; // fseek + fread pairs from different cache shards
+
+	~Texture() { if (file) fclose(file); }
+
+	int Width()  const { return levels[0].width; }
+	int Height() const { return levels[0].height; }
+
+	bool ReadTile(int level, int tileX, int tileY, Color32* destination);
+};
+
+// fixed size, thread safe LRU cache of texture tiles
+// sharded by tile key so threads sampling different tiles rarely contend on the same lock
+class TextureCache
+{
+public:
+	static constexpr int ShardCount = 16;
+
+	std::atomic<uint64_t> hits { 0 };
+	std::atomic<uint64_t> misses { 0 };
+	std::atomic<uint64_t> bytesLoaded { 0 };
+
+	static constexpr size_t DefaultCapacity = size_t(256) << 20;
+
+	// capacity is split evenly between the shards, all tile memory is allocated here
+	void Initialize(size_t capacityBytes);
+	bool Initialized() const { return !tileMemory.empty(); }
+	void Clear();
+
+	int  AddTexture(std::unique_ptr<Texture> texture);
+	const Texture& GetTexture(int texture) const { return *textures[texture]; }
+	int  TextureCount() const { return int(textures.size()); }
+
+	// fetches the 2x2 texel quad starting at x, y with wrapping, locks each distinct tile once
+	void FetchQuad(int texture, int level, int x, int y, Color32 quad[4]);
+
+	float HitRate() const;
+	void LogStatistics() const;
+
+private:
+	struct Slot
+	{
+		uint64_t key;
+		int previous, next; // LRU list, most recent first
+		Color32* texels;
+	};
+
+	struct alignas(64) Shard
+	{
+		std::mutex mutex;
+		std::vector<Slot> slots;
+		std::unordered_map<uint64_t, int> lookup;
+		int head = -1, tail = -1;
+		int used = 0;
+	};
+
+	Shard shards[ShardCount];
+	std::vector<Color32> tileMemory;
+	std::vector<std::unique_ptr<Texture>> textures;
+
+	const Color32* AcquireTile(Shard& shard, uint64_t key, int texture, int level, int tileX, int tileY);
+	void MoveToFront(Shard& shard, int slot);
+	void Unlink(Shard& shard, int slot);
+};
+
+namespace TextureSystem
+{
+	extern TextureCache Cache;
+
+	// loads an image through stb_image, builds the mip chain and tile file if needed, returns -1 on failure
+	int Load(const char* path);
+
+	// uv repeats, lod is the mip level in texels per pixel log2
+	Color SampleBilinear(int texture, float u, float v, int level);
+	Color SampleTrilinear(int texture, float u, float v, float lod);
+}
+
+AMATH_END_NAMESPACE
@@ -0,0 +1,126 @@
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+
+namespace JobSystem
+{
+    ThreadPool Pool;
+}
+
+static thread_local bool InsideJob = false;
+
+// both wait for a ParallelFor from another thread, such as the image writer's, to finish first
+void ThreadPool::Initialize(int threadCount)
+{
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    StartWorkers(threadCount);
+}
+
+void ThreadPool::Shutdown()
+{
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    StopWorkers();
+}
+
+void ThreadPool::StartWorkers(int threadCount)
+{
+    StopWorkers();
+    if (threadCount <= 0) threadCount = std::max(int(std::thread::hardware_concurrency()), 1);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+    initialized = true;
+    // new workers start at the current generation, otherwise they would join the last job again
+    for (int i = 0; i < threadCount - 1; ++i)
+    {
+        workers.emplace_back([this, startGeneration = generation] { WorkerLoop(startGeneration); });
+    }
+    runningThreads = threadCount;
+}
+
+void ThreadPool::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+    initialized = false;
+    runningThreads = 1;
+}
+
+void ThreadPool::WorkerLoop(uint64_t seenGeneration)
+{
+    InsideJob = true;
+    Trace::SetThreadName("worker");
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+        if (stopping) return;
+        seenGeneration = generation;
+        lock.unlock();
+
+        RunJob();
+
+        lock.lock();
+        if (--busyWorkers == 0) finished.notify_one();
+    }
+}
+
+void ThreadPool::RunJob()
+{
+    // gaps between these on a worker are time the pool had nothing for it
+    Trace::Scope scope("job");
+    while (true)
+    {
+        const int begin = nextIndex.fetch_add(jobGrain, std::memory_order_relaxed);
+        if (begin >= jobCount) return;
+        const int end = std::min(begin + jobGrain, jobCount);
+        for (int i = begin; i < end; ++i) job(jobContext, i);
+    }
+}
+
+void ThreadPool::Run(int count, JobFunction function, void* context, int grain)
+{
+    if (count <= 0) return;
+    grain = std::max(grain, 1);
+    if (InsideJob || count <= grain)
+    {
+        for (int i = 0; i < count; ++i) function(context, i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    // the first caller starts the workers, under the lock so the main and writer threads cannot both do it
+    if (!initialized) StartWorkers(0);
+    if (workers.empty())
+    {
+        for (int i = 0; i < count; ++i) function(context, i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = function;
+        jobContext = context;
+        jobCount = count;
+        jobGrain = grain;
+        nextIndex.store(0, std::memory_order_relaxed);
+        busyWorkers = int(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    InsideJob = true;
+    RunJob();
+    InsideJob = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return busyWorkers == 0; });
+    job = nullptr;
+    jobContext = nullptr;
+}
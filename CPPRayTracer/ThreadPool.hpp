@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed set of worker threads, ParallelFor hands index ranges to them and the calling thread works too
+// one ParallelFor runs at a time, nested calls from inside a job run serially on the calling worker
+class ThreadPool
+{
+public:
+	~ThreadPool() { Shutdown(); }
+
+	// threadCount includes the calling thread, 0 uses every hardware thread
+	void Initialize(int threadCount = 0);
+	void Shutdown();
+	int  ThreadCount() const { return runningThreads.load(std::memory_order_relaxed); }
+
+	// calls body(index) for every index in [0, count), workers take grain indices at a time.
+	// body is called through a plain function pointer, a std::function could allocate for larger captures
+	template<typename Body>
+	void ParallelFor(int count, Body&& body, int grain = 1)
+	{
+		using BodyType = std::remove_reference_t<Body>;
+		Run(count, [](void* context, int index) { (*static_cast<BodyType*>(context))(index); },
+		    const_cast<void*>(static_cast<const void*>(&body)), grain);
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex submitMutex; // serializes ParallelFor callers
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	using JobFunction = void (*)(void* context, int index);
+	JobFunction job = nullptr;
+	void* jobContext = nullptr;
+	int jobCount = 0;
+	int jobGrain = 1;
+	std::atomic<int> nextIndex { 0 };
+	int busyWorkers = 0;
+	uint64_t generation = 0;
+	bool initialized = false; // guarded by submitMutex, like workers
+	std::atomic<int> runningThreads { 1 }; // read without the lock by ThreadCount
+	bool stopping = false;
+
+	void Run(int count, JobFunction function, void* context, int grain);
+	// callers hold submitMutex
+	void StartWorkers(int threadCount);
+	void StopWorkers();
+	void WorkerLoop(uint64_t seenGeneration);
+	void RunJob();
+};
+
+namespace JobSystem
+{
+	extern ThreadPool Pool;
+}
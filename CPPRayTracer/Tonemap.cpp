@@ -0,0 +1,154 @@
+#include "Tonemap.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include <chrono>
+#include <cmath>
+
+AMATH_NAMESPACE
+
+// the dither offsets of one row of the 8x8 bayer matrix, laid out like 8 Color pixels so they add straight onto
+// the interleaved channels. offsets are in 8 bit steps and centered on zero, alpha gets none
+struct alignas(32) DitherRow
+{
+    float offsets[32];
+};
+
+static const DitherRow* DitherTable()
+{
+    static const struct Table
+    {
+        DitherRow rows[8];
+        Table()
+        {
+            static constexpr uint8_t Bayer[8][8] = {
+                {  0, 32,  8, 40,  2, 34, 10, 42 },
+                { 48, 16, 56, 24, 50, 18, 58, 26 },
+                { 12, 44,  4, 36, 14, 46,  6, 38 },
+                { 60, 28, 52, 20, 62, 30, 54, 22 },
+                {  3, 35, 11, 43,  1, 33,  9, 41 },
+                { 51, 19, 59, 27, 49, 17, 57, 25 },
+                { 15, 47,  7, 39, 13, 45,  5, 37 },
+                { 63, 31, 55, 23, 61, 29, 53, 21 }
+            };
+            for (int y = 0; y < 8; ++y)
+                for (int x = 0; x < 8; ++x)
+                {
+                    const float offset = (Bayer[y][x] + 0.5f) / 64.0f - 0.5f;
+                    for (int channel = 0; channel < 3; ++channel) rows[y].offsets[x * 4 + channel] = offset;
+                    rows[y].offsets[x * 4 + 3] = 0.0f;
+                }
+        }
+    } table;
+    return table.rows;
+}
+
+template<ToneCurve Curve>
+static FINLINE __m256 VECTORCALL ApplyCurve(__m256 x)
+{
+    if constexpr (Curve == ToneCurve::Reinhard)
+    {
+        return _mm256_div_ps(x, _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    }
+    else if constexpr (Curve == ToneCurve::Aces)
+    {
+        // x (2.51 x + 0.03) / (x (2.43 x + 0.59) + 0.14)
+        const __m256 numerator = _mm256_mul_ps(x, _mm256_fmadd_ps(x, _mm256_set1_ps(2.51f), _mm256_set1_ps(0.03f)));
+        const __m256 denominator = _mm256_fmadd_ps(x, _mm256_fmadd_ps(x, _mm256_set1_ps(2.43f), _mm256_set1_ps(0.59f)), _mm256_set1_ps(0.14f));
+        return _mm256_div_ps(numerator, denominator);
+    }
+    else return x;
+}
+
+// sRGB transfer function for x in [0, 1]. the power segment 1.055 x^(1/2.4) - 0.055 is a degree 6 polynomial
+// in sqrt(x), fitted from the linear segment's end to 1. it stays within 0.06 of an 8 bit step of the exact curve
+// and costs one sqrt instead of a pow
+static FINLINE __m256 VECTORCALL EncodeSrgb(__m256 x)
+{
+    const __m256 s = _mm256_sqrt_ps(x);
+    __m256 power = _mm256_set1_ps(-7.408843703e-01f);
+    power = _mm256_fmadd_ps(power, s, _mm256_set1_ps(2.762657528e+00f));
+    power = _mm256_fmadd_ps(power, s, _mm256_set1_ps(-4.205000581e+00f));
+    power = _mm256_fmadd_ps(power, s, _mm256_set1_ps(3.433093483e+00f));
+    power = _mm256_fmadd_ps(power, s, _mm256_set1_ps(-1.767121408e+00f));
+    power = _mm256_fmadd_ps(power, s, _mm256_set1_ps(1.558750796e+00f));
+    power = _mm256_fmadd_ps(power, s, _mm256_set1_ps(-4.157396252e-02f));
+    const __m256 linear = _mm256_mul_ps(x, _mm256_set1_ps(12.92f));
+    return _mm256_blendv_ps(power, linear, _mm256_cmp_ps(x, _mm256_set1_ps(0.0031308f), _CMP_LT_OQ));
+}
+
+// two pixels, interleaved channels in and 8 bit steps out with alpha at 255, still unrounded
+template<ToneCurve Curve>
+static FINLINE __m256 VECTORCALL ConvertPair(__m256 color, __m256 scale, __m256 dither)
+{
+    color = ApplyCurve<Curve>(_mm256_mul_ps(color, scale));
+    // max with zero first so nan becomes zero
+    color = _mm256_min_ps(_mm256_max_ps(color, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    color = _mm256_fmadd_ps(EncodeSrgb(color), _mm256_set1_ps(255.0f), dither);
+    return _mm256_blend_ps(color, _mm256_set1_ps(255.0f), 0x88);
+}
+
+template<ToneCurve Curve>
+static void ConvertPixels(const Color* radiance, Color32* output, int count, const DitherRow& dither, float scale)
+{
+    const __m256 scaleVector = _mm256_set1_ps(scale);
+    // undoes the lane interleaving of the two packs below
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const float* source = &radiance->r;
+
+    for (int x = 0; x < count; x += 8)
+    {
+        const float* in = source + size_t(x) * 4;
+        const __m256i p01 = _mm256_cvtps_epi32(ConvertPair<Curve>(_mm256_loadu_ps(in +  0), scaleVector, _mm256_load_ps(dither.offsets +  0)));
+        const __m256i p23 = _mm256_cvtps_epi32(ConvertPair<Curve>(_mm256_loadu_ps(in +  8), scaleVector, _mm256_load_ps(dither.offsets +  8)));
+        const __m256i p45 = _mm256_cvtps_epi32(ConvertPair<Curve>(_mm256_loadu_ps(in + 16), scaleVector, _mm256_load_ps(dither.offsets + 16)));
+        const __m256i p67 = _mm256_cvtps_epi32(ConvertPair<Curve>(_mm256_loadu_ps(in + 24), scaleVector, _mm256_load_ps(dither.offsets + 24)));
+
+        // 32 -> 16 -> 8 bit with saturation, the packs work per 128 bit lane and leave the pixels as 0 2 4 6 1 3 5 7
+        const __m256i words0 = _mm256_packs_epi32(p01, p23);
+        const __m256i words1 = _mm256_packs_epi32(p45, p67);
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words0, words1), order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + x), bytes);
+    }
+}
+
+void Tonemapper::ConvertRow(int y, int width, const Color* radiance, Color32* output) const
+{
+    static const DitherRow NoDither = {};
+    const DitherRow& dither = settings.dither ? DitherTable()[y & 7] : NoDither;
+    const float scale = exp2f(settings.exposure);
+    auto convert = [&](const Color* in, Color32* out, int count)
+    {
+        switch (settings.curve)
+        {
+        case ToneCurve::Reinhard: ConvertPixels<ToneCurve::Reinhard>(in, out, count, dither, scale); break;
+        case ToneCurve::Aces:     ConvertPixels<ToneCurve::Aces>(in, out, count, dither, scale); break;
+        default:                  ConvertPixels<ToneCurve::None>(in, out, count, dither, scale); break;
+        }
+    };
+
+    const int whole = width & ~7;
+    convert(radiance, output, whole);
+    if (whole == width) return;
+
+    // the last few pixels go through a padded copy so every pixel takes the same path
+    Color tailIn[8];
+    Color32 tailOut[8];
+    const int rest = width - whole;
+    for (int i = 0; i < rest; ++i) tailIn[i] = radiance[whole + i];
+    convert(tailIn, tailOut, 8);
+    for (int i = 0; i < rest; ++i) output[whole + i] = tailOut[i];
+}
+
+void Tonemapper::Convert(int width, int height, const Color* radiance, Color32* output)
+{
+    Trace::Scope scope("tonemap");
+    const auto start = std::chrono::high_resolution_clock::now();
+    JobSystem::Pool.ParallelFor(height, [&](int y)
+    {
+        const size_t row = size_t(y) * width;
+        ConvertRow(y, width, radiance + row, output + row);
+    }, 16);
+    lastMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+AMATH_END_NAMESPACE
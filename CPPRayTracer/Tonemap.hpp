@@ -0,0 +1,36 @@
+#pragma once
+#include "Math/Color.hpp"
+#include <cstdint>
+
+AMATH_NAMESPACE
+
+enum class ToneCurve : uint32_t
+{
+	None,		// clipped at 1
+	Reinhard,	// x / (1 + x) per channel
+	Aces		// Narkowicz's fit of the ACES reference rendering transform
+};
+
+struct TonemapSettings
+{
+	float exposure = 0.0f;	// in stops, radiance is scaled by 2^exposure before the curve
+	ToneCurve curve = ToneCurve::Aces;
+	bool dither = true;		// 8x8 ordered dither of one 8 bit step, hides banding in smooth gradients
+};
+
+// the output stage from averaged radiance to 8 bit sRGB: exposure, tone curve, sRGB encoding and dithering.
+// 8 pixels are converted at once with AVX, rounding and clamping to 0 - 255 happen in the saturating packs,
+// so negative, overbright and nan radiance can not wrap around. alpha is always 255
+class Tonemapper
+{
+public:
+	TonemapSettings settings;
+	float lastMilliseconds = 0.0f;
+
+	// both buffers hold width * height pixels in rows top down, rows are split across the job system
+	void Convert(int width, int height, const Color* radiance, Color32* output);
+	// one row, the dither pattern is anchored at x = 0 of row y
+	void ConvertRow(int y, int width, const Color* radiance, Color32* output) const;
+};
+
+AMATH_END_NAMESPACE
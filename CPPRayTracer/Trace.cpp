@@ -0,0 +1,83 @@
+#include "Trace.hpp"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+// rings belong to the registry so the events of threads that have exited are still exported
+static std::mutex RegistryMutex;
+static std::vector<std::unique_ptr<Trace::Ring>> Registry;
+static uint32_t EventsPerThread = 1 << 16;
+static std::chrono::steady_clock::time_point Origin;
+
+Trace::Ring::Ring(uint32_t capacity, uint32_t _thread, const char* _threadName)
+    : thread(_thread), threadName(_threadName), events(new Event[capacity]), mask(capacity - 1)
+{
+}
+
+void Trace::Start(uint32_t eventsPerThread)
+{
+    uint32_t capacity = 1;
+    while (capacity < eventsPerThread) capacity <<= 1;
+    {
+        std::lock_guard<std::mutex> lock(RegistryMutex);
+        EventsPerThread = capacity;
+        Origin = std::chrono::steady_clock::now();
+    }
+    Recording.store(true, std::memory_order_release);
+}
+
+uint64_t Trace::Now()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Origin).count());
+}
+
+Trace::Ring* Trace::Register()
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+    Registry.push_back(std::make_unique<Ring>(EventsPerThread, uint32_t(Registry.size()), ThreadName));
+    ThreadRing = Registry.back().get();
+    return ThreadRing;
+}
+
+bool Trace::Export(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        printf("trace: could not write %s\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(RegistryMutex);
+    uint64_t exported = 0, dropped = 0;
+    bool first = true;
+    auto separator = [&] { fputs(first ? "\n" : ",\n", file); first = false; };
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    for (const auto& ring : Registry)
+    {
+        separator();
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                ring->thread, ring->threadName ? ring->threadName : "thread", ring->thread);
+
+        const uint64_t written = ring->Written();
+        const uint64_t begin = written > ring->Capacity() ? written - ring->Capacity() : 0;
+        for (uint64_t i = begin; i < written; ++i)
+        {
+            const Event& event = ring->At(i);
+            separator();
+            // complete events, timestamps in microseconds
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    event.name, ring->thread, event.start * 1e-3, (event.end - event.start) * 1e-3);
+        }
+        exported += written - begin;
+        dropped += begin;
+    }
+    fputs("\n]}\n", file);
+
+    const bool written = fclose(file) == 0;
+    printf("trace: %llu events of %d threads written to %s, %llu overwritten\n",
+           (unsigned long long)exported, int(Registry.size()), path, (unsigned long long)dropped);
+    return written;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// timeline of what every thread did, exported as chrome trace event json (chrome://tracing or ui.perfetto.dev).
+// scopes record into a ring per thread that only its own thread writes, so recording takes no lock and never
+// waits. a full ring overwrites its oldest events. nothing is recorded until Start
+namespace Trace
+{
+	struct Event
+	{
+		const char* name; // string literal, only the pointer is kept
+		uint64_t start, end; // nanoseconds since Start
+	};
+
+	class Ring
+	{
+	public:
+		Ring(uint32_t capacity, uint32_t thread, const char* threadName);
+
+		void Push(const Event& event)
+		{
+			const uint64_t index = written.load(std::memory_order_relaxed);
+			events[index & mask] = event;
+			written.store(index + 1, std::memory_order_release);
+		}
+
+		// events in the order they ended, the oldest may be gone
+		uint64_t Written() const { return written.load(std::memory_order_acquire); }
+		uint64_t Capacity() const { return mask + 1; }
+		const Event& At(uint64_t index) const { return events[index & mask]; }
+
+		const uint32_t thread;
+		const char* const threadName;
+
+	private:
+		std::unique_ptr<Event[]> events;
+		uint64_t mask;
+		std::atomic<uint64_t> written { 0 };
+	};
+
+	// events kept per thread, rounded up to a power of two
+	void Start(uint32_t eventsPerThread = 1 << 16);
+	inline std::atomic<bool> Recording { false };
+	uint64_t Now();
+
+	// constant initialized thread locals, reading them needs no init check
+	inline thread_local Ring* ThreadRing = nullptr;
+	inline thread_local const char* ThreadName = nullptr;
+	Ring* Register();
+
+	// shows up as the thread's name in the viewer, call once at the start of a thread
+	inline void SetThreadName(const char* name) { ThreadName = name; }
+
+	// records the time from construction to destruction under name
+	class Scope
+	{
+	public:
+		explicit Scope(const char* _name) : name(_name), start(Recording.load(std::memory_order_acquire) ? Now() : NotRecording) {}
+		~Scope()
+		{
+			if (start == NotRecording) return;
+			Ring* ring = ThreadRing;
+			if (ring == nullptr) ring = Register();
+			ring->Push({ name, start, Now() });
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		static constexpr uint64_t NotRecording = ~uint64_t(0);
+		const char* name;
+		uint64_t start;
+	};
+
+	// writes every ring, call once the threads that record are idle
+	bool Export(const char* path);
+}